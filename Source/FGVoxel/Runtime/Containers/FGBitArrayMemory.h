@@ -76,4 +76,162 @@ public:
 			OutVoxelType = result;
 		}
 	}
+
+	/**
+	 * Branchless get for values that never straddle two words (width of 1, 2, 4, 8 or 16).
+	 * @param Words The packed words to read from.
+	 * @param StartBit The bit that the value starts at.
+	 * @param BitsPerValue Width of the value, must divide 32 evenly.
+	 * @return The unpacked value.
+	 */
+	FORCEINLINE static uint32 GetAligned(const uint32* RESTRICT Words, int32 StartBit, int32 BitsPerValue)
+	{
+		const uint32 ValueMask = (1u << BitsPerValue) - 1;
+		return (Words[StartBit >> 5] >> (StartBit & 31)) & ValueMask;
+	}
+
+	/**
+	 * Branchless set for values that never straddle two words (width of 1, 2, 4, 8 or 16).
+	 * @param Words The packed words to write to.
+	 * @param StartBit The bit that the value starts at.
+	 * @param BitsPerValue Width of the value, must divide 32 evenly.
+	 * @param Value The value to write, must fit in BitsPerValue.
+	 */
+	FORCEINLINE static void SetAligned(uint32* RESTRICT Words, int32 StartBit, int32 BitsPerValue, uint32 Value)
+	{
+		const uint32 Shift = StartBit & 31;
+		const uint32 ValueMask = ((1u << BitsPerValue) - 1) << Shift;
+		uint32& Word = Words[StartBit >> 5];
+		Word = (Word & ~ValueMask) | ((Value << Shift) & ValueMask);
+	}
+
+	/**
+	 * Get for tightly packed values of up to 32 bits that may straddle two words.
+	 * @param Words The packed words to read from.
+	 * @param StartBit The bit that the value starts at.
+	 * @param BitsPerValue Width of the value.
+	 * @return The unpacked value.
+	 */
+	FORCEINLINE static uint32 GetUnaligned(const uint32* RESTRICT Words, int32 StartBit, int32 BitsPerValue)
+	{
+		const uint32 Word = StartBit >> 5;
+		const uint32 Shift = StartBit & 31;
+		const uint32 ValueMask = (uint32)((1ull << BitsPerValue) - 1);
+
+		uint32 Value = Words[Word] >> Shift;
+		if(Shift + BitsPerValue > 32) // Straddles into the next word.
+		{
+			Value |= Words[Word + 1] << (32 - Shift);
+		}
+		return Value & ValueMask;
+	}
+
+	/**
+	 * Set for tightly packed values of up to 32 bits that may straddle two words.
+	 * @param Words The packed words to write to.
+	 * @param StartBit The bit that the value starts at.
+	 * @param BitsPerValue Width of the value.
+	 * @param Value The value to write, must fit in BitsPerValue.
+	 */
+	FORCEINLINE static void SetUnaligned(uint32* RESTRICT Words, int32 StartBit, int32 BitsPerValue, uint32 Value)
+	{
+		const uint32 Word = StartBit >> 5;
+		const uint32 Shift = StartBit & 31;
+		const uint64 ValueMask = ((1ull << BitsPerValue) - 1) << Shift;
+		const uint64 ShiftedValue = (uint64)Value << Shift;
+
+		Words[Word] = (Words[Word] & ~(uint32)ValueMask) | ((uint32)ShiftedValue & (uint32)ValueMask);
+		if(Shift + BitsPerValue > 32) // Straddles into the next word.
+		{
+			Words[Word + 1] = (Words[Word + 1] & ~(uint32)(ValueMask >> 32)) | ((uint32)(ShiftedValue >> 32) & (uint32)(ValueMask >> 32));
+		}
+	}
+
+	/**
+	 * Unpack fixed width values from a bit array one word at a time.
+	 * BitsPerValue must divide 32 evenly so that values never straddle two words.
+	 * @param Words The packed words to read from.
+	 * @param NumValues How many values to unpack, must be a multiple of 32 / BitsPerValue.
+	 * @param OutValues Output array, NumValues long.
+	 */
+	template<int32 BitsPerValue, typename ValueType>
+	static FORCEINLINE void UnpackWords(const uint32* RESTRICT Words, int32 NumValues, ValueType* RESTRICT OutValues)
+	{
+		static_assert(BitsPerValue > 0 && BitsPerValue < 32 && 32 % BitsPerValue == 0, "Values must not straddle words!");
+
+		constexpr int32 ValuesPerWord = 32 / BitsPerValue;
+		constexpr uint32 ValueMask = (1u << BitsPerValue) - 1;
+		const int32 NumWords = NumValues / ValuesPerWord;
+
+		for(int32 Word = 0; Word < NumWords; Word++)
+		{
+			const uint32 WordBits = Words[Word];
+			ValueType* RESTRICT WordOut = OutValues + Word * ValuesPerWord;
+
+			for(int32 Value = 0; Value < ValuesPerWord; Value++)
+			{
+				WordOut[Value] = (ValueType)((WordBits >> (Value * BitsPerValue)) & ValueMask);
+			}
+		}
+	}
+
+	/**
+	 * Unpack fixed width values from a bit array one word at a time, remapping each
+	 * value through a lookup table as it goes (aka palette index -> voxel type).
+	 * BitsPerValue must divide 32 evenly so that values never straddle two words.
+	 * @param Words The packed words to read from.
+	 * @param NumValues How many values to unpack, must be a multiple of 32 / BitsPerValue.
+	 * @param Lut Lookup table indexed by the unpacked values.
+	 * @param OutValues Output array, NumValues long.
+	 */
+	template<int32 BitsPerValue, typename ValueType>
+	static FORCEINLINE void UnpackWords(const uint32* RESTRICT Words, int32 NumValues, const ValueType* RESTRICT Lut, ValueType* RESTRICT OutValues)
+	{
+		static_assert(BitsPerValue > 0 && BitsPerValue < 32 && 32 % BitsPerValue == 0, "Values must not straddle words!");
+
+		constexpr int32 ValuesPerWord = 32 / BitsPerValue;
+		constexpr uint32 ValueMask = (1u << BitsPerValue) - 1;
+		const int32 NumWords = NumValues / ValuesPerWord;
+
+		for(int32 Word = 0; Word < NumWords; Word++)
+		{
+			const uint32 WordBits = Words[Word];
+			ValueType* RESTRICT WordOut = OutValues + Word * ValuesPerWord;
+
+			// Constant trip count, unrolled by the compiler.
+			for(int32 Value = 0; Value < ValuesPerWord; Value++)
+			{
+				WordOut[Value] = Lut[(WordBits >> (Value * BitsPerValue)) & ValueMask];
+			}
+		}
+	}
+
+	/**
+	 * Pack fixed width values into a bit array one whole word at a time.
+	 * BitsPerValue must divide 32 evenly so that values never straddle two words.
+	 * @param Values The values to pack, each must fit in BitsPerValue.
+	 * @param NumValues How many values to pack, must be a multiple of 32 / BitsPerValue.
+	 * @param OutWords Output words, NumValues * BitsPerValue / 32 long.
+	 */
+	template<int32 BitsPerValue, typename ValueType>
+	static FORCEINLINE void PackWords(const ValueType* RESTRICT Values, int32 NumValues, uint32* RESTRICT OutWords)
+	{
+		static_assert(BitsPerValue > 0 && BitsPerValue < 32 && 32 % BitsPerValue == 0, "Values must not straddle words!");
+
+		constexpr int32 ValuesPerWord = 32 / BitsPerValue;
+		const int32 NumWords = NumValues / ValuesPerWord;
+
+		for(int32 Word = 0; Word < NumWords; Word++)
+		{
+			const ValueType* RESTRICT WordIn = Values + Word * ValuesPerWord;
+			uint32 WordBits = 0;
+
+			// Constant trip count with no cross word dependencies, this vectorizes nicely.
+			for(int32 Value = 0; Value < ValuesPerWord; Value++)
+			{
+				WordBits |= (uint32)WordIn[Value] << (Value * BitsPerValue);
+			}
+			OutWords[Word] = WordBits;
+		}
+	}
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGChunkCache.h"
+
+void FFGChunkCache::Retain(FFGChunkKey ChunkKey, int32 ChunkDataIndex, int64 Bytes)
+{
+	checkf(!Resident.Contains(ChunkKey), TEXT("Chunk is already resident in the cache!"));
+
+	// A stale cold copy would shadow the newer resident one once it's evicted.
+	if(FColdChunk* ColdChunk = Cold.Find(ChunkKey))
+	{
+		Stats.ColdBytes -= ColdChunk->Bytes.Num();
+		ColdOrder.RemoveNode(ColdChunk->Node);
+		Cold.Remove(ChunkKey);
+	}
+
+	ResidentOrder.AddTail(ChunkKey);
+	Resident.Add(ChunkKey, { ChunkDataIndex, Bytes, ResidentOrder.GetTail() });
+	Stats.ResidentBytes += Bytes;
+}
+
+bool FFGChunkCache::TakeResident(FFGChunkKey ChunkKey, int32& OutChunkDataIndex)
+{
+	FResidentChunk ResidentChunk;
+	if(!Resident.RemoveAndCopyValue(ChunkKey, ResidentChunk))
+	{
+		return false;
+	}
+
+	ResidentOrder.RemoveNode(ResidentChunk.Node);
+	Stats.ResidentBytes -= ResidentChunk.Bytes;
+	Stats.Hits += 1;
+
+	OutChunkDataIndex = ResidentChunk.ChunkDataIndex;
+	return true;
+}
+
+bool FFGChunkCache::TakeCold(FFGChunkKey ChunkKey, TArray<uint8>& OutBytes)
+{
+	FColdChunk* ColdChunk = Cold.Find(ChunkKey);
+	if(!ColdChunk)
+	{
+		return false;
+	}
+
+	ColdOrder.RemoveNode(ColdChunk->Node);
+	Stats.ColdBytes -= ColdChunk->Bytes.Num();
+	Stats.ColdHits += 1;
+
+	OutBytes = MoveTemp(ColdChunk->Bytes);
+	Cold.Remove(ChunkKey);
+	return true;
+}
+
+void FFGChunkCache::Trim(int64 ResidentBudget, int64 ColdBudget, TFunctionRef<void(FFGChunkKey, int32, TArray<uint8>&)> OnEvict)
+{
+	while(Stats.ResidentBytes > ResidentBudget && ResidentOrder.GetHead())
+	{
+		const FFGChunkKey ChunkKey = ResidentOrder.GetHead()->GetValue();
+		const FResidentChunk ResidentChunk = Resident.FindAndRemoveChecked(ChunkKey);
+
+		ResidentOrder.RemoveNode(ResidentChunk.Node);
+		Stats.ResidentBytes -= ResidentChunk.Bytes;
+		Stats.Evictions += 1;
+
+		TArray<uint8> ColdBytes;
+		OnEvict(ChunkKey, ResidentChunk.ChunkDataIndex, ColdBytes);
+
+		if(ColdBudget > 0 && !ColdBytes.IsEmpty())
+		{
+			Stats.ColdBytes += ColdBytes.Num();
+			ColdOrder.AddTail(ChunkKey);
+			Cold.Add(ChunkKey, { MoveTemp(ColdBytes), ColdOrder.GetTail() });
+		}
+	}
+
+	while(Stats.ColdBytes > ColdBudget && ColdOrder.GetHead())
+	{
+		const FFGChunkKey ChunkKey = ColdOrder.GetHead()->GetValue();
+		ColdOrder.RemoveNode(ColdOrder.GetHead());
+
+		Stats.ColdBytes -= Cold.FindChecked(ChunkKey).Bytes.Num();
+		Cold.Remove(ChunkKey);
+	}
+}
+
+void FFGChunkCache::Empty()
+{
+	Resident.Empty();
+	Cold.Empty();
+	ResidentOrder.Empty();
+	ColdOrder.Empty();
+	Stats.ResidentBytes = 0;
+	Stats.ColdBytes = 0;
+}
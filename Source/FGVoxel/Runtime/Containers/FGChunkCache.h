@@ -0,0 +1,103 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Containers/FGChunkKey.h"
+#include "Containers/List.h"
+
+/**
+ * Keeps chunks around after the last handle to them is dropped, so walking
+ * back over ground we already generated doesn't have to generate it again.
+ *
+ * Resident chunks keep their slot in the grid and cost their full storage.
+ * Once over budget the least recently released are evicted, optionally into
+ * a cold tier of compressed blobs with it's own budget. Hits take the chunk
+ * back out of the cache, so release order is exactly LRU order.
+ *
+ * Game thread only.
+ */
+class FGVOXEL_API FFGChunkCache
+{
+public:
+
+	struct FStats
+	{
+		int64	ResidentBytes = 0;
+		int64	ColdBytes = 0;
+		uint64	Hits = 0;
+		uint64	ColdHits = 0;
+		uint64	Misses = 0;
+		uint64	Evictions = 0;
+	};
+
+	FFGChunkCache() = default;
+	FFGChunkCache(const FFGChunkCache&) = delete;
+	FFGChunkCache& operator=(const FFGChunkCache&) = delete;
+
+	/**
+	 * Keep a released chunk resident.
+	 * @param ChunkKey The chunk that was released.
+	 * @param ChunkDataIndex The slot the chunk lives in, owned by the cache until taken or evicted.
+	 * @param Bytes How much memory the chunk is holding.
+	 */
+	void Retain(FFGChunkKey ChunkKey, int32 ChunkDataIndex, int64 Bytes);
+
+	/**
+	 * Take a resident chunk back out of the cache.
+	 * @param ChunkKey The chunk to find.
+	 * @param OutChunkDataIndex The slot the chunk is still in.
+	 * @return true on a hit.
+	 */
+	bool TakeResident(FFGChunkKey ChunkKey, int32& OutChunkDataIndex);
+
+	/**
+	 * Take a cold chunk back out of the cache.
+	 * @param ChunkKey The chunk to find.
+	 * @param OutBytes The compressed chunk.
+	 * @return true on a hit.
+	 */
+	bool TakeCold(FFGChunkKey ChunkKey, TArray<uint8>& OutBytes);
+
+	/** Count a request that neither tier could serve. */
+	void RecordMiss() { Stats.Misses += 1; }
+
+	/**
+	 * Evict the least recently released chunks until both tiers fit their budget.
+	 * @param ResidentBudget Bytes resident chunks may hold.
+	 * @param ColdBudget Bytes cold chunks may hold, 0 drops evicted chunks entirely.
+	 * @param OnEvict Called for every evicted resident chunk with it's slot, which the callee now owns.
+	 *                Fill the bytes with the compressed chunk to keep it in the cold tier.
+	 */
+	void Trim(int64 ResidentBudget, int64 ColdBudget, TFunctionRef<void(FFGChunkKey, int32, TArray<uint8>&)> OnEvict);
+
+	/** Forget everything, slots held by resident chunks are the caller's to clean up. */
+	void Empty();
+
+	int32 GetNumResident() const { return Resident.Num(); }
+	int32 GetNumCold() const { return Cold.Num(); }
+	const FStats& GetStats() const { return Stats; }
+
+private:
+
+	using FOrderList = TDoubleLinkedList<FFGChunkKey>;
+
+	struct FResidentChunk
+	{
+		int32						ChunkDataIndex;
+		int64						Bytes;
+		FOrderList::TDoubleLinkedListNode* Node;
+	};
+
+	struct FColdChunk
+	{
+		TArray<uint8>				Bytes;
+		FOrderList::TDoubleLinkedListNode* Node;
+	};
+
+	TMap<FFGChunkKey, FResidentChunk>	Resident;
+	TMap<FFGChunkKey, FColdChunk>		Cold;
+	FOrderList							ResidentOrder;	// Head is the least recently released.
+	FOrderList							ColdOrder;
+	FStats								Stats;
+};
@@ -0,0 +1,214 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGChunkIndex.h"
+
+namespace FG::Private
+{
+	/** How many read scopes the current thread is inside, for catching unscoped reads. */
+	static thread_local int32 ChunkReadScopeDepth = 0;
+}
+
+FFGChunkIndex::FFGChunkIndex()
+	: Epoch(0)
+{
+	for(int32 Shard = 0; Shard < NumShards; Shard++)
+	{
+		PublishedShards[Shard].store(new FShardMap());
+		DirtyShards[Shard] = false;
+	}
+
+	ReaderCounts[0].store(0);
+	ReaderCounts[1].store(0);
+}
+
+FFGChunkIndex::~FFGChunkIndex()
+{
+	Empty();
+
+	for(int32 Shard = 0; Shard < NumShards; Shard++)
+	{
+		delete PublishedShards[Shard].exchange(nullptr);
+	}
+}
+
+bool FFGChunkIndex::Find(FFGChunkKey ChunkKey, FEntry& OutEntry) const
+{
+	checkf(FG::Private::ChunkReadScopeDepth > 0, TEXT("Chunk index read outside of an FFGChunkReadScope!"));
+
+	const FShardMap* Snapshot = PublishedShards[GetShard(ChunkKey)].load();
+
+	if(const FEntry* Entry = Snapshot->Find(ChunkKey))
+	{
+		OutEntry = *Entry;
+		return true;
+	}
+	return false;
+}
+
+void FFGChunkIndex::Add(FFGChunkKey ChunkKey, const FEntry& Entry)
+{
+	check(IsInGameThread());
+
+	const int32 Shard = GetShard(ChunkKey);
+	Shards[Shard].Add(ChunkKey, Entry);
+	DirtyShards[Shard] = true;
+}
+
+void FFGChunkIndex::Remove(FFGChunkKey ChunkKey, int32 ChunkDataIndex)
+{
+	const int32 Shard = GetShard(ChunkKey);
+
+	const FEntry* Entry = Shards[Shard].Find(ChunkKey);
+	if(Entry && Entry->ChunkDataIndex == ChunkDataIndex)
+	{
+		Shards[Shard].Remove(ChunkKey);
+		DirtyShards[Shard] = true;
+	}
+}
+
+void FFGChunkIndex::SetGenerated(FFGChunkKey ChunkKey)
+{
+	check(IsInGameThread());
+
+	const int32 Shard = GetShard(ChunkKey);
+	if(FEntry* Entry = Shards[Shard].Find(ChunkKey))
+	{
+		Entry->Generated = true;
+		DirtyShards[Shard] = true;
+	}
+}
+
+void FFGChunkIndex::RetireSlot(int32 ChunkDataIndex)
+{
+	PendingSlots.Add(ChunkDataIndex);
+}
+
+void FFGChunkIndex::Publish()
+{
+	check(IsInGameThread());
+
+	const uint64 CurrentEpoch = Epoch.load();
+
+	for(int32 Shard = 0; Shard < NumShards; Shard++)
+	{
+		if(!DirtyShards[Shard])
+		{
+			continue;
+		}
+
+		// Readers either see the old snapshot or this one, never a half edited map.
+		FShardMap* OldSnapshot = PublishedShards[Shard].exchange(new FShardMap(Shards[Shard]));
+		Retired.Add({ CurrentEpoch, OldSnapshot, INDEX_NONE });
+		DirtyShards[Shard] = false;
+	}
+
+	// Slots are retired against the same epoch as the snapshots that stopped pointing at them.
+	for(const int32 ChunkDataIndex : PendingSlots)
+	{
+		Retired.Add({ CurrentEpoch, nullptr, ChunkDataIndex });
+	}
+	PendingSlots.Reset();
+}
+
+void FFGChunkIndex::Reclaim(TArray<int32>& OutFreedSlots)
+{
+	check(IsInGameThread());
+
+	if(Retired.IsEmpty())
+	{
+		return;
+	}
+
+	// Two advances drain both parities, which is enough for anything retired before the first.
+	TryAdvanceEpoch() && TryAdvanceEpoch();
+
+	const uint64 CurrentEpoch = Epoch.load();
+	int32 NumReclaimed = 0;
+
+	// Retired is in epoch order, so stop at the first entry that is still too new.
+	for(; NumReclaimed < Retired.Num(); NumReclaimed++)
+	{
+		const FRetired& Entry = Retired[NumReclaimed];
+
+		if(Entry.Epoch + 2 > CurrentEpoch)
+		{
+			break;
+		}
+
+		if(Entry.Snapshot)
+		{
+			delete Entry.Snapshot;
+		}
+		else
+		{
+			OutFreedSlots.Add(Entry.ChunkDataIndex);
+		}
+	}
+
+	Retired.RemoveAt(0, NumReclaimed);
+}
+
+void FFGChunkIndex::Empty()
+{
+	check(IsInGameThread());
+
+	for(int32 Shard = 0; Shard < NumShards; Shard++)
+	{
+		Shards[Shard].Empty();
+		DirtyShards[Shard] = true;
+	}
+
+	PendingSlots.Reset();
+	Publish();
+
+	// Forced flushes are rare, just wait the readers out.
+	while(ReaderCounts[0].load() > 0 || ReaderCounts[1].load() > 0)
+	{
+		FPlatformProcess::Yield();
+	}
+
+	for(const FRetired& Entry : Retired)
+	{
+		delete Entry.Snapshot;
+	}
+	Retired.Reset();
+}
+
+int32 FFGChunkIndex::EnterRead() const
+{
+	const int32 Parity = (int32)(Epoch.load() & 1);
+	ReaderCounts[Parity].fetch_add(1);
+	return Parity;
+}
+
+void FFGChunkIndex::ExitRead(int32 Parity) const
+{
+	ReaderCounts[Parity].fetch_sub(1);
+}
+
+bool FFGChunkIndex::TryAdvanceEpoch()
+{
+	// Readers that entered during the previous epoch share a parity with the next one.
+	const uint64 CurrentEpoch = Epoch.load();
+	if(ReaderCounts[(CurrentEpoch + 1) & 1].load() > 0)
+	{
+		return false;
+	}
+
+	Epoch.store(CurrentEpoch + 1);
+	return true;
+}
+
+FFGChunkReadScope::FFGChunkReadScope(const FFGChunkIndex& InIndex)
+	: Index(InIndex),
+	Parity(InIndex.EnterRead())
+{
+	FG::Private::ChunkReadScopeDepth += 1;
+}
+
+FFGChunkReadScope::~FFGChunkReadScope()
+{
+	FG::Private::ChunkReadScopeDepth -= 1;
+	Index.ExitRead(Parity);
+}
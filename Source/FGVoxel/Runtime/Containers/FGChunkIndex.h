@@ -0,0 +1,129 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Containers/FGChunkKey.h"
+#include <atomic>
+
+struct FFGVoxelChunk;
+
+/**
+ * Read mostly chunk index that any thread can query without taking a lock.
+ *
+ * The game thread is the only writer. It edits its own copy of each shard and
+ * publishes an immutable snapshot of every dirty shard once per grid tick, so
+ * readers only ever see a consistent shard and never see it change underneath
+ * them. Readers must be inside an FFGChunkReadScope for the whole time they
+ * use a snapshot or any chunk found through it.
+ *
+ * Old snapshots and the chunk slots of unloaded chunks are retired against
+ * an epoch, and only freed / recycled once every reader that could have seen
+ * them has left it's read scope. Two epochs have to pass, which in practice
+ * is two grid ticks unless a reader holds on for longer.
+ */
+class FGVOXEL_API FFGChunkIndex
+{
+public:
+
+	struct FEntry
+	{
+		FFGVoxelChunk*	ChunkData = nullptr;		// Stable until the slot is recycled.
+		int32			ChunkDataIndex = INDEX_NONE;
+		bool			Generated = false;
+	};
+
+	static constexpr int32 NumShards = 16;
+
+	FFGChunkIndex();
+	~FFGChunkIndex();
+
+	FFGChunkIndex(const FFGChunkIndex&) = delete;
+	FFGChunkIndex& operator=(const FFGChunkIndex&) = delete;
+
+	/**
+	 * Find a chunk, any thread. Must be inside an FFGChunkReadScope on this index.
+	 * @param ChunkKey The chunk to find.
+	 * @param OutEntry The entry if found, only valid until the read scope ends.
+	 * @return true if the chunk was in the last published snapshot.
+	 */
+	bool Find(FFGChunkKey ChunkKey, FEntry& OutEntry) const;
+
+	//~ Begin Writer (game thread only)
+	void Add(FFGChunkKey ChunkKey, const FEntry& Entry);
+
+	/** Remove a chunk, only if it still maps to the given slot and hasn't been reloaded since. */
+	void Remove(FFGChunkKey ChunkKey, int32 ChunkDataIndex);
+
+	void SetGenerated(FFGChunkKey ChunkKey);
+
+	/** Queue a chunk slot to be recycled once no reader can still be looking at it. */
+	void RetireSlot(int32 ChunkDataIndex);
+
+	/** Publish a new snapshot of every shard changed since the last publish. */
+	void Publish();
+
+	/**
+	 * Advance the epoch if readers have drained, freeing old snapshots.
+	 * @param OutFreedSlots Retired slots that are now safe to reuse are appended here.
+	 */
+	void Reclaim(TArray<int32>& OutFreedSlots);
+
+	/** Drop everything, blocks until all readers have left. */
+	void Empty();
+	//~ End Writer
+
+private:
+
+	friend class FFGChunkReadScope;
+
+	using FShardMap = TMap<FFGChunkKey, FEntry>;
+
+	struct FRetired
+	{
+		uint64		Epoch;
+		FShardMap*	Snapshot;			// Null when retiring a slot.
+		int32		ChunkDataIndex;		// INDEX_NONE when retiring a snapshot.
+	};
+
+	static FORCEINLINE int32 GetShard(FFGChunkKey ChunkKey)
+	{
+		return GetTypeHash(ChunkKey) & (NumShards - 1);
+	}
+
+	int32 EnterRead() const;
+	void ExitRead(int32 Parity) const;
+	bool TryAdvanceEpoch();
+
+	// Reader side.
+	std::atomic<FShardMap*>			PublishedShards[NumShards];
+	std::atomic<uint64>				Epoch;
+	mutable std::atomic<int32>		ReaderCounts[2];	// Active readers by epoch parity.
+
+	// Writer side.
+	FShardMap						Shards[NumShards];
+	bool							DirtyShards[NumShards];
+	TArray<int32>					PendingSlots;		// Retired since the last publish.
+	TArray<FRetired>				Retired;
+};
+
+/**
+ * Marks a thread as reading from an FFGChunkIndex. Anything found through the
+ * index, including chunk data, is only guaranteed to stay alive while this is.
+ * Keep them short, a reader that never leaves stops memory being reclaimed.
+ */
+class FGVOXEL_API FFGChunkReadScope
+{
+public:
+
+	explicit FFGChunkReadScope(const FFGChunkIndex& InIndex);
+	~FFGChunkReadScope();
+
+	FFGChunkReadScope(const FFGChunkReadScope&) = delete;
+	FFGChunkReadScope& operator=(const FFGChunkReadScope&) = delete;
+
+private:
+
+	const FFGChunkIndex& Index;
+	int32 Parity;
+};
@@ -0,0 +1,71 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+/**
+ * Chunk coordinate packed into a single 64 bit integer, 21 signed bits per axis.
+ * That covers +-1,048,575 chunks on every axis, far beyond anything we load, and
+ * makes hashing and comparing keys a single integer op instead of three.
+ */
+struct FFGChunkKey
+{
+	static constexpr int32 BitsPerAxis = 21;
+	static constexpr uint64 AxisMask = (1ull << BitsPerAxis) - 1;
+	static constexpr int32 MinCoordinate = -(1 << (BitsPerAxis - 1));
+	static constexpr int32 MaxCoordinate = (1 << (BitsPerAxis - 1)) - 1;
+
+	FFGChunkKey()
+		: Packed(0)
+	{}
+
+	explicit FFGChunkKey(const FIntVector& ChunkCoordinate)
+		: Packed(Pack(ChunkCoordinate))
+	{}
+
+	/** Unpack back into a chunk coordinate. */
+	FIntVector ToCoordinate() const
+	{
+		return FIntVector(
+			Unpack(Packed),
+			Unpack(Packed >> BitsPerAxis),
+			Unpack(Packed >> (BitsPerAxis * 2)));
+	}
+
+	bool operator==(const FFGChunkKey& Other) const { return Packed == Other.Packed; }
+	bool operator!=(const FFGChunkKey& Other) const { return Packed != Other.Packed; }
+
+	friend FORCEINLINE uint32 GetTypeHash(const FFGChunkKey& Key)
+	{
+		// 64 bit finalizer from MurmurHash3, neighbouring chunks differ in only a couple of
+		// low bits per axis so the bits need a proper mix before open addressing.
+		uint64 Hash = Key.Packed;
+		Hash ^= Hash >> 33;
+		Hash *= 0xff51afd7ed558ccdull;
+		Hash ^= Hash >> 33;
+		Hash *= 0xc4ceb9fe1a85ec53ull;
+		Hash ^= Hash >> 33;
+		return (uint32)Hash;
+	}
+
+	uint64 Packed;
+
+private:
+
+	static FORCEINLINE uint64 Pack(const FIntVector& ChunkCoordinate)
+	{
+		checkSlow(ChunkCoordinate.X >= MinCoordinate && ChunkCoordinate.X <= MaxCoordinate);
+		checkSlow(ChunkCoordinate.Y >= MinCoordinate && ChunkCoordinate.Y <= MaxCoordinate);
+		checkSlow(ChunkCoordinate.Z >= MinCoordinate && ChunkCoordinate.Z <= MaxCoordinate);
+
+		return ((uint64)ChunkCoordinate.X & AxisMask)
+			| (((uint64)ChunkCoordinate.Y & AxisMask) << BitsPerAxis)
+			| (((uint64)ChunkCoordinate.Z & AxisMask) << (BitsPerAxis * 2));
+	}
+
+	static FORCEINLINE int32 Unpack(uint64 Bits)
+	{
+		// Shift the axis up to the top of the word and back down to sign extend it.
+		return (int32)((int64)(Bits << (64 - BitsPerAxis)) >> (64 - BitsPerAxis));
+	}
+};
@@ -0,0 +1,256 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGEditJournal.h"
+#include "Containers/FGRegionStore.h"
+#include "HAL/PlatformFileManager.h"
+#include "Logging/StructuredLog.h"
+#include "Misc/Crc.h"
+
+FFGEditJournal::FFGEditJournal(const FString& InDirectory)
+	: Filename(InDirectory / TEXT("journal.fgj")),
+	WritePipe(UE_SOURCE_LOCATION)
+{
+	if(!ReadJournal())
+	{
+		// Cut the torn tail off now, otherwise new batches would land behind it and never replay.
+		TArray<FRecord> Records;
+		for(const TPair<FIntVector, TArray<FRecord>>& Pair : ReplayedEdits)
+		{
+			Records.Append(Pair.Value);
+		}
+		RewriteJournal(Records);
+	}
+}
+
+FFGEditJournal::~FFGEditJournal()
+{
+	Flush();
+}
+
+bool FFGEditJournal::ReadJournal()
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// We died between deleting the old journal and moving the rewritten one over it.
+	const FString TempFilename = Filename + TEXT(".tmp");
+	if(!PlatformFile.FileExists(*Filename) && PlatformFile.FileExists(*TempFilename))
+	{
+		PlatformFile.MoveFile(*Filename, *TempFilename);
+	}
+
+	TUniquePtr<IFileHandle> ReadFile(PlatformFile.OpenRead(*Filename));
+	if(!ReadFile)
+	{
+		return true; // Nothing to replay.
+	}
+
+	const int64 Size = ReadFile->Size();
+	FileSize = Size;
+
+	FFileHeader Header;
+	if(!ReadFile->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header)) || Header.Magic != FileMagic || Header.Version != FileVersion)
+	{
+		UE_LOGFMT(LogTemp, Warning, "Edit journal {File} is corrupt or out of date, ignoring it.", Filename);
+		return false;
+	}
+
+	TArray<FRecord> Records;
+	int32 NumReplayed = 0;
+
+	while(ReadFile->Tell() < Size)
+	{
+		FBatchHeader Batch;
+		if(!ReadFile->Read(reinterpret_cast<uint8*>(&Batch), sizeof(Batch))
+			|| Batch.Magic != BatchMagic
+			|| ReadFile->Tell() + (int64)Batch.NumRecords * sizeof(FRecord) > Size)
+		{
+			UE_LOGFMT(LogTemp, Warning, "Edit journal {File} has a torn batch, replaying the {Num} edits before it.", Filename, NumReplayed);
+			return false;
+		}
+
+		Records.SetNumUninitialized(Batch.NumRecords, EAllowShrinking::No);
+		if(!ReadFile->Read(reinterpret_cast<uint8*>(Records.GetData()), Records.NumBytes())
+			|| FCrc::MemCrc32(Records.GetData(), Records.NumBytes()) != Batch.Checksum)
+		{
+			UE_LOGFMT(LogTemp, Warning, "Edit journal {File} has a torn batch, replaying the {Num} edits before it.", Filename, NumReplayed);
+			return false;
+		}
+
+		for(const FRecord& Record : Records)
+		{
+			ReplayedEdits.FindOrAdd(Record.ChunkCoordinate).Add(Record);
+		}
+		NumReplayed += Records.Num();
+	}
+
+	if(NumReplayed > 0)
+	{
+		UE_LOGFMT(LogTemp, Display, "Replaying {Num} edits across {Chunks} chunks from {File}.", NumReplayed, ReplayedEdits.Num(), Filename);
+	}
+	return true;
+}
+
+void FFGEditJournal::Append(FIntVector ChunkCoordinate, int32 VoxelIndex, uint32 OldType, uint32 NewType)
+{
+	checkf(IsInGameThread(), TEXT("Edits can only be journaled on the game thread!"));
+	PendingRecords.Add({ ChunkCoordinate, VoxelIndex, OldType, NewType, FDateTime::UtcNow().GetTicks() });
+}
+
+void FFGEditJournal::FlushAsync()
+{
+	checkf(IsInGameThread(), TEXT("The edit journal can only be flushed from the game thread!"));
+
+	if(PendingRecords.IsEmpty())
+	{
+		return;
+	}
+
+	WritePipe.Launch(UE_SOURCE_LOCATION, [this, Records = MoveTemp(PendingRecords)]()
+	{
+		WriteBatch(Records);
+	});
+	PendingRecords.Reset();
+}
+
+void FFGEditJournal::Flush()
+{
+	FlushAsync();
+	WritePipe.WaitUntilEmpty();
+}
+
+void FFGEditJournal::Checkpoint(FFGRegionStore& RegionStore)
+{
+	checkf(IsInGameThread(), TEXT("The edit journal can only be checkpointed from the game thread!"));
+
+	// Everything journaled so far is covered by the saves already queued, except replayed edits
+	// for chunks that haven't loaded since. Those have to carry over into the new journal.
+	TArray<FRecord> Carried;
+	{
+		FReadScopeLock ReadLock(ReplayLock);
+		for(const TPair<FIntVector, TArray<FRecord>>& Pair : ReplayedEdits)
+		{
+			Carried.Append(Pair.Value);
+		}
+	}
+
+	CheckpointInFlight = true;
+	WritePipe.Launch(UE_SOURCE_LOCATION, [this, &RegionStore, Records = MoveTemp(PendingRecords), Carried = MoveTemp(Carried)]()
+	{
+		// Keep the edits durable until the saves covering them really are on disk.
+		WriteBatch(Records);
+		RegionStore.Flush();
+
+		// A save that failed leaves it's edits only in memory, the journal is all that has them.
+		const uint32 NumFailedWrites = RegionStore.GetNumFailedWrites();
+		if(NumFailedWrites != CheckpointFailedWrites)
+		{
+			UE_LOGFMT(LogTemp, Warning, "Region writes failed, keeping edit journal {File} as is.", Filename);
+			CheckpointFailedWrites = NumFailedWrites;
+		}
+		else
+		{
+			RewriteJournal(Carried);
+		}
+		CheckpointInFlight = false;
+	});
+	PendingRecords.Reset();
+}
+
+bool FFGEditJournal::FindReplayedEdits(FIntVector ChunkCoordinate, TArray<FRecord>& OutEdits) const
+{
+	FReadScopeLock ReadLock(ReplayLock);
+
+	if(const TArray<FRecord>* Edits = ReplayedEdits.Find(ChunkCoordinate))
+	{
+		OutEdits = *Edits;
+		return true;
+	}
+	return false;
+}
+
+void FFGEditJournal::MarkSaved(FIntVector ChunkCoordinate)
+{
+	FWriteScopeLock WriteLock(ReplayLock);
+	ReplayedEdits.Remove(ChunkCoordinate);
+}
+
+void FFGEditJournal::WriteBatch(const TArray<FRecord>& Records)
+{
+	if(Records.IsEmpty())
+	{
+		return;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if(!File)
+	{
+		const bool NewFile = !PlatformFile.FileExists(*Filename);
+		if(NewFile)
+		{
+			PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+		}
+
+		File.Reset(PlatformFile.OpenWrite(*Filename, !NewFile, false));
+		if(!File)
+		{
+			UE_LOGFMT(LogTemp, Error, "Failed to open edit journal {File}, {Num} edits are only in memory.", Filename, Records.Num());
+			return;
+		}
+
+		if(NewFile)
+		{
+			const FFileHeader Header = { FileMagic, FileVersion };
+			File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+		}
+	}
+
+	const FBatchHeader Batch = { BatchMagic, (uint32)Records.Num(), FCrc::MemCrc32(Records.GetData(), Records.NumBytes()), 0 };
+	File->Write(reinterpret_cast<const uint8*>(&Batch), sizeof(Batch));
+	File->Write(reinterpret_cast<const uint8*>(Records.GetData()), Records.NumBytes());
+	File->Flush(true);
+
+	FileSize = File->Size();
+}
+
+void FFGEditJournal::RewriteJournal(const TArray<FRecord>& Records)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	File.Reset();
+
+	if(Records.IsEmpty())
+	{
+		PlatformFile.DeleteFile(*Filename);
+		FileSize = 0;
+		return;
+	}
+
+	// Written beside the journal and moved over it, so there is always one complete journal on disk.
+	const FString TempFilename = Filename + TEXT(".tmp");
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	TUniquePtr<IFileHandle> TempFile(PlatformFile.OpenWrite(*TempFilename));
+	if(!TempFile)
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to rewrite edit journal {File}, it will keep growing until the next checkpoint.", Filename);
+		return;
+	}
+
+	const FFileHeader Header = { FileMagic, FileVersion };
+	const FBatchHeader Batch = { BatchMagic, (uint32)Records.Num(), FCrc::MemCrc32(Records.GetData(), Records.NumBytes()), 0 };
+	TempFile->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	TempFile->Write(reinterpret_cast<const uint8*>(&Batch), sizeof(Batch));
+	TempFile->Write(reinterpret_cast<const uint8*>(Records.GetData()), Records.NumBytes());
+	TempFile->Flush(true);
+	TempFile.Reset();
+
+	PlatformFile.DeleteFile(*Filename);
+	if(!PlatformFile.MoveFile(*Filename, *TempFilename))
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to replace edit journal {File} with {Temp}!", Filename, TempFilename);
+		return;
+	}
+
+	FileSize = PlatformFile.FileSize(*Filename);
+}
@@ -0,0 +1,126 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Tasks/Pipe.h"
+
+class FFGRegionStore;
+class IFileHandle;
+
+/**
+ * Append only write ahead log of voxel edits, so edits are durable without
+ * rewriting whole chunks on every change.
+ *
+ * Edits are appended to memory on the game thread, which is all an edit
+ * costs. Flushes hand the pending edits to a background pipe that writes
+ * them as one checksummed batch. A checkpoint folds the journal into the
+ * region files: once the modified chunks have been queued for saving and
+ * the region writes are on disk, the journal is rewritten with only the
+ * edits that still aren't covered by a save.
+ *
+ * On construction any existing journal is read back and it's edits are
+ * handed out per chunk as those chunks generate. A torn batch at the end
+ * of the file (crash mid write) is dropped along with anything after it.
+ * Replaying an edit is idempotent, so replaying over a chunk that already
+ * saved it is harmless.
+ */
+class FGVOXEL_API FFGEditJournal
+{
+public:
+
+	/** A single voxel edit, written to disk as is. */
+	struct FRecord
+	{
+		FIntVector ChunkCoordinate;
+		int32 VoxelIndex;
+		uint32 OldType;
+		uint32 NewType;
+		int64 Timestamp;			// UTC ticks.
+	};
+
+	/**
+	 * @param InDirectory Where the journal lives, the same directory as the region files.
+	 */
+	explicit FFGEditJournal(const FString& InDirectory);
+	~FFGEditJournal();
+
+	FFGEditJournal(const FFGEditJournal&) = delete;
+	FFGEditJournal& operator=(const FFGEditJournal&) = delete;
+
+	/** Record an edit, game thread only. Nothing is written until the next flush. */
+	void Append(FIntVector ChunkCoordinate, int32 VoxelIndex, uint32 OldType, uint32 NewType);
+
+	/** Queue every pending edit to be written as a batch, game thread only. */
+	void FlushAsync();
+
+	/** Flush and block until the journal is on disk, game thread only. */
+	void Flush();
+
+	/**
+	 * Fold the journal into the region files, game thread only.
+	 * Every modified chunk must already have been queued for saving on RegionStore.
+	 * @param RegionStore The store the chunks were saved to, must outlive the journal.
+	 */
+	void Checkpoint(FFGRegionStore& RegionStore);
+
+	/**
+	 * Find edits read back from disk that haven't been saved yet, any thread.
+	 * @param ChunkCoordinate The chunk to find edits for.
+	 * @param OutEdits Replaced with the chunk's edits in the order they were made.
+	 * @return true if the chunk had any edits to replay.
+	 */
+	bool FindReplayedEdits(FIntVector ChunkCoordinate, TArray<FRecord>& OutEdits) const;
+
+	/** The chunk has been saved with it's replayed edits applied, so they no longer need carrying. Game thread only. */
+	void MarkSaved(FIntVector ChunkCoordinate);
+
+	/** Bytes written to the journal since it was last checkpointed. */
+	int64 GetFileSize() const { return FileSize.load(std::memory_order_relaxed); }
+
+	int32 GetNumPendingEdits() const { return PendingRecords.Num(); }
+
+	/** Is a checkpoint still waiting on region writes? */
+	bool IsCheckpointing() const { return CheckpointInFlight.load(std::memory_order_relaxed); }
+
+private:
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+	};
+
+	struct FBatchHeader
+	{
+		uint32 Magic;
+		uint32 NumRecords;
+		uint32 Checksum;			// CRC of the records.
+		uint32 Reserved;
+	};
+
+	static constexpr uint32 FileMagic = 0x4c4a4746; // "FGJL"
+	static constexpr uint32 BatchMagic = 0x424a4746; // "FGJB"
+	static constexpr uint32 FileVersion = 1;
+
+	/** Read back an existing journal, returns false if it had a torn or corrupt tail. */
+	bool ReadJournal();
+
+	/** Write pipe only. */
+	void WriteBatch(const TArray<FRecord>& Records);
+	void RewriteJournal(const TArray<FRecord>& Records);
+
+	FString Filename;
+
+	TArray<FRecord> PendingRecords;
+
+	mutable FRWLock ReplayLock;
+	TMap<FIntVector, TArray<FRecord>> ReplayedEdits;
+
+	TUniquePtr<IFileHandle> File;		// Write pipe only.
+	std::atomic<int64> FileSize = 0;
+	std::atomic<bool> CheckpointInFlight = false;
+	uint32 CheckpointFailedWrites = 0;	// Write pipe only, FFGRegionStore::GetNumFailedWrites as of the last checkpoint.
+
+	UE::Tasks::FPipe WritePipe;
+};
@@ -0,0 +1,87 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+/**
+ * Array made of fixed size pages that are never reallocated, so an element's
+ * address is stable for as long as the array holds it. Growing only allocates
+ * new pages and never copies existing elements.
+ *
+ * Growing is not thread safe, but reading elements through a stored pointer
+ * is safe at any time, the page table is the only thing that ever moves.
+ */
+template<typename ElementType, int32 ElementsPerPage>
+class TFGPagedArray
+{
+	static_assert(ElementsPerPage > 0 && FMath::IsPowerOfTwo(ElementsPerPage), "Page size must be a power of two!");
+
+	static constexpr int32 PageShift = FMath::ConstExprCeilLogTwo(ElementsPerPage);
+	static constexpr int32 PageMask = ElementsPerPage - 1;
+
+public:
+
+	TFGPagedArray() = default;
+	TFGPagedArray(const TFGPagedArray&) = delete;
+	TFGPagedArray& operator=(const TFGPagedArray&) = delete;
+
+	~TFGPagedArray()
+	{
+		Empty();
+	}
+
+	FORCEINLINE int32 Num() const { return NumElements; }
+
+	FORCEINLINE bool IsValidIndex(int32 Index) const
+	{
+		return Index >= 0 && Index < NumElements;
+	}
+
+	FORCEINLINE ElementType& operator[](int32 Index)
+	{
+		checkf(IsValidIndex(Index), TEXT("Paged array index %d out of bounds!"), Index);
+		return Pages[Index >> PageShift][Index & PageMask];
+	}
+
+	FORCEINLINE const ElementType& operator[](int32 Index) const
+	{
+		checkf(IsValidIndex(Index), TEXT("Paged array index %d out of bounds!"), Index);
+		return Pages[Index >> PageShift][Index & PageMask];
+	}
+
+	/**
+	 * Grow so that at least NewNum elements exist, default constructing new pages.
+	 * Never shrinks, and never moves existing elements.
+	 * @param NewNum The minimum number of elements.
+	 */
+	void GrowTo(int32 NewNum)
+	{
+		while(Pages.Num() * ElementsPerPage < NewNum)
+		{
+			Pages.Add(new ElementType[ElementsPerPage]);
+		}
+		NumElements = FMath::Max(NumElements, NewNum);
+	}
+
+	/** Destroy every element and free every page. */
+	void Empty()
+	{
+		for(ElementType* Page : Pages)
+		{
+			delete[] Page;
+		}
+		Pages.Empty();
+		NumElements = 0;
+	}
+
+	/** Bytes allocated for pages and the page table. */
+	SIZE_T GetAllocatedSize() const
+	{
+		return Pages.Num() * ElementsPerPage * sizeof(ElementType) + Pages.GetAllocatedSize();
+	}
+
+private:
+
+	TArray<ElementType*>	Pages;
+	int32					NumElements = 0;
+};
@@ -0,0 +1,401 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGRegionStore.h"
+#include "Containers/FGVoxelChunk.h"
+#include "Async/AsyncFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Logging/StructuredLog.h"
+
+namespace FG
+{
+	static float RegionCompactionRatio = 1.0f;
+	FAutoConsoleVariableRef CVarRegionCompactionRatio (
+		TEXT("FG.RegionCompactionRatio"),
+		RegionCompactionRatio,
+		TEXT("Compact a region file once it's dead payload bytes exceed this multiple of it's live bytes."),
+		ECVF_Default
+	);
+
+	static int32 RegionDeltaMaxVoxels = 2048;
+	FAutoConsoleVariableRef CVarRegionDeltaMaxVoxels (
+		TEXT("FG.RegionDeltaMaxVoxels"),
+		RegionDeltaMaxVoxels,
+		TEXT("Save chunks with at most this many voxels changed from the generator's output as a delta, 0 always saves in full."),
+		ECVF_Default
+	);
+}
+
+FFGRegionStore::FFGRegionStore(const FString& InDirectory)
+	: Directory(InDirectory),
+	WritePipe(UE_SOURCE_LOCATION)
+{
+}
+
+FFGRegionStore::~FFGRegionStore()
+{
+	Flush();
+}
+
+FIntVector FFGRegionStore::GetRegionCoordinate(FIntVector ChunkCoordinate)
+{
+	// Arithmetic shift floors, so negative chunks land in negative regions.
+	return FIntVector(
+		ChunkCoordinate.X >> RegionShift,
+		ChunkCoordinate.Y >> RegionShift,
+		ChunkCoordinate.Z >> RegionShift);
+}
+
+int32 FFGRegionStore::GetTableIndex(FIntVector ChunkCoordinate)
+{
+	constexpr int32 Mask = RegionSize - 1;
+	return (ChunkCoordinate.X & Mask)
+		+ (ChunkCoordinate.Y & Mask) * RegionSize
+		+ (ChunkCoordinate.Z & Mask) * RegionSize * RegionSize;
+}
+
+TSharedRef<FFGRegionStore::FRegion> FFGRegionStore::FindOrOpenRegion(FIntVector RegionCoordinate)
+{
+	FScopeLock ScopeLock(&RegionsLock);
+
+	if(const TSharedRef<FRegion>* Region = Regions.Find(RegionCoordinate))
+	{
+		return *Region;
+	}
+
+	TSharedRef<FRegion> Region = MakeShared<FRegion>();
+	Region->Filename = Directory / FString::Printf(TEXT("r.%d.%d.%d.fgr"), RegionCoordinate.X, RegionCoordinate.Y, RegionCoordinate.Z);
+	Region->Table.SetNumZeroed(RegionSizeXYZ);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	RecoverRegionFile(Region->Filename);
+
+	// Missing files are remembered as empty regions so we don't hit the disk again.
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenRead(*Region->Filename));
+	if(File)
+	{
+		FFileHeader Header;
+		const bool ReadOk = File->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header))
+			&& Header.Magic == FileMagic
+			&& Header.Version == FileVersion
+			&& Header.RegionSize == RegionSize
+			&& File->Read(reinterpret_cast<uint8*>(Region->Table.GetData()), Region->Table.NumBytes());
+
+		if(ReadOk)
+		{
+			Region->FileSize = File->Size();
+			for(const FTableEntry& Entry : Region->Table)
+			{
+				Region->LiveBytes += Entry.Size;
+			}
+			Region->ReadHandle.Reset(PlatformFile.OpenAsyncRead(*Region->Filename));
+		}
+		else
+		{
+			UE_LOGFMT(LogTemp, Warning, "Region file {File} is corrupt or out of date, ignoring it.", Region->Filename);
+			FMemory::Memzero(Region->Table.GetData(), Region->Table.NumBytes());
+		}
+	}
+
+	Regions.Add(RegionCoordinate, Region);
+	return Region;
+}
+
+bool FFGRegionStore::LoadChunk(FIntVector ChunkCoordinate, FFGVoxelChunk& OutChunk)
+{
+	// Anything still waiting on the pipe is newer than what's on disk.
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		if(const FPendingWrite* PendingWrite = PendingWrites.Find(ChunkCoordinate))
+		{
+			return OutChunk.Decompress(PendingWrite->Bytes);
+		}
+	}
+
+	TSharedRef<FRegion> Region = FindOrOpenRegion(GetRegionCoordinate(ChunkCoordinate));
+	FReadScopeLock ReadLock(Region->Lock);
+
+	const FTableEntry Entry = Region->Table[GetTableIndex(ChunkCoordinate)];
+	if(Entry.Size == 0 || !Region->ReadHandle)
+	{
+		return false;
+	}
+
+	TUniquePtr<IAsyncReadRequest> Request(Region->ReadHandle->ReadRequest(Entry.Offset, Entry.Size));
+	if(!Request)
+	{
+		return false;
+	}
+
+	Request->WaitCompletion();
+	uint8* Payload = Request->GetReadResults(); // Ours to free.
+
+	bool Loaded = false;
+	if(Payload && FFGVoxelChunk::IsDeltaBlob(MakeArrayView(Payload, Entry.Size)))
+	{
+		if(BaselineGenerator)
+		{
+			OutChunk.Reset();
+			BaselineGenerator(ChunkCoordinate, OutChunk);
+			Loaded = OutChunk.ApplyDelta(MakeArrayView(Payload, Entry.Size), BaselineId);
+		}
+	}
+	else if(Payload)
+	{
+		Loaded = OutChunk.Decompress(MakeArrayView(Payload, Entry.Size));
+	}
+	FMemory::Free(Payload);
+
+	if(!Loaded)
+	{
+		UE_LOGFMT(LogTemp, Warning, "Failed to load chunk {Chunk} from {File}, it will be regenerated.", ChunkCoordinate.ToString(), Region->Filename);
+	}
+	return Loaded;
+}
+
+void FFGRegionStore::SaveChunk(FIntVector ChunkCoordinate, const FFGVoxelChunk& Chunk)
+{
+	uint64 Sequence;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		FPendingWrite& PendingWrite = PendingWrites.FindOrAdd(ChunkCoordinate);
+		PendingWrite.Sequence = Sequence = NextSequence++;
+		Chunk.Compress(PendingWrite.Bytes);
+	}
+
+	WritePipe.Launch(UE_SOURCE_LOCATION, [this, ChunkCoordinate, Sequence]()
+	{
+		WriteChunk(ChunkCoordinate, Sequence);
+	});
+}
+
+void FFGRegionStore::Flush()
+{
+	WritePipe.WaitUntilEmpty();
+}
+
+void FFGRegionStore::SetBaseline(uint32 InBaselineId, FBaselineGenerator InBaselineGenerator)
+{
+	// Queued writes were made against the old baseline.
+	Flush();
+
+	BaselineId = InBaselineId;
+	BaselineGenerator = MoveTemp(InBaselineGenerator);
+}
+
+void FFGRegionStore::WriteChunk(FIntVector ChunkCoordinate, uint64 Sequence)
+{
+	TArray<uint8> Bytes;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		const FPendingWrite* PendingWrite = PendingWrites.Find(ChunkCoordinate);
+		if(!PendingWrite || PendingWrite->Sequence != Sequence) // Superseded, the newer save writes it.
+		{
+			return;
+		}
+		Bytes = PendingWrite->Bytes;
+	}
+
+	// Lightly edited chunks store far smaller as the difference from what the generator makes.
+	if(BaselineId != 0 && BaselineGenerator && FG::RegionDeltaMaxVoxels > 0)
+	{
+		FFGVoxelChunk Chunk;
+		FFGVoxelChunk Baseline;
+		TArray<uint8> DeltaBytes;
+
+		BaselineGenerator(ChunkCoordinate, Baseline);
+		if(Chunk.Decompress(Bytes)
+			&& Chunk.CompressDelta(Baseline, BaselineId, FG::RegionDeltaMaxVoxels, DeltaBytes)
+			&& DeltaBytes.Num() < Bytes.Num())
+		{
+			Bytes = MoveTemp(DeltaBytes);
+		}
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TSharedRef<FRegion> Region = FindOrOpenRegion(GetRegionCoordinate(ChunkCoordinate));
+	FWriteScopeLock WriteLock(Region->Lock);
+
+	// Close our read handle first, some platforms won't let us write to a file with it open.
+	Region->ReadHandle.Reset();
+
+	const bool NewFile = Region->FileSize == 0;
+	if(NewFile)
+	{
+		PlatformFile.CreateDirectoryTree(*Directory);
+	}
+
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*Region->Filename, !NewFile, true));
+	if(!File)
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to open {File} for writing, chunk {Chunk} was not saved.", Region->Filename, ChunkCoordinate.ToString());
+		return;
+	}
+
+	// On failure the table and the pending write are left alone, so loads keep getting the chunk from
+	// memory and the next save of it tries again. Counted so a checkpoint keeps the journal.
+	auto FailWrite = [&]()
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to write chunk {Chunk} to {File}, it was not saved.", ChunkCoordinate.ToString(), Region->Filename);
+		File.Reset();
+		Region->ReadHandle.Reset(PlatformFile.OpenAsyncRead(*Region->Filename));
+		NumFailedWrites++;
+	};
+
+	if(NewFile) // Header and an empty table, so every offset is fixed from the start.
+	{
+		const FFileHeader Header = { FileMagic, FileVersion, RegionSize, 0 };
+		if(!File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header))
+			|| !File->Write(reinterpret_cast<const uint8*>(Region->Table.GetData()), Region->Table.NumBytes()))
+		{
+			FailWrite(); // Still size 0, so the next write starts the file over.
+			return;
+		}
+		Region->FileSize = PayloadOffset;
+	}
+
+	// Payload first, then the table entry, so the old payload stays valid if we die in between.
+	// Both are synced, the edit journal drops the edits a save covers once Flush returns.
+	FTableEntry& Entry = Region->Table[GetTableIndex(ChunkCoordinate)];
+	const FTableEntry NewEntry = { (uint32)Region->FileSize, (uint32)Bytes.Num() };
+
+	if(!File->Seek(Region->FileSize)
+		|| !File->Write(Bytes.GetData(), Bytes.Num())
+		|| !File->Flush(true)
+		|| !File->Seek(TableOffset + GetTableIndex(ChunkCoordinate) * sizeof(FTableEntry))
+		|| !File->Write(reinterpret_cast<const uint8*>(&NewEntry), sizeof(NewEntry))
+		|| !File->Flush(true))
+	{
+		FailWrite();
+		return;
+	}
+	File.Reset();
+
+	Region->LiveBytes += (int64)NewEntry.Size - Entry.Size;
+	Region->FileSize += NewEntry.Size;
+	Entry = NewEntry;
+
+	const int64 DeadBytes = Region->FileSize - PayloadOffset - Region->LiveBytes;
+	if(DeadBytes > Region->LiveBytes * FG::RegionCompactionRatio)
+	{
+		CompactRegion(*Region);
+	}
+
+	Region->ReadHandle.Reset(PlatformFile.OpenAsyncRead(*Region->Filename));
+
+	// Only now is it safe for loads to go to disk for this chunk.
+	FScopeLock ScopeLock(&PendingLock);
+	const FPendingWrite* PendingWrite = PendingWrites.Find(ChunkCoordinate);
+	if(PendingWrite && PendingWrite->Sequence == Sequence)
+	{
+		PendingWrites.Remove(ChunkCoordinate);
+	}
+}
+
+void FFGRegionStore::CompactRegion(FRegion& Region)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	const FString TempFilename = Region.Filename + TEXT(".tmp");
+	TUniquePtr<IFileHandle> Source(PlatformFile.OpenRead(*Region.Filename));
+	TUniquePtr<IFileHandle> Dest(PlatformFile.OpenWrite(*TempFilename));
+
+	if(!Source || !Dest)
+	{
+		return;
+	}
+
+	const FFileHeader Header = { FileMagic, FileVersion, RegionSize, 0 };
+	TArray<FTableEntry> NewTable;
+	NewTable.SetNumZeroed(RegionSizeXYZ);
+
+	Dest->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	Dest->Write(reinterpret_cast<const uint8*>(NewTable.GetData()), NewTable.NumBytes());
+
+	// Copy live payloads across back to back in table order.
+	TArray<uint8> Payload;
+	int64 Offset = PayloadOffset;
+
+	for(int32 Index = 0; Index < RegionSizeXYZ; Index++)
+	{
+		const FTableEntry& Entry = Region.Table[Index];
+		if(Entry.Size == 0)
+		{
+			continue;
+		}
+
+		Payload.SetNumUninitialized(Entry.Size, EAllowShrinking::No);
+		if(!Source->Seek(Entry.Offset) || !Source->Read(Payload.GetData(), Entry.Size) || !Dest->Write(Payload.GetData(), Entry.Size))
+		{
+			UE_LOGFMT(LogTemp, Warning, "Failed to compact {File}, leaving it as is.", Region.Filename);
+			Dest.Reset();
+			PlatformFile.DeleteFile(*TempFilename);
+			return;
+		}
+
+		NewTable[Index] = { (uint32)Offset, Entry.Size };
+		Offset += Entry.Size;
+	}
+
+	Dest->Seek(TableOffset);
+	Dest->Write(reinterpret_cast<const uint8*>(NewTable.GetData()), NewTable.NumBytes());
+	Dest->Flush(true); // On disk before it replaces the region, or a power cut could leave neither.
+	Dest.Reset();
+	Source.Reset();
+
+	// Swap the compacted file in. The old file is only moved aside until the new one is in place, so
+	// there's always a complete region on disk, see RecoverRegionFile. The table only changes once it's there.
+	const FString OldFilename = GetOldRegionFilename(Region.Filename);
+	PlatformFile.DeleteFile(*OldFilename);
+
+	if(!PlatformFile.MoveFile(*OldFilename, *Region.Filename))
+	{
+		UE_LOGFMT(LogTemp, Warning, "Failed to move {File} aside to compact it, leaving it as is.", Region.Filename);
+		PlatformFile.DeleteFile(*TempFilename);
+		return;
+	}
+
+	if(!PlatformFile.MoveFile(*Region.Filename, *TempFilename))
+	{
+		UE_LOGFMT(LogTemp, Warning, "Failed to replace {File} with it's compacted copy, leaving it as is.", Region.Filename);
+		if(!PlatformFile.MoveFile(*Region.Filename, *OldFilename))
+		{
+			UE_LOGFMT(LogTemp, Error, "Failed to move {Old} back to {File}, it's restored next time the region is opened.", OldFilename, Region.Filename);
+		}
+		PlatformFile.DeleteFile(*TempFilename);
+		return;
+	}
+
+	PlatformFile.DeleteFile(*OldFilename);
+	Region.Table = MoveTemp(NewTable);
+	Region.FileSize = Offset;
+}
+
+FString FFGRegionStore::GetOldRegionFilename(const FString& Filename)
+{
+	return Filename + TEXT(".old");
+}
+
+void FFGRegionStore::RecoverRegionFile(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	const FString OldFilename = GetOldRegionFilename(Filename);
+	if(!PlatformFile.FileExists(*OldFilename))
+	{
+		return;
+	}
+
+	if(PlatformFile.FileExists(*Filename)) // Died after the compacted copy was swapped in, the old one is just garbage.
+	{
+		PlatformFile.DeleteFile(*OldFilename);
+	}
+	else if(PlatformFile.MoveFile(*Filename, *OldFilename)) // Died before it, the old one is still the region.
+	{
+		UE_LOGFMT(LogTemp, Warning, "Restored {File} from an interrupted compaction.", Filename);
+	}
+	else
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to restore {File} from {Old}, the region's chunks won't load!", Filename, OldFilename);
+	}
+}
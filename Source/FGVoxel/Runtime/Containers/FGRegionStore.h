@@ -0,0 +1,151 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Tasks/Pipe.h"
+
+struct FFGVoxelChunk;
+class IAsyncReadFileHandle;
+
+/**
+ * On disk storage for chunks, grouped into region files of 32x32x32 chunks.
+ *
+ * Each region file starts with a fixed size header and an offset table with
+ * one entry per chunk, followed by compressed chunk payloads. Writes append
+ * a new payload and then patch the chunk's table entry, so a crash mid write
+ * leaves the old payload in place. Superseded payloads are dead space, which
+ * is compacted away once it outweighs the live payloads. Compaction writes
+ * a copy and swaps it in, moving the old file aside until the copy is in
+ * place, so an interrupted swap is finished or undone when the region opens.
+ *
+ * Loads are safe from any thread and read through async file I/O, so they
+ * can run on the generation workers. Saves are compressed on the calling
+ * thread and written in order on a background pipe, anything still queued
+ * is served from memory so a load never sees a stale payload.
+ *
+ * With a baseline set, chunks are written as a sparse delta against what the
+ * generator makes for them, as long as few enough voxels differ. Loading a
+ * delta regenerates the chunk and applies it, so a lightly edited world costs
+ * a handful of bytes per chunk. Heavily edited chunks fall back to full
+ * storage past FG.RegionDeltaMaxVoxels.
+ */
+class FGVOXEL_API FFGRegionStore
+{
+public:
+
+	static constexpr int32 RegionShift = 5;
+	static constexpr int32 RegionSize = 1 << RegionShift;
+	static constexpr int32 RegionSizeXYZ = RegionSize * RegionSize * RegionSize;
+
+	/** Regenerates a chunk's unedited contents into a reset chunk, called from any thread. */
+	using FBaselineGenerator = TFunction<void(FIntVector ChunkCoordinate, FFGVoxelChunk& OutChunk)>;
+
+	/**
+	 * @param InDirectory Where the region files live, created on first save.
+	 */
+	explicit FFGRegionStore(const FString& InDirectory);
+	~FFGRegionStore();
+
+	FFGRegionStore(const FFGRegionStore&) = delete;
+	FFGRegionStore& operator=(const FFGRegionStore&) = delete;
+
+	/**
+	 * Load a saved chunk, any thread. Blocks the calling thread on the read.
+	 * @param ChunkCoordinate The chunk to load.
+	 * @param OutChunk Replaced with the saved chunk if there was one.
+	 * @return true if the chunk was saved and loaded successfully.
+	 */
+	bool LoadChunk(FIntVector ChunkCoordinate, FFGVoxelChunk& OutChunk);
+
+	/**
+	 * Queue a chunk to be written to it's region file.
+	 * @param ChunkCoordinate The chunk to save.
+	 * @param Chunk The chunk contents, compressed before this returns.
+	 */
+	void SaveChunk(FIntVector ChunkCoordinate, const FFGVoxelChunk& Chunk);
+
+	/** Block until every queued save is on disk, synced so it survives a power cut. */
+	void Flush();
+
+	/** How many queued saves failed to write, ever. A failed save stays pending until the chunk is saved again. */
+	uint32 GetNumFailedWrites() const { return NumFailedWrites.load(std::memory_order_relaxed); }
+
+	/**
+	 * Save chunks as deltas against a regenerated baseline where they are small enough.
+	 * Flushes first, and no loads may be running while it's changed.
+	 * @param InBaselineId Identifies the generator, deltas saved against a different id fail to load. 0 turns deltas off.
+	 * @param InBaselineGenerator Regenerates a chunk's unedited contents.
+	 */
+	void SetBaseline(uint32 InBaselineId, FBaselineGenerator InBaselineGenerator);
+
+	const FString& GetDirectory() const { return Directory; }
+
+private:
+
+	struct FTableEntry
+	{
+		uint32 Offset = 0;	// Byte offset of the payload in the file, 0 when not saved.
+		uint32 Size = 0;
+	};
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 RegionSize;
+		uint32 Reserved;
+	};
+
+	static constexpr uint32 FileMagic = 0x47524746; // "FGRG"
+	static constexpr uint32 FileVersion = 1;
+	static constexpr int64 TableOffset = sizeof(FFileHeader);
+	static constexpr int64 PayloadOffset = TableOffset + RegionSizeXYZ * sizeof(FTableEntry);
+
+	struct FRegion
+	{
+		FString Filename;
+		FRWLock Lock;						// Readers hold it shared across the whole read.
+		TArray<FTableEntry> Table;
+		int64 FileSize = 0;					// 0 when there is no file yet.
+		int64 LiveBytes = 0;
+		TUniquePtr<IAsyncReadFileHandle> ReadHandle;
+	};
+
+	struct FPendingWrite
+	{
+		uint64 Sequence;
+		TArray<uint8> Bytes;
+	};
+
+	static FIntVector GetRegionCoordinate(FIntVector ChunkCoordinate);
+	static int32 GetTableIndex(FIntVector ChunkCoordinate);
+
+	/** Where CompactRegion moves a region file aside while it swaps the compacted copy in. */
+	static FString GetOldRegionFilename(const FString& Filename);
+
+	/** Finish or undo a compaction that was interrupted part way through swapping files. */
+	static void RecoverRegionFile(const FString& Filename);
+
+	/** Find a region, reading it's table from disk the first time it's used. */
+	TSharedRef<FRegion> FindOrOpenRegion(FIntVector RegionCoordinate);
+
+	/** Write pipe only. */
+	void WriteChunk(FIntVector ChunkCoordinate, uint64 Sequence);
+	void CompactRegion(FRegion& Region);
+
+	FString Directory;
+
+	FCriticalSection RegionsLock;
+	TMap<FIntVector, TSharedRef<FRegion>> Regions;
+
+	FCriticalSection PendingLock;
+	TMap<FIntVector, FPendingWrite> PendingWrites;
+	uint64 NextSequence = 0;
+	std::atomic<uint32> NumFailedWrites = 0;
+
+	uint32 BaselineId = 0;
+	FBaselineGenerator BaselineGenerator;
+
+	UE::Tasks::FPipe WritePipe;
+};
@@ -0,0 +1,181 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelArena.h"
+#include "FGVoxelChunk.h"
+#include "Logging/StructuredLog.h"
+
+DECLARE_STATS_GROUP(TEXT("FGVoxelArena"), STATGROUP_FGVoxelArena, STATCAT_Advanced);
+
+DECLARE_MEMORY_STAT(TEXT("Committed 1 Bit"),		STAT_FGVoxelArena_Committed1,		STATGROUP_FGVoxelArena);
+DECLARE_MEMORY_STAT(TEXT("Committed 2 Bit"),		STAT_FGVoxelArena_Committed2,		STATGROUP_FGVoxelArena);
+DECLARE_MEMORY_STAT(TEXT("Committed 4 Bit"),		STAT_FGVoxelArena_Committed4,		STATGROUP_FGVoxelArena);
+DECLARE_MEMORY_STAT(TEXT("Committed 8 Bit"),		STAT_FGVoxelArena_Committed8,		STATGROUP_FGVoxelArena);
+DECLARE_MEMORY_STAT(TEXT("Committed 16 Bit"),		STAT_FGVoxelArena_Committed16,		STATGROUP_FGVoxelArena);
+DECLARE_MEMORY_STAT(TEXT("Committed Other"),		STAT_FGVoxelArena_CommittedOther,	STATGROUP_FGVoxelArena);
+
+namespace FG
+{
+	static int32 VoxelArenaSlabReserveMB = 4096;
+	FAutoConsoleVariableRef CVarVoxelArenaSlabReserveMB (
+		TEXT("FG.VoxelArenaSlabReserveMB"),
+		VoxelArenaSlabReserveMB,
+		TEXT("Virtual address space reserved per chunk size class in MB, only read when a slab is first used."),
+		ECVF_ReadOnly
+	);
+
+	static FAutoConsoleCommand CmdDumpVoxelArena(
+		TEXT("FG.DumpVoxelArena"),
+		TEXT("Dump committed memory and block usage for every chunk size class."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			SIZE_T TotalCommitted = 0;
+
+			for(int32 Bits = 1; Bits < FFGVoxelArena::NumSizeClasses; Bits++)
+			{
+				const FFGVoxelArena::FSizeClassStats Stats = FFGVoxelArena::Get().GetStats(Bits);
+
+				if(Stats.ReservedBytes == 0) // Never used.
+				{
+					continue;
+				}
+
+				UE_LOGFMT(LogTemp, Display, "Arena [{Bits} bits] Block: {BlockSize} B, Committed: {Committed} KB, In Use: {InUse}, Free: {Free}",
+					Bits,
+					Stats.BlockSize,
+					Stats.CommittedBytes / 1024,
+					Stats.BlocksInUse,
+					Stats.BlocksFree);
+
+				TotalCommitted += Stats.CommittedBytes;
+			}
+
+			UE_LOGFMT(LogTemp, Display, "Arena Total Committed: {Committed} KB", TotalCommitted / 1024);
+		})
+	);
+}
+
+FFGVoxelArena& FFGVoxelArena::Get()
+{
+	// Intentionally leaked, chunks can outlive static destruction order.
+	static FFGVoxelArena* Arena = new FFGVoxelArena();
+	return *Arena;
+}
+
+uint8* FFGVoxelArena::Allocate(int32 BitsPerVoxel)
+{
+	checkf(BitsPerVoxel > 0 && BitsPerVoxel <= MaxBitsPerVoxel, TEXT("Invalid arena size class %d!"), BitsPerVoxel);
+
+	FSlab& Slab = Slabs[BitsPerVoxel];
+	FScopeLock Lock(&Slab.Lock);
+
+	if(Slab.BlockSize == 0) // First use, reserve the address range.
+	{
+		InitSlab(Slab, BitsPerVoxel);
+	}
+
+	Slab.BlocksInUse += 1;
+
+	if(FFreeBlock* FreeBlock = Slab.FreeList) // Reuse a freed block.
+	{
+		Slab.FreeList = FreeBlock->Next;
+		Slab.BlocksFree -= 1;
+		return reinterpret_cast<uint8*>(FreeBlock);
+	}
+
+	// Bump allocate, committing more of the range if we need to.
+	const SIZE_T Offset = Slab.UsedBytes;
+	Slab.UsedBytes += Slab.BlockSize;
+	checkf(Slab.UsedBytes <= Slab.VirtualBlock.GetActualSize(), TEXT("Voxel arena exhausted for %d bits per voxel, raise FG.VoxelArenaSlabReserveMB!"), BitsPerVoxel);
+
+	if(Slab.UsedBytes > Slab.CommittedBytes)
+	{
+		// Commit in large steps so we aren't calling into the OS for every chunk.
+		const SIZE_T CommitStep = FMath::Max<SIZE_T>(FPlatformMemory::FPlatformVirtualMemoryBlock::GetCommitAlignment(), 1024 * 1024);
+		const SIZE_T NewCommitted = FMath::Min(Align(Slab.UsedBytes, CommitStep), Slab.VirtualBlock.GetActualSize());
+
+		Slab.VirtualBlock.Commit(Slab.CommittedBytes, NewCommitted - Slab.CommittedBytes);
+		Slab.CommittedBytes = NewCommitted;
+		UpdateStats(BitsPerVoxel, Slab);
+	}
+
+	return static_cast<uint8*>(Slab.VirtualBlock.GetVirtualPointer()) + Offset;
+}
+
+void FFGVoxelArena::Free(int32 BitsPerVoxel, uint8* Block)
+{
+	checkf(BitsPerVoxel > 0 && BitsPerVoxel <= MaxBitsPerVoxel, TEXT("Invalid arena size class %d!"), BitsPerVoxel);
+
+	FSlab& Slab = Slabs[BitsPerVoxel];
+	FScopeLock Lock(&Slab.Lock);
+
+	checkf(Block >= Slab.VirtualBlock.GetVirtualPointer()
+		&& Block < static_cast<uint8*>(Slab.VirtualBlock.GetVirtualPointer()) + Slab.UsedBytes,
+		TEXT("Freed block does not belong to the %d bit slab!"), BitsPerVoxel);
+
+	FFreeBlock* FreeBlock = reinterpret_cast<FFreeBlock*>(Block);
+	FreeBlock->Next = Slab.FreeList;
+	Slab.FreeList = FreeBlock;
+
+	Slab.BlocksInUse -= 1;
+	Slab.BlocksFree += 1;
+}
+
+SIZE_T FFGVoxelArena::GetPaletteBytes(int32 BitsPerVoxel)
+{
+	return ((SIZE_T)1 << BitsPerVoxel) * FFGVoxelChunk::GetPaletteEntrySize();
+}
+
+SIZE_T FFGVoxelArena::GetBlockSize(int32 BitsPerVoxel)
+{
+	// Cache line aligned so neighbouring chunks never share a line.
+	return Align(GetVoxelBytes(BitsPerVoxel) + GetPaletteBytes(BitsPerVoxel), PLATFORM_CACHE_LINE_SIZE);
+}
+
+FFGVoxelArena::FSizeClassStats FFGVoxelArena::GetStats(int32 BitsPerVoxel) const
+{
+	const FSlab& Slab = Slabs[BitsPerVoxel];
+	FScopeLock Lock(&Slab.Lock);
+
+	FSizeClassStats Stats;
+	Stats.BlockSize = Slab.BlockSize;
+	Stats.ReservedBytes = Slab.BlockSize > 0 ? Slab.VirtualBlock.GetActualSize() : 0;
+	Stats.CommittedBytes = Slab.CommittedBytes;
+	Stats.BlocksInUse = Slab.BlocksInUse;
+	Stats.BlocksFree = Slab.BlocksFree;
+	return Stats;
+}
+
+void FFGVoxelArena::InitSlab(FSlab& Slab, int32 BitsPerVoxel)
+{
+	const SIZE_T ReserveBytes = (SIZE_T)FMath::Max(FG::VoxelArenaSlabReserveMB, 1) * 1024 * 1024;
+
+	Slab.BlockSize = GetBlockSize(BitsPerVoxel);
+	Slab.VirtualBlock = FPlatformMemory::FPlatformVirtualMemoryBlock::AllocateVirtual(FMath::Max(ReserveBytes, Slab.BlockSize));
+}
+
+void FFGVoxelArena::UpdateStats(int32 BitsPerVoxel, const FSlab& Slab)
+{
+	switch(BitsPerVoxel)
+	{
+	case 1:		SET_MEMORY_STAT(STAT_FGVoxelArena_Committed1, Slab.CommittedBytes); break;
+	case 2:		SET_MEMORY_STAT(STAT_FGVoxelArena_Committed2, Slab.CommittedBytes); break;
+	case 4:		SET_MEMORY_STAT(STAT_FGVoxelArena_Committed4, Slab.CommittedBytes); break;
+	case 8:		SET_MEMORY_STAT(STAT_FGVoxelArena_Committed8, Slab.CommittedBytes); break;
+	case 16:	SET_MEMORY_STAT(STAT_FGVoxelArena_Committed16, Slab.CommittedBytes); break;
+	default: // Tightly packed widths all share one stat.
+		{
+			SIZE_T OtherCommitted = 0;
+			for(int32 Bits = 3; Bits < NumSizeClasses; Bits++)
+			{
+				if(FMath::IsPowerOfTwo(Bits))
+				{
+					continue;
+				}
+				OtherCommitted += Slabs[Bits].CommittedBytes; // Racy read, fine for stats.
+			}
+			SET_MEMORY_STAT(STAT_FGVoxelArena_CommittedOther, OtherCommitted);
+		}
+		break;
+	}
+}
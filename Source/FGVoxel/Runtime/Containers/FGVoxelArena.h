@@ -0,0 +1,99 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "FGVoxelDefines.h"
+#include "HAL/PlatformMemory.h"
+
+/**
+ * Size class arena for chunk storage.
+ *
+ * Every bits per voxel width gets its own slab, a single range reserved up front
+ * in virtual address space that is committed page by page as it fills up. Each
+ * slab hands out fixed size blocks big enough for the voxel words and the palette
+ * of a chunk at that width, and freed blocks are threaded onto an intrusive free
+ * list so reuse is a single pointer pop.
+ *
+ * Because all chunks of the same width live next to each other, walking every
+ * chunk of a size class is a linear walk over one address range. Growing or
+ * shrinking a chunk palette moves the chunk into the neighbouring slab.
+ */
+class FGVOXEL_API FFGVoxelArena
+{
+public:
+
+	static constexpr int32 MaxBitsPerVoxel = 16;
+
+	/** Slabs are indexed by bits per voxel, 0 (uniform) never allocates. */
+	static constexpr int32 NumSizeClasses = MaxBitsPerVoxel + 1;
+
+	struct FSizeClassStats
+	{
+		SIZE_T BlockSize = 0;		// Bytes per chunk block, including padding.
+		SIZE_T ReservedBytes = 0;	// Virtual address space reserved.
+		SIZE_T CommittedBytes = 0;	// Physical memory committed.
+		int32 BlocksInUse = 0;		// Chunks currently living in this slab.
+		int32 BlocksFree = 0;		// Blocks sitting on the free list.
+	};
+
+	/** The arena shared by every chunk. */
+	static FFGVoxelArena& Get();
+
+	/**
+	 * Allocate a block for a chunk at the given width. Thread safe.
+	 * @param BitsPerVoxel Width of the chunk, 1 to 16.
+	 * @return The block, GetBlockSize(BitsPerVoxel) bytes long, contents undefined.
+	 */
+	uint8* Allocate(int32 BitsPerVoxel);
+
+	/**
+	 * Return a block to the slab it came from. Thread safe.
+	 * @param BitsPerVoxel Width the block was allocated with.
+	 * @param Block The block to free.
+	 */
+	void Free(int32 BitsPerVoxel, uint8* Block);
+
+	/** Bytes of voxel words for a chunk at the given width, the palette starts right after. */
+	static FORCEINLINE SIZE_T GetVoxelBytes(int32 BitsPerVoxel)
+	{
+		return (SIZE_T)FG::Const::ChunkSizeXYZ * BitsPerVoxel / 8;
+	}
+
+	/** Bytes of palette entries for a chunk at the given width. */
+	static SIZE_T GetPaletteBytes(int32 BitsPerVoxel);
+
+	/** Total size of a block in the given size class. */
+	static SIZE_T GetBlockSize(int32 BitsPerVoxel);
+
+	/** Snapshot of the slab for the given width. */
+	FSizeClassStats GetStats(int32 BitsPerVoxel) const;
+
+private:
+
+	FFGVoxelArena() = default;
+
+	/** Freed blocks store the next free block in their first bytes. */
+	struct FFreeBlock
+	{
+		FFreeBlock* Next;
+	};
+
+	struct FSlab
+	{
+		FPlatformMemory::FPlatformVirtualMemoryBlock VirtualBlock;
+
+		SIZE_T			BlockSize = 0;
+		SIZE_T			UsedBytes = 0;		// Bump offset of the first never used block.
+		SIZE_T			CommittedBytes = 0;
+		FFreeBlock*		FreeList = nullptr;
+		int32			BlocksInUse = 0;
+		int32			BlocksFree = 0;
+		mutable FCriticalSection Lock;
+	};
+
+	void InitSlab(FSlab& Slab, int32 BitsPerVoxel);
+	void UpdateStats(int32 BitsPerVoxel, const FSlab& Slab);
+
+	FSlab Slabs[NumSizeClasses];
+};
@@ -4,6 +4,95 @@
 #include "FGVoxelChunk.h"
 #include "FGVoxelUtils.h"
 
+namespace FG::Private
+{
+	/**
+	 * Scratch space for bulk operations on a chunk. One per thread so that generation workers can
+	 * encode in parallel, and so we don't pay to clear the type table on every call.
+	 */
+	struct FChunkScratch
+	{
+		FChunkScratch()
+		{
+			TypeToIndex.Init(MAX_uint16, MAX_uint16 + 1);
+			Indices.SetNumUninitialized(FG::Const::ChunkSizeXYZ);
+		}
+
+		TArray<uint16> TypeToIndex;	// Voxel type -> palette index, MAX_uint16 when unused.
+		TArray<uint16> Indices;		// Palette index per voxel.
+	};
+
+	static thread_local FChunkScratch ChunkScratch;
+}
+
+FFGVoxelChunk::FFGVoxelChunk(const FFGVoxelChunk& Other)
+	: FFGVoxelChunk()
+{
+	*this = Other;
+}
+
+FFGVoxelChunk::FFGVoxelChunk(FFGVoxelChunk&& Other)
+	: FFGVoxelChunk()
+{
+	*this = MoveTemp(Other);
+}
+
+FFGVoxelChunk& FFGVoxelChunk::operator=(const FFGVoxelChunk& Other)
+{
+	if(this == &Other)
+	{
+		return *this;
+	}
+
+	ReleaseStorage();
+
+	Flags = Other.Flags;
+	BitsPerVoxel = Other.BitsPerVoxel;
+	UniformEntry = Other.UniformEntry;
+
+	if(Other.Block)
+	{
+		Block = FFGVoxelArena::Get().Allocate(BitsPerVoxel);
+		FMemory::Memcpy(Block, Other.Block, FFGVoxelArena::GetBlockSize(BitsPerVoxel));
+	}
+
+	RebuildPaletteLookup();
+	return *this;
+}
+
+FFGVoxelChunk& FFGVoxelChunk::operator=(FFGVoxelChunk&& Other)
+{
+	if(this == &Other)
+	{
+		return *this;
+	}
+
+	ReleaseStorage();
+
+	Flags = Other.Flags;
+	BitsPerVoxel = Other.BitsPerVoxel;
+	UniformEntry = Other.UniformEntry;
+
+	// Steal the block, leaving the other chunk as uniform air.
+	Block = Other.Block;
+	Other.Block = nullptr;
+	Other.Reset();
+
+	RebuildPaletteLookup();
+	return *this;
+}
+
+void FFGVoxelChunk::Reset()
+{
+	ReleaseStorage();
+	Flags = EFGChunkFlags::NoFlags;
+
+	// All the voxels should default to air, chunks start off uniform so there is no voxel data.
+	BitsPerVoxel = 0;
+	UniformEntry = FPaletteEntry(FG::Const::ChunkSizeXYZ, VOXELTYPE_NONE);
+	RebuildPaletteLookup();
+}
+
 void FFGVoxelChunk::SetVoxel(FIntVector VoxelCoordinate, uint32 VoxelType)
 {
 	SetVoxel(UFGVoxelUtils::FlattenVoxelCoord(VoxelCoordinate), VoxelType);
@@ -11,35 +100,40 @@ void FFGVoxelChunk::SetVoxel(FIntVector VoxelCoordinate, uint32 VoxelType)
 
 void FFGVoxelChunk::SetVoxel(int32 VoxelIndex, uint32 VoxelType)
 {
-	uint32 PaletteIndex = GetVoxelBits(VoxelIndex * BitsPerVoxel);
+	checkf(VoxelType <= VOXELTYPE_MAX, TEXT("Voxel type %u is past VOXELTYPE_MAX!"), VoxelType);
 
-	FPaletteEntry* RESTRICT PaletteDataPtr = Palette.GetData();
-	PaletteDataPtr[PaletteIndex].RefCount -= 1;
+	const uint32 PaletteIndex = GetPaletteIndex(VoxelIndex);
+	FPaletteEntry* RESTRICT PaletteDataPtr = GetPalette();
 
-	// Does the block type already exist in the palette?
-	const int32& IndexToReplace = Palette.IndexOfByPredicate([&VoxelType](const FPaletteEntry& Entry)
+	if(PaletteDataPtr[PaletteIndex].VoxelType == VoxelType) // Nothing to change.
 	{
-		return Entry.VoxelType == VoxelType;
-	});
+		return;
+	}
 
-	if(IndexToReplace != INDEX_NONE) // Use existing palette entry.
+	// Does the block type already exist in the palette?
+	if(const uint16* ExistingIndex = PaletteLookup.Find(VoxelType)) // Use existing palette entry.
 	{
+		const uint32 IndexToReplace = *ExistingIndex;
+		ReleasePaletteEntry(PaletteIndex);
 		SetVoxelBits(VoxelIndex * BitsPerVoxel, IndexToReplace);
-		Palette[IndexToReplace].RefCount += 1;
+		PaletteDataPtr[IndexToReplace].RefCount += 1;
 		return;
 	}
 
-	// Can we overwrite the current palette entry?
-	if(PaletteDataPtr[PaletteIndex].RefCount == 0) // Overwrite entry.
+	// Can we overwrite the current palette entry? (we are it's only user)
+	if(PaletteDataPtr[PaletteIndex].RefCount == 1) // Overwrite entry.
 	{
+		PaletteLookup.Remove(PaletteDataPtr[PaletteIndex].VoxelType);
 		PaletteDataPtr[PaletteIndex].VoxelType = VoxelType;
-		PaletteDataPtr[PaletteIndex].RefCount = 1;
+		PaletteLookup.FindOrAdd(VoxelType, (uint16)PaletteIndex);
 		return;
 	}
 
 	// New palette entry is needed, get first free palette entry, growing if needed.
-	const uint32 NewEntry = AddPaletteEntry();
-	Palette[NewEntry] = FPaletteEntry(1, VoxelType);
+	PaletteDataPtr[PaletteIndex].RefCount -= 1;
+	const uint32 NewEntry = AddPaletteEntry(); // May move the chunk to a new block.
+	GetPalette()[NewEntry] = FPaletteEntry(1, VoxelType);
+	PaletteLookup.FindOrAdd(VoxelType, (uint16)NewEntry);
 	SetVoxelBits(VoxelIndex * BitsPerVoxel, NewEntry);
 
 	PaletteCount += 1;
@@ -52,120 +146,520 @@ uint32& FFGVoxelChunk::GetVoxel(FIntVector VoxelCoordinate)
 
 uint32& FFGVoxelChunk::GetVoxel(int32 VoxelIndex)
 {
-	uint32 PaletteIndex = GetVoxelBits(VoxelIndex* BitsPerVoxel);
+	const uint32 PaletteIndex = GetPaletteIndex(VoxelIndex);
 
-	FPaletteEntry* RESTRICT EntryPtr = Palette.GetData();
+	FPaletteEntry* RESTRICT EntryPtr = GetPalette();
 	return (EntryPtr + PaletteIndex)->VoxelType;
 }
 
 void FFGVoxelChunk::ShrinkPalette()
 {
 	using namespace FG::Const;
-	
-	// Remove old entries.
-	for(int32 Index = 0; Index < Palette.Num(); Index++)
+
+	// Find the smallest bit width that still fits every live palette entry.
+	const int32 NewBitsPerVoxel = GetBitsForPaletteSize(PaletteCount);
+
+	if(NewBitsPerVoxel >= BitsPerVoxel)
+	{
+		return; // Palette cannot be shrunk.
+	}
+
+	// Compact the live entries to the front of the new palette, remembering where they moved.
+	const FPaletteEntry* RESTRICT OldPalette = GetPalette();
+
+	TArray<uint16, TInlineAllocator<256>> Remap;
+	Remap.SetNumZeroed(GetPaletteCapacity());
+
+	TArray<FPaletteEntry, TInlineAllocator<256>> NewPalette;
+	NewPalette.Reserve(PaletteCount);
+
+	for(int32 PaletteIndex = 0; PaletteIndex < GetPaletteCapacity(); PaletteIndex++)
 	{
-		if(Palette[Index].RefCount == 0)
+		if(OldPalette[PaletteIndex].RefCount > 0)
 		{
-			Palette[Index] = FPaletteEntry();
-			PaletteCount -= 1;
+			Remap[PaletteIndex] = (uint16)NewPalette.Add(OldPalette[PaletteIndex]);
 		}
 	}
 
-	// Is the palette less than half of it's closest power of 2?
-	if(PaletteCount > FMath::RoundUpToPowerOfTwo(PaletteCount / 2))
+	// Re-encode the indices at the new width.
+	uint16* RESTRICT Indices = FG::Private::ChunkScratch.Indices.GetData();
+	UnpackIndices(Indices);
+
+	for(int32 Index = 0; Index < ChunkSizeXYZ; Index++)
 	{
-		return; // Palette cannot be shrunk.
+		Indices[Index] = Remap[Indices[Index]];
 	}
 
-	// Decode all indices
-	TArray<uint32, TFixedAllocator<ChunkSizeXYZ>> Indices;
-	for(int32 Index = 0; Index < ChunkSizeXYZ; Index++)
+	ReplaceStorage(NewBitsPerVoxel, NewPalette.GetData(), NewPalette.Num());
+	PackIndices(Indices);
+
+	RebuildPaletteLookup();
+}
+
+void FFGVoxelChunk::DecodeAll(TArrayView<uint16> OutVoxels) const
+{
+	using namespace FG::Const;
+
+	checkf(OutVoxels.Num() == ChunkSizeXYZ, TEXT("DecodeAll expects space for a full chunk of voxels!"));
+
+	// Flatten the palette down to a plain type table so the inner loops are a single load.
+	const FPaletteEntry* RESTRICT Palette = GetPalette();
+
+	TArray<uint16, TInlineAllocator<256>> PaletteTypes;
+	PaletteTypes.SetNumUninitialized(GetPaletteCapacity());
+	for(int32 PaletteIndex = 0; PaletteIndex < GetPaletteCapacity(); PaletteIndex++)
 	{
-		VoxelData.GetRange(Index * BitsPerVoxel, BitsPerVoxel, Indices.GetData(), Index * BitsPerVoxel);
+		checkf(Palette[PaletteIndex].RefCount == 0 || Palette[PaletteIndex].VoxelType <= VOXELTYPE_MAX, TEXT("Palette holds voxel type %u, past VOXELTYPE_MAX!"), Palette[PaletteIndex].VoxelType);
+		PaletteTypes[PaletteIndex] = (uint16)Palette[PaletteIndex].VoxelType; // Free entries decode to junk, but nothing references them.
 	}
 
-	// Create new palette, halfing it in size
-	BitsPerVoxel = BitsPerVoxel >> 1;
+	const uint32* RESTRICT Words = GetVoxelWords();
+	const uint16* RESTRICT Lut = PaletteTypes.GetData();
+	uint16* RESTRICT OutPtr = OutVoxels.GetData();
+
+	switch(BitsPerVoxel)
+	{
+	case 0:		for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++) { OutPtr[Voxel] = Lut[0]; } break;
+	case 1:		FFGBitArrayMemory::UnpackWords<1>(Words, ChunkSizeXYZ, Lut, OutPtr); break;
+	case 2:		FFGBitArrayMemory::UnpackWords<2>(Words, ChunkSizeXYZ, Lut, OutPtr); break;
+	case 4:		FFGBitArrayMemory::UnpackWords<4>(Words, ChunkSizeXYZ, Lut, OutPtr); break;
+	case 8:		FFGBitArrayMemory::UnpackWords<8>(Words, ChunkSizeXYZ, Lut, OutPtr); break;
+	case 16:	FFGBitArrayMemory::UnpackWords<16>(Words, ChunkSizeXYZ, Lut, OutPtr); break;
+	default: // Tightly packed widths, values may straddle words.
+		for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+		{
+			OutPtr[Voxel] = Lut[GetVoxelBits(Voxel * BitsPerVoxel)];
+		}
+		break;
+	}
+}
+
+void FFGVoxelChunk::EncodeAll(TConstArrayView<uint16> Voxels)
+{
+	using namespace FG::Const;
+
+	checkf(Voxels.Num() == ChunkSizeXYZ, TEXT("EncodeAll expects a full chunk of voxels!"));
+
+	uint16* RESTRICT TypeToIndex = FG::Private::ChunkScratch.TypeToIndex.GetData();
+	uint16* RESTRICT Indices = FG::Private::ChunkScratch.Indices.GetData();
+	const uint16* RESTRICT VoxelPtr = Voxels.GetData();
+
+	// Histogram pass, builds the palette, refcounts and per voxel indices all at once.
 	TArray<FPaletteEntry> NewPalette;
-	NewPalette.AddDefaulted(pow(2, BitsPerVoxel));
+	int32 Voxel = 0;
+	while(Voxel < ChunkSizeXYZ)
+	{
+		const uint16 VoxelType = VoxelPtr[Voxel];
+		uint16& PaletteIndex = TypeToIndex[VoxelType];
+
+		if(PaletteIndex == MAX_uint16) // First time seeing this type.
+		{
+			PaletteIndex = (uint16)NewPalette.Emplace(0, VoxelType);
+		}
+
+		// Generated chunks are mostly long runs down each column, so count a whole run per lookup.
+		const int32 RunStart = Voxel;
+		while(Voxel < ChunkSizeXYZ && VoxelPtr[Voxel] == VoxelType)
+		{
+			Indices[Voxel++] = PaletteIndex;
+		}
+
+		NewPalette[PaletteIndex].RefCount += Voxel - RunStart;
+	}
+
+	// Reset only the entries we touched for the next caller.
+	for(const FPaletteEntry& Entry : NewPalette)
+	{
+		TypeToIndex[Entry.VoxelType] = MAX_uint16;
+	}
+
+	ReplaceStorage(GetBitsForPaletteSize(NewPalette.Num()), NewPalette.GetData(), NewPalette.Num());
+	RebuildPaletteLookup();
+
+	PackIndices(Indices);
+}
+
+void FFGVoxelChunk::Fill(uint32 VoxelType)
+{
+	checkf(VoxelType <= VOXELTYPE_MAX, TEXT("Voxel type %u is past VOXELTYPE_MAX!"), VoxelType);
+
+	Reset();
+
+	UniformEntry = FPaletteEntry(FG::Const::ChunkSizeXYZ, VoxelType);
+	RebuildPaletteLookup();
+}
+
+namespace FG::Private
+{
+	/** Leading byte of a compressed chunk, says how the rest should be read. */
+	enum class EChunkBlobFormat : uint8
+	{
+		Uniform,	// Followed by the uint16 voxel type.
+		Palette,	// Followed by the bits per voxel, then the LZ4 compressed arena block.
+		Delta,		// Followed by the baseline id, the change count, then the changed voxel indices and their uint16 types.
+	};
+}
+
+void FFGVoxelChunk::Compress(TArray<uint8>& OutBytes) const
+{
+	using namespace FG::Private;
+
+	OutBytes.Reset();
+
+	if(IsUniform()) // Just the type, no point running the compressor over a single value.
+	{
+		const uint16 VoxelType = (uint16)GetUniformType();
+		OutBytes.Add((uint8)EChunkBlobFormat::Uniform);
+		OutBytes.Append(reinterpret_cast<const uint8*>(&VoxelType), sizeof(uint16));
+		return;
+	}
+
+	// The block is already palette compressed, packed indices then the palette, so LZ4 it as is.
+	const int32 BlockBytes = FFGVoxelArena::GetVoxelBytes(BitsPerVoxel) + FFGVoxelArena::GetPaletteBytes(BitsPerVoxel);
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_LZ4, BlockBytes);
+
+	constexpr int32 HeaderBytes = 2;
+	OutBytes.SetNumUninitialized(HeaderBytes + CompressedSize);
+	OutBytes[0] = (uint8)EChunkBlobFormat::Palette;
+	OutBytes[1] = (uint8)BitsPerVoxel;
+
+	verify(FCompression::CompressMemory(NAME_LZ4, OutBytes.GetData() + HeaderBytes, CompressedSize, Block, BlockBytes));
+	OutBytes.SetNum(HeaderBytes + CompressedSize, EAllowShrinking::No);
+}
+
+bool FFGVoxelChunk::Decompress(TConstArrayView<uint8> Bytes)
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	Reset();
+
+	if(Bytes.Num() == 1 + sizeof(uint16) && Bytes[0] == (uint8)EChunkBlobFormat::Uniform)
+	{
+		uint16 VoxelType;
+		FMemory::Memcpy(&VoxelType, Bytes.GetData() + 1, sizeof(uint16));
+
+		UniformEntry = FPaletteEntry(ChunkSizeXYZ, VoxelType); // Reset left us uniform with no storage.
+		RebuildPaletteLookup();
+		return true;
+	}
+
+	constexpr int32 HeaderBytes = 2;
+	if(Bytes.Num() <= HeaderBytes || Bytes[0] != (uint8)EChunkBlobFormat::Palette)
+	{
+		return false;
+	}
+
+	const int32 NewBitsPerVoxel = Bytes[1];
+	if(NewBitsPerVoxel < 1 || NewBitsPerVoxel > 16)
+	{
+		return false;
+	}
+
+	ReplaceStorage(NewBitsPerVoxel, nullptr, 0);
+
+	const int32 BlockBytes = FFGVoxelArena::GetVoxelBytes(BitsPerVoxel) + FFGVoxelArena::GetPaletteBytes(BitsPerVoxel);
+	if(!FCompression::UncompressMemory(NAME_LZ4, Block, BlockBytes, Bytes.GetData() + HeaderBytes, Bytes.Num() - HeaderBytes))
+	{
+		Reset();
+		return false;
+	}
+
+	// Refcounts must cover the chunk exactly, anything else means the blob was damaged.
+	int64 TotalRefs = 0;
+	const FPaletteEntry* Palette = GetPalette();
+	for(int32 PaletteIndex = 0; PaletteIndex < GetPaletteCapacity(); PaletteIndex++)
+	{
+		TotalRefs += FMath::Max(Palette[PaletteIndex].RefCount, 0);
+	}
 
-	// Compress the palette entries
-	uint32 PaletteCounter = 0;
-	for(int32 PaletteIndex = 0; PaletteIndex < Palette.Num(); PaletteIndex++, PaletteCounter++)
+	if(TotalRefs != ChunkSizeXYZ)
 	{
-		const FPaletteEntry& Entry = NewPalette[PaletteIndex] = Palette[PaletteIndex];
+		Reset();
+		return false;
+	}
+
+	RebuildPaletteLookup();
+	return true;
+}
+
+bool FFGVoxelChunk::CompressDelta(const FFGVoxelChunk& Baseline, uint32 BaselineId, int32 MaxChangedVoxels, TArray<uint8>& OutBytes) const
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	TArray<uint16> Voxels;
+	TArray<uint16> BaselineVoxels;
+	Voxels.SetNumUninitialized(ChunkSizeXYZ);
+	BaselineVoxels.SetNumUninitialized(ChunkSizeXYZ);
+	DecodeAll(Voxels);
+	Baseline.DecodeAll(BaselineVoxels);
 
-		// Re-encode the indices (find and replace; with limit)
-		int32 FoundCounter = 0;
-		for(int32 DecodeIndex = 0; DecodeIndex < Indices.Num() && FoundCounter < Entry.RefCount; DecodeIndex++)
+	TArray<uint16> ChangedIndices;
+	TArray<uint16> ChangedTypes;
+
+	for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+	{
+		if(Voxels[Voxel] != BaselineVoxels[Voxel])
 		{
-			if(PaletteIndex == Indices[DecodeIndex])
+			if(ChangedIndices.Num() == MaxChangedVoxels)
 			{
-				Indices[DecodeIndex] = PaletteCounter;
-				FoundCounter += 1;
+				OutBytes.Reset();
+				return false;
 			}
+			ChangedIndices.Add((uint16)Voxel);
+			ChangedTypes.Add(Voxels[Voxel]);
 		}
 	}
 
-	// Allocate new bit array
-	VoxelData = TBitArray(NULL, ChunkSizeXYZ * BitsPerVoxel);
+	const uint32 NumChanged = ChangedIndices.Num();
+
+	OutBytes.Reset(1 + sizeof(uint32) * 2 + ChangedIndices.NumBytes() + ChangedTypes.NumBytes());
+	OutBytes.Add((uint8)EChunkBlobFormat::Delta);
+	OutBytes.Append(reinterpret_cast<const uint8*>(&BaselineId), sizeof(uint32));
+	OutBytes.Append(reinterpret_cast<const uint8*>(&NumChanged), sizeof(uint32));
+	OutBytes.Append(reinterpret_cast<const uint8*>(ChangedIndices.GetData()), ChangedIndices.NumBytes());
+	OutBytes.Append(reinterpret_cast<const uint8*>(ChangedTypes.GetData()), ChangedTypes.NumBytes());
+	return true;
+}
+
+bool FFGVoxelChunk::ApplyDelta(TConstArrayView<uint8> Bytes, uint32 BaselineId)
+{
+	using namespace FG::Const;
 
-	// Encode indices
-	for(int32 Index = 0; Index < Indices.Num(); Index++)
+	constexpr int32 HeaderBytes = 1 + sizeof(uint32) * 2;
+	if(!IsDeltaBlob(Bytes) || Bytes.Num() < HeaderBytes)
 	{
-		//VoxelData.SetRangeFromRange(BitsPerVoxel * Index, BitsPerVoxel, &Indices[Index]);
-		SetVoxelBits(BitsPerVoxel * Index, Indices[Index]);
+		return false;
+	}
+
+	uint32 BlobBaselineId;
+	uint32 NumChanged;
+	FMemory::Memcpy(&BlobBaselineId, Bytes.GetData() + 1, sizeof(uint32));
+	FMemory::Memcpy(&NumChanged, Bytes.GetData() + 1 + sizeof(uint32), sizeof(uint32));
+
+	if(BlobBaselineId != BaselineId || NumChanged > ChunkSizeXYZ || Bytes.Num() != HeaderBytes + NumChanged * sizeof(uint16) * 2)
+	{
+		return false;
+	}
+
+	// Unaligned in the blob, so copy them out rather than casting.
+	TArray<uint16> Indices;
+	TArray<uint16> Types;
+	Indices.SetNumUninitialized(NumChanged);
+	Types.SetNumUninitialized(NumChanged);
+	FMemory::Memcpy(Indices.GetData(), Bytes.GetData() + HeaderBytes, Indices.NumBytes());
+	FMemory::Memcpy(Types.GetData(), Bytes.GetData() + HeaderBytes + Indices.NumBytes(), Types.NumBytes());
+
+	for(const uint16 VoxelIndex : Indices)
+	{
+		if(VoxelIndex >= ChunkSizeXYZ)
+		{
+			return false;
+		}
+	}
+
+	for(uint32 Change = 0; Change < NumChanged; Change++)
+	{
+		SetVoxel((int32)Indices[Change], Types[Change]);
+	}
+	return true;
+}
+
+bool FFGVoxelChunk::IsDeltaBlob(TConstArrayView<uint8> Bytes)
+{
+	return Bytes.Num() > 0 && Bytes[0] == (uint8)FG::Private::EChunkBlobFormat::Delta;
+}
+
+void FFGVoxelChunk::UnpackIndices(uint16* RESTRICT OutIndices) const
+{
+	using namespace FG::Const;
+
+	const uint32* RESTRICT Words = GetVoxelWords();
+
+	switch(BitsPerVoxel)
+	{
+	case 0:		FMemory::Memzero(OutIndices, ChunkSizeXYZ * sizeof(uint16)); break;
+	case 1:		FFGBitArrayMemory::UnpackWords<1>(Words, ChunkSizeXYZ, OutIndices); break;
+	case 2:		FFGBitArrayMemory::UnpackWords<2>(Words, ChunkSizeXYZ, OutIndices); break;
+	case 4:		FFGBitArrayMemory::UnpackWords<4>(Words, ChunkSizeXYZ, OutIndices); break;
+	case 8:		FFGBitArrayMemory::UnpackWords<8>(Words, ChunkSizeXYZ, OutIndices); break;
+	case 16:	FFGBitArrayMemory::UnpackWords<16>(Words, ChunkSizeXYZ, OutIndices); break;
+	default: // Tightly packed widths, values may straddle words.
+		for(int32 Index = 0; Index < ChunkSizeXYZ; Index++)
+		{
+			OutIndices[Index] = (uint16)GetVoxelBits(Index * BitsPerVoxel);
+		}
+		break;
+	}
+}
+
+void FFGVoxelChunk::PackIndices(const uint16* RESTRICT Indices)
+{
+	using namespace FG::Const;
+
+	if(IsUniform()) // Every index is 0, nothing to store.
+	{
+		return;
+	}
+
+	// Every word is fully overwritten, so the block doesn't need clearing first.
+	uint32* RESTRICT Words = GetVoxelWords();
+
+	switch(BitsPerVoxel)
+	{
+	case 1:		FFGBitArrayMemory::PackWords<1>(Indices, ChunkSizeXYZ, Words); break;
+	case 2:		FFGBitArrayMemory::PackWords<2>(Indices, ChunkSizeXYZ, Words); break;
+	case 4:		FFGBitArrayMemory::PackWords<4>(Indices, ChunkSizeXYZ, Words); break;
+	case 8:		FFGBitArrayMemory::PackWords<8>(Indices, ChunkSizeXYZ, Words); break;
+	case 16:	FFGBitArrayMemory::PackWords<16>(Indices, ChunkSizeXYZ, Words); break;
+	default: // Tightly packed widths, values may straddle words.
+		for(int32 Index = 0; Index < ChunkSizeXYZ; Index++)
+		{
+			SetVoxelBits(Index * BitsPerVoxel, Indices[Index]);
+		}
+		break;
 	}
 }
 
 uint32 FFGVoxelChunk::AddPaletteEntry()
 {
-	const int32 FirstFree = Palette.IndexOfByPredicate([](const FPaletteEntry& Entry)
+	if(PaletteFreeHead == (uint32)INDEX_NONE) // No free entries, grow the palette.
+	{
+		GrowPalette();
+	}
+
+	// Free entries store the next free index in their voxel type.
+	const uint32 PaletteIndex = PaletteFreeHead;
+	PaletteFreeHead = GetPalette()[PaletteIndex].VoxelType;
+	return PaletteIndex;
+}
+
+void FFGVoxelChunk::ReleasePaletteEntry(uint32 PaletteIndex)
+{
+	FPaletteEntry& Entry = GetPalette()[PaletteIndex];
+	Entry.RefCount -= 1;
+
+	if(Entry.RefCount == 0) // Last user of this entry, hand the slot back.
+	{
+		PaletteLookup.Remove(Entry.VoxelType);
+		Entry.VoxelType = PaletteFreeHead;
+		PaletteFreeHead = PaletteIndex;
+		PaletteCount -= 1;
+	}
+}
+
+void FFGVoxelChunk::RebuildPaletteLookup()
+{
+	FPaletteEntry* RESTRICT Palette = GetPalette();
+
+	PaletteLookup.Empty();
+	PaletteFreeHead = INDEX_NONE;
+	PaletteCount = 0;
+
+	// Walk backwards so the lowest free index ends up at the head of the free list.
+	for(int32 PaletteIndex = GetPaletteCapacity() - 1; PaletteIndex >= 0; PaletteIndex--)
+	{
+		if(Palette[PaletteIndex].RefCount > 0)
+		{
+			PaletteLookup.FindOrAdd(Palette[PaletteIndex].VoxelType, (uint16)PaletteIndex);
+			PaletteCount += 1;
+		}
+		else
+		{
+			Palette[PaletteIndex].VoxelType = PaletteFreeHead;
+			PaletteFreeHead = PaletteIndex;
+		}
+	}
+}
+
+void FFGVoxelChunk::ReplaceStorage(int32 NewBitsPerVoxel, const FPaletteEntry* NewPalette, int32 NumEntries)
+{
+	checkf(NumEntries <= (1 << NewBitsPerVoxel), TEXT("Palette does not fit in %d bits per voxel!"), NewBitsPerVoxel);
+
+	uint8* OldBlock = Block;
+	const int32 OldBitsPerVoxel = BitsPerVoxel;
+
+	if(NewBitsPerVoxel == 0) // Uniform, no block needed.
 	{
-		return (Entry.RefCount == 0);
-	});
+		UniformEntry = NewPalette[0];
+		Block = nullptr;
+	}
+	else
+	{
+		Block = FFGVoxelArena::Get().Allocate(NewBitsPerVoxel);
+
+		// Copy the palette in before the old block is freed, it may be the source.
+		FPaletteEntry* RESTRICT Palette = reinterpret_cast<FPaletteEntry*>(Block + FFGVoxelArena::GetVoxelBytes(NewBitsPerVoxel));
+		FMemory::Memcpy(Palette, NewPalette, NumEntries * sizeof(FPaletteEntry));
+		DefaultConstructItems<FPaletteEntry>(Palette + NumEntries, (1 << NewBitsPerVoxel) - NumEntries);
+	}
+
+	BitsPerVoxel = NewBitsPerVoxel;
 
-	if(FirstFree != INDEX_NONE) // Use existing free entry.
+	if(OldBlock)
 	{
-		return FirstFree;
+		FFGVoxelArena::Get().Free(OldBitsPerVoxel, OldBlock);
 	}
+}
 
-	// No free entries, grow the palette.
-	GrowPalette();
+void FFGVoxelChunk::ReleaseStorage()
+{
+	if(Block)
+	{
+		FFGVoxelArena::Get().Free(BitsPerVoxel, Block);
+		Block = nullptr;
+	}
+}
 
-	// Recursively retry the operation.
-	return AddPaletteEntry();
+int32 FFGVoxelChunk::GetBitsForPaletteSize(uint32 NumEntries)
+{
+	if(NumEntries <= 1) // Single type, the chunk can be uniform.
+	{
+		return 0;
+	}
+
+	int32 Bits = 1;
+	while((1u << Bits) < NumEntries)
+	{
+#if FG_VOXEL_WORD_ALIGNED_STORAGE
+		Bits = Bits << 1; // Widths double so that they always divide a word evenly.
+#else
+		Bits = Bits + 1; // Tightest width that fits.
+#endif
+	}
+	return Bits;
 }
 
 void FFGVoxelChunk::GrowPalette()
 {
 	using namespace FG::Const;
-	
+
+	checkf(BitsPerVoxel < 16, TEXT("Chunk palette cannot grow past 16 bits per voxel!"));
+
 	// Decode indices
-	TStaticArray<uint32, ChunkSizeXYZ> Indices;
-	for(int32 Index = 0; Index < Indices.Num(); Index++)
-	{
-		Indices[Index] = GetVoxelBits(Index * BitsPerVoxel);
-	}
+	uint16* RESTRICT Indices = FG::Private::ChunkScratch.Indices.GetData();
+	UnpackIndices(Indices);
 
-	// Create new palette, doubling it in size
-	BitsPerVoxel = BitsPerVoxel << 1;
-	const uint32 NewNumElems = 1 << BitsPerVoxel; // 2^BitsPerVoxel
+	// Double the palette, moving the chunk to the next size class. Uniform chunks expand to a single bit.
+#if FG_VOXEL_WORD_ALIGNED_STORAGE
+	const int32 NewBitsPerVoxel = IsUniform() ? 1 : BitsPerVoxel << 1;
+#else
+	const int32 NewBitsPerVoxel = BitsPerVoxel + 1;
+#endif
+	const uint32 OldNumElems = GetPaletteCapacity();
+	const uint32 NewNumElems = 1 << NewBitsPerVoxel; // 2^BitsPerVoxel
 
-	// Resize and copy the old palette to the new one
-	TArray<FPaletteEntry> NewPalette;
-	NewPalette.AddUninitialized(NewNumElems);
-	DefaultConstructItems<FPaletteEntry>(NewPalette.GetData(), NewNumElems);
-	FMemory::Memcpy(NewPalette.GetData(), Palette.GetData(), PaletteCount * sizeof(FPaletteEntry)); // Copy the old palette to the new one
-	Palette = MoveTemp(NewPalette); // Move the new palette to the old one
-	
-	// Allocate new voxel data
-	VoxelData = TBitArray(false, ChunkSizeXYZ * BitsPerVoxel);
+	ReplaceStorage(NewBitsPerVoxel, GetPalette(), OldNumElems);
 
-	// Encode indices
-	for(int32 Index = 0; Index < Indices.Num(); Index++)
+	// Palette indices are stable across a grow, so the lookup is untouched, only the new slots are free.
+	FPaletteEntry* RESTRICT Palette = GetPalette();
+	for(int32 FreeIndex = NewNumElems - 1; FreeIndex >= (int32)OldNumElems; FreeIndex--)
 	{
-		SetVoxelBits(Index * BitsPerVoxel, Indices[Index]);
+		Palette[FreeIndex].VoxelType = PaletteFreeHead;
+		PaletteFreeHead = FreeIndex;
 	}
+
+	// Encode indices at the new width.
+	PackIndices(Indices);
 }
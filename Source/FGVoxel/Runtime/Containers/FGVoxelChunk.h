@@ -4,8 +4,19 @@
 #pragma once
 
 #include "FGBitArrayMemory.h"
+#include "FGVoxelArena.h"
 #include "FGVoxelDefines.h"
 
+/**
+ * Word aligned storage mode. When enabled BitsPerVoxel is only ever 1, 2, 4, 8
+ * or 16 so a voxel never straddles two words of VoxelData, and every access is
+ * a single branchless shift and mask. When disabled voxels are packed as tight
+ * as possible (any width from 1 to 16) at the cost of branchier access.
+ */
+#ifndef FG_VOXEL_WORD_ALIGNED_STORAGE
+#define FG_VOXEL_WORD_ALIGNED_STORAGE 1
+#endif
+
 /**
  * Technical Details about the Voxel Layout, Compression, and Allocation.
  *
@@ -17,6 +28,16 @@
  * This is because during world generation we tend to iterate over the
  * XY plane rather than the Z planes, and it allows us to do some neat
  * memory tricks when it comes to dealing with heightmaps.
+ *
+ * Most chunks are entirely air or entirely solid, so a chunk with a
+ * single voxel type is stored "uniform" with BitsPerVoxel of 0, one
+ * palette entry and no voxel data at all. It expands to 1 bit per voxel
+ * on the first SetVoxel that writes a different type, and collapses back
+ * down when shrunk or bulk encoded with a single type.
+ *
+ * Voxel words and the palette of a non uniform chunk share a single block
+ * from FFGVoxelArena, voxel words first, so a chunk is one allocation and
+ * changing BitsPerVoxel moves it into the slab for the new width.
  */
 
 /**
@@ -42,16 +63,32 @@
  */
 struct FGVOXEL_API FFGVoxelChunk
 {
+private:
+	struct FPaletteEntry;
+
+public:
 	FFGVoxelChunk()
-		: BitsPerVoxel(1),
-		PaletteCount(1),
-		VoxelData(false, FG::Const::ChunkSizeXYZ * BitsPerVoxel)
+		: Flags(EFGChunkFlags::NoFlags),
+		BitsPerVoxel(0),
+		PaletteCount(0),
+		PaletteFreeHead(INDEX_NONE),
+		Block(nullptr)
 	{
-		Palette.AddDefaulted(pow(2, BitsPerVoxel));
-		// All the voxels should default to air
-		Palette[0].VoxelType = 0;
-		Palette[0].RefCount = FG::Const::ChunkSizeXYZ * BitsPerVoxel;
+		Reset();
 	}
+
+	FFGVoxelChunk(const FFGVoxelChunk& Other);
+	FFGVoxelChunk(FFGVoxelChunk&& Other);
+	FFGVoxelChunk& operator=(const FFGVoxelChunk& Other);
+	FFGVoxelChunk& operator=(FFGVoxelChunk&& Other);
+
+	~FFGVoxelChunk()
+	{
+		ReleaseStorage();
+	}
+
+	/** Empty the chunk back to uniform air, returning it's storage to the arena. */
+	void Reset();
 		
 	void SetVoxel(int32 VoxelIndex, uint32 VoxelType);
 	void SetVoxel(FIntVector VoxelCoordinate, uint32 VoxelType);
@@ -63,6 +100,61 @@ struct FGVOXEL_API FFGVoxelChunk
 	
 	void	    ShrinkPalette();
 
+	/**
+	 * Decode every voxel in the chunk to it's voxel type in a single pass.
+	 * Much faster than calling GetVoxel per voxel when you need the whole chunk.
+	 * Types fit in uint16 as SetVoxel and Fill never take one past VOXELTYPE_MAX.
+	 * @param OutVoxels Output voxel types, must be ChunkSizeXYZ long, in voxel index order.
+	 */
+	void DecodeAll(TArrayView<uint16> OutVoxels) const;
+
+	/**
+	 * Replace the entire contents of the chunk, rebuilding the palette from scratch.
+	 * Much faster than calling SetVoxel per voxel when you are writing the whole chunk.
+	 * @param Voxels Input voxel types, must be ChunkSizeXYZ long, in voxel index order.
+	 */
+	void EncodeAll(TConstArrayView<uint16> Voxels);
+
+	/**
+	 * Replace the entire contents of the chunk with a single voxel type, leaving it uniform with no storage.
+	 * @param VoxelType The type every voxel becomes.
+	 */
+	void Fill(uint32 VoxelType);
+
+	/**
+	 * Compress the chunk contents into a self contained blob, for keeping chunks around cheaply.
+	 * @param OutBytes Replaced with the compressed chunk.
+	 */
+	void Compress(TArray<uint8>& OutBytes) const;
+
+	/**
+	 * Replace the chunk contents from a blob made by Compress.
+	 * @param Bytes The compressed chunk.
+	 * @return false if the blob was corrupt, in which case the chunk is left as uniform air.
+	 */
+	bool Decompress(TConstArrayView<uint8> Bytes);
+
+	/**
+	 * Compress only the voxels that differ from a baseline, for chunks that are mostly procedural.
+	 * @param Baseline What the chunk would be without edits, usually freshly generated.
+	 * @param BaselineId Identifies how Baseline was made, ApplyDelta refuses a different one.
+	 * @param MaxChangedVoxels Give up once more than this many voxels differ.
+	 * @param OutBytes Replaced with the delta blob.
+	 * @return false if too many voxels differ, use Compress instead.
+	 */
+	bool CompressDelta(const FFGVoxelChunk& Baseline, uint32 BaselineId, int32 MaxChangedVoxels, TArray<uint8>& OutBytes) const;
+
+	/**
+	 * Apply a blob made by CompressDelta over the chunk, which must already hold the baseline.
+	 * @param Bytes The delta blob.
+	 * @param BaselineId Identifies how the current contents were made.
+	 * @return false if the blob was corrupt or made against a different baseline, the chunk is left as is.
+	 */
+	bool ApplyDelta(TConstArrayView<uint8> Bytes, uint32 BaselineId);
+
+	/** Was this blob made by CompressDelta rather than Compress? */
+	static bool IsDeltaBlob(TConstArrayView<uint8> Bytes);
+
 	/**
 	 * Set a voxel at a given index dynamically based on the bit size of the voxel.
 	 * @param Index The bit that the int starts at.
@@ -70,8 +162,11 @@ struct FGVOXEL_API FFGVoxelChunk
 	 */
 	FORCEINLINE void SetVoxelBits(int32 Index, const uint32 NewVoxelType)
 	{
-		VoxelData.SetRangeFromRange(Index, BitsPerVoxel, &NewVoxelType);
-		//FFGBitArrayMemory::SetRangeFromRange(VoxelData, Index, BitsPerVoxel, NewVoxelType);
+#if FG_VOXEL_WORD_ALIGNED_STORAGE
+		FFGBitArrayMemory::SetAligned(GetVoxelWords(), Index, BitsPerVoxel, NewVoxelType);
+#else
+		FFGBitArrayMemory::SetUnaligned(GetVoxelWords(), Index, BitsPerVoxel, NewVoxelType);
+#endif
 	}
 
 	/**
@@ -79,20 +174,20 @@ struct FGVOXEL_API FFGVoxelChunk
 	 * @param Index The bit that the int starts at.
 	 * @return The Decoded Voxel Type
 	 */
-	FORCEINLINE uint32 GetVoxelBits(int32 Index)
+	FORCEINLINE uint32 GetVoxelBits(int32 Index) const
 	{
-		uint32 DecodedBits = VOXELTYPE_NONE;
-		VoxelData.GetRange(Index, BitsPerVoxel, &DecodedBits);
-		//FFGBitArrayMemory::GetRange(VoxelData.GetData(), Index, BitsPerVoxel, DecodedBits);
-		return DecodedBits;
+#if FG_VOXEL_WORD_ALIGNED_STORAGE
+		return FFGBitArrayMemory::GetAligned(GetVoxelWords(), Index, BitsPerVoxel);
+#else
+		return FFGBitArrayMemory::GetUnaligned(GetVoxelWords(), Index, BitsPerVoxel);
+#endif
 	}
 
 	uint32& operator[] (uint32 Index)
 	{
-		uint32 PaletteIndex = VOXELTYPE_NONE;
-		FFGBitArrayMemory::GetRange(VoxelData.GetData(), Index, BitsPerVoxel, PaletteIndex);
+		const uint32 PaletteIndex = GetPaletteIndex(Index);
 
-		FPaletteEntry* RESTRICT EntryPtr = Palette.GetData();
+		FPaletteEntry* RESTRICT EntryPtr = GetPalette();
 		return (EntryPtr + PaletteIndex)->VoxelType;
 	}
 
@@ -101,18 +196,55 @@ struct FGVOXEL_API FFGVoxelChunk
 		TArray<int32> OutVoxelTypes;
 		OutVoxelTypes.Reserve(PaletteCount);
 		
-		FPaletteEntry* RESTRICT Entry = Palette.GetData();
-		
-		for(uint32 PaletteIndex = 0; PaletteIndex < PaletteCount; PaletteIndex++)
+		FPaletteEntry* RESTRICT Entry = GetPalette();
+
+		// Freed entries can sit anywhere in the palette, only report live ones.
+		for(int32 PaletteIndex = 0; PaletteIndex < GetPaletteCapacity(); PaletteIndex++)
 		{
-			OutVoxelTypes.Emplace((Entry + PaletteIndex)->VoxelType);
+			if((Entry + PaletteIndex)->RefCount > 0)
+			{
+				OutVoxelTypes.Emplace((Entry + PaletteIndex)->VoxelType);
+			}
 		}
 		return OutVoxelTypes;
 	}
 
+	/** How many unique voxel types are currently stored in the chunk. */
+	uint32 GetPaletteCount() const { return PaletteCount; }
+
+	/** How many bits each voxel index is currently encoded with, 0 when uniform. */
+	int32 GetBitsPerVoxel() const { return BitsPerVoxel; }
+
+	/** Is every voxel in the chunk the same type? Uniform chunks have no voxel data. */
+	FORCEINLINE bool IsUniform() const { return BitsPerVoxel == 0; }
+
+	/** The type every voxel in the chunk has, only valid when IsUniform(). */
+	FORCEINLINE uint32 GetUniformType() const
+	{
+		checkf(IsUniform(), TEXT("Chunk is not uniform!"));
+		return UniformEntry.VoxelType;
+	}
+
+	/** How many palette slots the chunk has room for, live or free. */
+	FORCEINLINE int32 GetPaletteCapacity() const { return 1 << BitsPerVoxel; }
+
+	/** Bytes of heap memory owned by this chunk, it's arena block and palette lookup. */
+	SIZE_T GetAllocatedSize() const
+	{
+		const SIZE_T BlockSize = Block ? FFGVoxelArena::GetBlockSize(BitsPerVoxel) : 0;
+		return BlockSize + PaletteLookup.GetAllocatedSize();
+	}
+
+	/** Size of a single palette entry, for sizing arena blocks. */
+	static constexpr SIZE_T GetPaletteEntrySize() { return sizeof(FPaletteEntry); }
+
 	FORCEINLINE uint32 GetTypeHash(const FFGVoxelChunk& Key) const
 	{
-		return ::GetTypeHash(Key.VoxelData);
+		if(Key.IsUniform()) // No voxel data to hash, the single type is the whole chunk.
+		{
+			return ::GetTypeHash(Key.UniformEntry.VoxelType);
+		}
+		return FCrc::MemCrc32(Key.GetVoxelWords(), FFGVoxelArena::GetVoxelBytes(Key.BitsPerVoxel));
 	}
 
 	bool operator==(const FFGVoxelChunk& Other) const
@@ -136,9 +268,40 @@ struct FGVOXEL_API FFGVoxelChunk
 	}
 
 private:
+
+	/** Packed voxel indices, at the front of the arena block. */
+	FORCEINLINE uint32* GetVoxelWords() const
+	{
+		return reinterpret_cast<uint32*>(Block);
+	}
+
+	/** Palette entries, straight after the voxel words, or the inline entry when uniform. */
+	FORCEINLINE FPaletteEntry* GetPalette()
+	{
+		return IsUniform() ? &UniformEntry : reinterpret_cast<FPaletteEntry*>(Block + FFGVoxelArena::GetVoxelBytes(BitsPerVoxel));
+	}
+
+	FORCEINLINE const FPaletteEntry* GetPalette() const
+	{
+		return const_cast<FFGVoxelChunk*>(this)->GetPalette();
+	}
+
+	/** Palette index of a voxel, uniform chunks are always index 0. */
+	FORCEINLINE uint32 GetPaletteIndex(int32 VoxelIndex) const
+	{
+		return IsUniform() ? 0 : GetVoxelBits(VoxelIndex * BitsPerVoxel);
+	}
 		
 	uint32	AddPaletteEntry();
+	void	ReleasePaletteEntry(uint32 PaletteIndex);
 	void	GrowPalette();
+	void	RebuildPaletteLookup();
+	void	UnpackIndices(uint16* RESTRICT OutIndices) const;
+	void	PackIndices(const uint16* RESTRICT Indices);
+	void	ReplaceStorage(int32 NewBitsPerVoxel, const FPaletteEntry* NewPalette, int32 NumEntries);
+	void	ReleaseStorage();
+
+	static int32 GetBitsForPaletteSize(uint32 NumEntries);
 
 	struct FPaletteEntry
 	{
@@ -170,7 +333,14 @@ private:
 
 	EFGChunkFlags			Flags;
 	int32					BitsPerVoxel;
-	uint32					PaletteCount;	// How many palette entries are in use.
-	TArray<FPaletteEntry>	Palette;		// The palette of voxel types
-	TBitArray<>				VoxelData;		// BitsPerVoxel * ChunkSizeXYZ
+	uint32					PaletteCount;		// How many palette entries are in use.
+	uint32					PaletteFreeHead;	// First free palette entry, INDEX_NONE when full.
+	uint8*					Block;				// Arena block, BitsPerVoxel * ChunkSizeXYZ then the palette, null when uniform.
+	FPaletteEntry			UniformEntry;		// The whole palette when uniform.
+
+	/**
+	 * Reverse index of voxel type to palette index, so SetVoxel doesn't have to
+	 * scan the palette. Only live entries (RefCount > 0) are present in here.
+	 */
+	Experimental::TRobinHoodHashMap<uint32, uint16> PaletteLookup;
 };
@@ -3,6 +3,30 @@
 
 #include "FGVoxelGrid.h"
 #include "FGVoxelUtils.h"
+#include "Utils/FGUtils.h"
+#include "Tasks/Task.h"
+#include "Algo/AllOf.h"
+#include "Algo/Sort.h"
+#include "FGVoxelStats.h"
+#include "Containers/FGRegionStore.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Generation Ms / Chunk"),	STAT_FGVoxelGrid_GenerationCost,	STATGROUP_FGVoxelGrid);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Meshing Ms / Chunk"),		STAT_FGVoxelGrid_MeshingCost,		STATGROUP_FGVoxelGrid);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Actor Spawn Ms / Chunk"),	STAT_FGVoxelGrid_ActorSpawnCost,	STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pending Chunks"),			STAT_FGVoxelGrid_PendingChunks,		STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Generating Chunks"),		STAT_FGVoxelGrid_GeneratingChunks,	STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Staged Chunks"),			STAT_FGVoxelGrid_StagedChunks,		STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Admitted Chunks"),			STAT_FGVoxelGrid_AdmittedChunks,	STATGROUP_FGVoxelGrid);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Cache Hit Rate %"),		STAT_FGVoxelGrid_CacheHitRate,		STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cache Resident Chunks"),	STAT_FGVoxelGrid_CacheResident,		STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cache Cold Chunks"),		STAT_FGVoxelGrid_CacheCold,			STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cache Evictions"),			STAT_FGVoxelGrid_CacheEvictions,	STATGROUP_FGVoxelGrid);
+DECLARE_MEMORY_STAT(TEXT("Cache Resident Bytes"),			STAT_FGVoxelGrid_CacheResidentBytes,	STATGROUP_FGVoxelGrid);
+DECLARE_MEMORY_STAT(TEXT("Cache Cold Bytes"),				STAT_FGVoxelGrid_CacheColdBytes,	STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Completion Queue"),		STAT_FGVoxelGrid_CompletionQueue,	STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ready Chunks"),			STAT_FGVoxelGrid_ReadyChunks,		STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pending Load Handles"),	STAT_FGVoxelGrid_PendingLoadHandles,	STATGROUP_FGVoxelGrid);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Journaled Edits"),			STAT_FGVoxelGrid_JournaledEdits,	STATGROUP_FGVoxelGrid);
 
 namespace FG
 {
@@ -10,7 +34,95 @@ namespace FG
 	FAutoConsoleVariableRef CVarChunkGenBudget (
 		TEXT("FG.ChunkGenBudget"),
 		ChunkGenBudget,
-		TEXT("How many chunks can be generated per tick."),
+		TEXT("Hard cap on how many chunks can be generating in the background at once."),
+		ECVF_Default
+	);
+
+	static float ChunkGenBudgetMs = 4.0f;
+	FAutoConsoleVariableRef CVarChunkGenBudgetMs (
+		TEXT("FG.ChunkGenBudgetMs"),
+		ChunkGenBudgetMs,
+		TEXT("How much generation work to keep in flight per worker thread, in milliseconds of measured chunk cost."),
+		ECVF_Default
+	);
+
+	static float ChunkCompletionBudgetMs = 2.0f;
+	FAutoConsoleVariableRef CVarChunkCompletionBudgetMs (
+		TEXT("FG.ChunkCompletionBudgetMs"),
+		ChunkCompletionBudgetMs,
+		TEXT("How long the game thread can spend per tick on finished chunks, including meshing and actor spawning, in milliseconds."),
+		ECVF_Default
+	);
+
+	static int32 ChunkCacheBudgetMB = 256;
+	FAutoConsoleVariableRef CVarChunkCacheBudgetMB (
+		TEXT("FG.ChunkCacheBudgetMB"),
+		ChunkCacheBudgetMB,
+		TEXT("How much memory unreferenced chunks can keep resident before they are evicted, 0 disables the cache."),
+		ECVF_Default
+	);
+
+	static int32 ChunkCacheColdBudgetMB = 64;
+	FAutoConsoleVariableRef CVarChunkCacheColdBudgetMB (
+		TEXT("FG.ChunkCacheColdBudgetMB"),
+		ChunkCacheColdBudgetMB,
+		TEXT("How much memory evicted chunks can hold compressed in the cold tier, 0 disables the cold tier."),
+		ECVF_Default
+	);
+
+	static bool VoxelPersistence = true;
+	FAutoConsoleVariableRef CVarVoxelPersistence (
+		TEXT("FG.VoxelPersistence"),
+		VoxelPersistence,
+		TEXT("Save edited chunks to region files and load them back instead of generating. Applies when the generator is next set. (0/1)"),
+		ECVF_Default
+	);
+
+	static float JournalFlushIntervalMs = 250.0f;
+	FAutoConsoleVariableRef CVarJournalFlushIntervalMs (
+		TEXT("FG.JournalFlushIntervalMs"),
+		JournalFlushIntervalMs,
+		TEXT("How often journaled voxel edits are written to disk as a batch, in milliseconds."),
+		ECVF_Default
+	);
+
+	static float JournalCheckpointInterval = 60.0f;
+	FAutoConsoleVariableRef CVarJournalCheckpointInterval (
+		TEXT("FG.JournalCheckpointInterval"),
+		JournalCheckpointInterval,
+		TEXT("How often modified chunks are saved and the edit journal folded into the region files, in seconds."),
+		ECVF_Default
+	);
+
+	static int32 JournalCheckpointMB = 8;
+	FAutoConsoleVariableRef CVarJournalCheckpointMB (
+		TEXT("FG.JournalCheckpointMB"),
+		JournalCheckpointMB,
+		TEXT("Checkpoint early once the edit journal grows past this size."),
+		ECVF_Default
+	);
+
+	static int32 ChunkGenBatchSize = 16;
+	FAutoConsoleVariableRef CVarChunkGenBatchSize (
+		TEXT("FG.ChunkGenBatchSize"),
+		ChunkGenBatchSize,
+		TEXT("Most chunks generated together by one task, nearby chunks share noise. Smaller when there isn't enough work for every worker."),
+		ECVF_Default
+	);
+
+	static bool SkipAirChunks = true;
+	FAutoConsoleVariableRef CVarSkipAirChunks (
+		TEXT("FG.SkipAirChunks"),
+		SkipAirChunks,
+		TEXT("Don't run the generator for chunks entirely above the surface of their column. (0/1)"),
+		ECVF_Default
+	);
+
+	static int32 ColumnSummaryBudget = 4096;
+	FAutoConsoleVariableRef CVarColumnSummaryBudget (
+		TEXT("FG.ColumnSummaryBudget"),
+		ColumnSummaryBudget,
+		TEXT("How many chunk columns keep a surface summary, about 4KB each. The furthest are dropped first."),
 		ECVF_Default
 	);
 
@@ -33,27 +145,42 @@ namespace FG
 
 using namespace FG::Const;
 
-/**
- * @TODO:
- * A slight problem with this design i've just noticed is that if you mark something to be generated
- * as a batch and it was already generated, it's skipped - you still get the callback in this case.
- * But what happens if you mark a chunk to be generated and it's already pending, you are now blocked
- * but some other load that happens, we might need a way to essentially check if it's pending and then
- * say OI THIS IS MINE NOW, and yoink it out of the other batch (the latermost loaded one).
- *
- * I think the big brain solution here is task stealing but that's too large brained 5 me.
- *
- * @TODO: UPDATE
- * Okay - now we've refactored a bit, a more sane solution has presented itself.
- * 
- * The simple way is just to track the load batch on the chunk handle itself and if another chunk with
- * a higher priority swoops in then we shuffle the priority up.
- *
- * Otherwise we could just have a single
- * 
- */
+namespace FG::Private
+{
+	/** A pending chunk request with it's score for this tick, lowest goes first. */
+	struct FChunkLoadCandidate
+	{
+		double Priority;
+		uint64 Sequence;
+		FFGChunkKey ChunkKey;
+
+		bool operator<(const FChunkLoadCandidate& Other) const
+		{
+			return Priority != Other.Priority ? Priority < Other.Priority : Sequence < Other.Sequence;
+		}
+	};
+
+	/** A chunk popped off the heap to generate this tick, waiting to be batched. */
+	struct FAdmittedChunk
+	{
+		FFGChunkKey ChunkKey;
+		FFGChunkLoadRequest Request;
+		bool KnownAir;
+	};
+
+#if CSV_PROFILER
+	static float GetArenaInUseMB(int32 BitsPerVoxel)
+	{
+		const FFGVoxelArena::FSizeClassStats Stats = FFGVoxelArena::Get().GetStats(BitsPerVoxel);
+		return (float)(Stats.BlockSize * Stats.BlocksInUse / (1024.0 * 1024.0));
+	}
+#endif
+}
+
 void UFGVoxelGrid::Tick(float DeltaTime)
 {
+	CSV_SCOPED_TIMING_STAT(FGVoxel, GridTick);
+
 	if (!GetWorld() || GetWorld()->bIsTearingDown)
 	{
 		return;
@@ -65,329 +192,1551 @@ void UFGVoxelGrid::Tick(float DeltaTime)
 		OnUnloadedChunk.Broadcast(InternalGarbageChunks.Pop());
 	}
 
-	// Resize internal chunk allocations.
-	int32 ExpansionSize = InternalChunkCount - InternalChunkData.Num();
-	if(ExpansionSize > 0)
+	// Publish last frames changes to worker threads, and recycle slots nobody can see anymore.
+	ChunkIndex.Publish();
+
+	const int32 NumFreeBefore = InternalChunkFreelist.Num();
+	ChunkIndex.Reclaim(InternalChunkFreelist);
+
+	// Nobody can be reading these anymore, give their storage back rather than waiting for reuse.
+	for(int32 Free = NumFreeBefore; Free < InternalChunkFreelist.Num(); Free++)
 	{
-		InternalChunkData.AddDefaulted();
+		InternalChunkData[InternalChunkFreelist[Free]].Reset();
 	}
 
-	if (FG::VoxelImmediateMode) // Immediate mode - single-threaded, non time-sliced loading.
-	{
-		int32 Elem = 0;
+	// Budgets are cvars, so they can shrink under us at any time.
+	TrimChunkCache();
 
-		for (FFGVoxelLoadHandle& LoadHandle : InternalLoadHandles)
+	TickEditJournal(DeltaTime);
+
+	SET_DWORD_STAT(STAT_FGVoxelGrid_ReadyChunks, ReadyChunks.Num());
+	CSV_CUSTOM_STAT(FGVoxel, ReadyChunks, ReadyChunks.Num(), ECsvCustomStatOp::Set);
+
+	// Loads that merged onto already generated chunks, callbacks may request more so swap first.
+	TArray<TPair<TWeakPtr<FFGVoxelLoadHandleData>, FFGChunkHandle>> ReadyForFrame = MoveTemp(ReadyChunks);
+	for(const TPair<TWeakPtr<FFGVoxelLoadHandleData>, FFGChunkHandle>& ReadyChunk : ReadyForFrame)
+	{
+		if(FFGVoxelLoadHandle LoadHandle = ReadyChunk.Key.Pin())
 		{
-			for(int32 Load = LoadHandle->GetLoadCount(); Load < LoadHandle->GetBatchSize(); Load++, Elem++)
-			{
-				GenerateChunk(LoadHandle->ChunkHandles[Load]);
-				LoadHandle->OnFinishedLoadingChunk.Broadcast(LoadHandle->ChunkHandles[Load]);
-			}
-			LoadHandle->OnFinishedLoadingBatch.Broadcast(MoveTemp(LoadHandle->ChunkHandles));
+			FinishChunkLoad(LoadHandle, ReadyChunk.Value);
 		}
-		
-		InternalLoadHandles.Empty();
-		InternalNumPending = 0;
 	}
-	else // Parallel mode - multi-threaded, time-sliced loading.
-	{
-		TArray<FFGChunkHandle> WorkForFrame;
-		TArray<int32> WorkBatches; // @TODO: Not ideal but quick and dirty.
-		int32 BatchesToProcess = 0;
-
-		// Squash batches into one workload capped at budget size.
-		{
-			int32 GenerationBudget = FMath::Min(InternalNumPending, FG::ChunkGenBudget);
-			int32 RemainingBudget = GenerationBudget;
-			int32 ProcessedElemsTotal = 0;
 
-			for(int32 Batch = 0; Batch < InternalLoadHandles.Num(); Batch++) // Loop batches until we exceed budget.
-			{
-				if(RemainingBudget <= 0 || ProcessedElemsTotal >= InternalNumPending) // Exceeded budget or ran out of work.
-				{
-					break;
-				}
+	DrainCompletedChunks();
 
-				FFGVoxelLoadHandle LoadBatch = InternalLoadHandles[Batch];
-				int32 ProcessedElemsInBatch = 0;
+	SET_FLOAT_STAT(STAT_FGVoxelGrid_GenerationCost, GetChunkStageCostMs(EFGChunkStage::Generation));
+	SET_FLOAT_STAT(STAT_FGVoxelGrid_MeshingCost, GetChunkStageCostMs(EFGChunkStage::Meshing));
+	SET_FLOAT_STAT(STAT_FGVoxelGrid_ActorSpawnCost, GetChunkStageCostMs(EFGChunkStage::ActorSpawn));
+	SET_DWORD_STAT(STAT_FGVoxelGrid_PendingChunks, PendingRequests.Num());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_GeneratingChunks, InFlightRequests.Num());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_StagedChunks, StagedChunks.Num());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_AdmittedChunks, 0);
 
-				for(int32 Chunk = LoadBatch->GetLoadCount(); Chunk < LoadBatch->GetBatchSize(); Chunk++) // Loop batch elems.
-				{
-					const FIntVector ChunkCoordinate = LoadBatch->ChunkCoordinates[Chunk];
-					
-					ProcessedElemsTotal += 1;
-					ProcessedElemsInBatch += 1;
+	const FFGChunkCache::FStats& CacheStats = ChunkCache.GetStats();
+	const uint64 CacheLookups = CacheStats.Hits + CacheStats.ColdHits + CacheStats.Misses;
+	SET_FLOAT_STAT(STAT_FGVoxelGrid_CacheHitRate, CacheLookups > 0 ? 100.0 * (CacheStats.Hits + CacheStats.ColdHits) / CacheLookups : 0.0);
+	SET_DWORD_STAT(STAT_FGVoxelGrid_CacheResident, ChunkCache.GetNumResident());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_CacheCold, ChunkCache.GetNumCold());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_CacheEvictions, CacheStats.Evictions);
+	SET_MEMORY_STAT(STAT_FGVoxelGrid_CacheResidentBytes, CacheStats.ResidentBytes);
+	SET_MEMORY_STAT(STAT_FGVoxelGrid_CacheColdBytes, CacheStats.ColdBytes);
+	SET_DWORD_STAT(STAT_FGVoxelGrid_CompletionQueue, NumCompletedChunks.load(std::memory_order_relaxed));
+	SET_DWORD_STAT(STAT_FGVoxelGrid_JournaledEdits, EditJournal.IsValid() ? EditJournal->GetNumPendingEdits() : 0);
 
-					if(IsChunkGenerated(ChunkCoordinate)) // Already loaded, skip.
-					{
-						continue;
-					}
+#if STATS || CSV_PROFILER
+	int32 NumPendingLoadHandles = 0;
+	for(const TPair<FFGChunkKey, FFGChunkLoadRequest>& Pending : PendingRequests)
+	{
+		NumPendingLoadHandles += Pending.Value.LoadHandles.Num();
+	}
+	for(const TPair<FFGChunkKey, FFGChunkLoadRequest>& InFlight : InFlightRequests)
+	{
+		NumPendingLoadHandles += InFlight.Value.LoadHandles.Num();
+	}
+	for(const TPair<FFGChunkKey, FFGChunkLoadRequest>& Staged : StagedChunks)
+	{
+		NumPendingLoadHandles += Staged.Value.LoadHandles.Num();
+	}
+	SET_DWORD_STAT(STAT_FGVoxelGrid_PendingLoadHandles, NumPendingLoadHandles);
 
-					if(FG::DebugChunkLoading)
-					{
-						UFGVoxelUtils::DebugDrawChunk(GetWorld(), ChunkCoordinate);
-					}
+	CSV_CUSTOM_STAT(FGVoxel, PendingChunks, PendingRequests.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, GeneratingChunks, InFlightRequests.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, StagedChunks, StagedChunks.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, CompletionQueue, NumCompletedChunks.load(std::memory_order_relaxed), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, PendingLoadHandles, NumPendingLoadHandles, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, GenerationMs, (float)GetChunkStageCostMs(EFGChunkStage::Generation), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, MeshingMs, (float)GetChunkStageCostMs(EFGChunkStage::Meshing), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, CacheResidentMB, (float)(CacheStats.ResidentBytes / (1024.0 * 1024.0)), ECsvCustomStatOp::Set);
 
-					RemainingBudget -= 1;
-					WorkForFrame.Add(LoadBatch->ChunkHandles[Chunk]);
-					WorkBatches.Add(Batch);
-					LoadBatch->LoadedIndices.Add(Chunk);
+	// Chunk memory actually in use per size class, the arena's own stats only show what's committed.
+	CSV_CUSTOM_STAT(FGVoxel, ChunkMB1Bit, FG::Private::GetArenaInUseMB(1), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, ChunkMB2Bit, FG::Private::GetArenaInUseMB(2), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, ChunkMB4Bit, FG::Private::GetArenaInUseMB(4), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, ChunkMB8Bit, FG::Private::GetArenaInUseMB(8), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, ChunkMB16Bit, FG::Private::GetArenaInUseMB(16), ECsvCustomStatOp::Set);
+#endif
 
-					if(RemainingBudget <= 0 || ProcessedElemsTotal >= InternalNumPending) // Exceeded budget or ran out of work.
-					{
-						break;
-					}
-				}
+	if(PendingRequests.IsEmpty() && StagedChunks.IsEmpty())
+	{
+		return;
+	}
 
-				LoadBatch->LoadCount += ProcessedElemsInBatch;
-				BatchesToProcess += 1;
-			}
+	GatherViewers();
+	TrimColumnSummaries();
 
-			if(ProcessedElemsTotal > 0)
-			{
-				InternalNumPending -= ProcessedElemsTotal;
-				InternalChunkData.AddDefaulted(WorkForFrame.Num());
-				ActiveChunkHandles.Reserve(ActiveChunkHandles.Num() + WorkForFrame.Num());
-			}
-		}
+	// Before admitting new chunks, stages may ask for neighbours they're missing.
+	TickGenerationStages();
 
-		// Fork the work across threads.
-		{
-			// @TODO: We actually don't need to hold the game thread here, we could be trigger a UE::Task to
-			// the gamethread here that fires callbacks and then the GT can continue bing chilling.
+	if(PendingRequests.IsEmpty())
+	{
+		return;
+	}
 
-			DECLARE_CYCLE_STAT(TEXT("FGameThreadVoxelTask.ParallelGeneration"), STAT_VoxelParallelGeneration, STATGROUP_TaskGraphTasks);
+	// Score everything still wanted, cancelling requests whose loads have all been dropped.
+	TArray<FG::Private::FChunkLoadCandidate> Candidates;
+	Candidates.Reserve(PendingRequests.Num());
 
-			ParallelFor(WorkForFrame.Num(), [&](int32 Index) // BRRRRRRRRR
-			{
-				FFGVoxelLoadHandle LoadHandle = InternalLoadHandles[WorkBatches[Index]];
-				FFGChunkHandle ChunkHandle = WorkForFrame[Index];
-				
-				GenerateChunk(ChunkHandle);
+	for(TMap<FFGChunkKey, FFGChunkLoadRequest>::TIterator It = PendingRequests.CreateIterator(); It; ++It)
+	{
+		FFGChunkLoadRequest& Request = It.Value();
+		Request.LoadHandles.RemoveAllSwap([](const TWeakPtr<FFGVoxelLoadHandleData>& LoadHandle)
+		{
+			return !LoadHandle.IsValid();
+		});
 
-				UFGVoxelUtils::RunCommandOnGameThread(this, [this, LoadHandle, ChunkHandle]()
-				{
-					LoadHandle->OnFinishedLoadingChunk.Broadcast(ChunkHandle);
-					
-				}, GET_STATID(STAT_VoxelParallelGeneration));
-			});
+		if(Request.LoadHandles.IsEmpty() && Request.NumDependents == 0)
+		{
+			It.RemoveCurrent(); // Releases the chunk handle, unloading the slot.
+			continue;
+		}
 
-			int32 CompletedBatches = 0;
+		double Priority = GetViewerPriority(Request.ChunkHandle->ChunkCoordinate);
 
-			// Run callbacks for batch work completion.
-			for(int32 Batch = 0; Batch < BatchesToProcess; Batch++)
-			{
-				checkf(InternalLoadHandles.IsValidIndex(Batch), TEXT("Invalid batch index!"));
-				FFGVoxelLoadHandle LoadHandle = InternalLoadHandles[Batch];
-				
-				if(InternalLoadHandles[Batch]->GetLoadCount() >= InternalLoadHandles[Batch]->GetBatchSize())
-				{
-					CompletedBatches += 1;
-					LoadHandle->OnFinishedLoadingBatch.Broadcast(MoveTemp(LoadHandle->ChunkHandles));
-				}
-			}
+		// Only pushed back if every load wants it speculatively, a real load merging on takes it's place in line.
+		// Neighbours a staged chunk is waiting on are never speculative.
+		const bool LowPriority = Request.NumDependents == 0 && Algo::AllOf(Request.LoadHandles, [](const TWeakPtr<FFGVoxelLoadHandleData>& LoadHandle)
+		{
+			const FFGVoxelLoadHandle PinnedHandle = LoadHandle.Pin();
+			return PinnedHandle.IsValid() && PinnedHandle->LowPriority;
+		});
 
-			InternalLoadHandles.RemoveAt(0, CompletedBatches);
+		if(LowPriority)
+		{
+			constexpr double LowPriorityOffset = 1.0e12; // Further than any viewer distance squared.
+			Priority += LowPriorityOffset;
 		}
+
+		Candidates.Add({ Priority, Request.Sequence, It.Key() });
 	}
-}
 
+	// Immediate mode - single-threaded, non time-sliced loading, otherwise top up the background work.
+	const int32 Budget = FG::VoxelImmediateMode ? Candidates.Num() : GetGenerationAdmission(Candidates.Num());
+	SET_DWORD_STAT(STAT_FGVoxelGrid_AdmittedChunks, Budget);
 
-void UFGVoxelGrid::SetGeneratorType(TSubclassOf<UFGVoxelGenerator> GeneratorType)
-{
-	WorldGenerator = NewObject<UFGVoxelGenerator>(this, GeneratorType);
-	FlushAllChunks();
-}
+	// Heapify is linear, so only the chunks we actually pop pay the log cost.
+	Candidates.Heapify();
 
-FFGVoxelLoadHandle UFGVoxelGrid::LoadChunkAsync(FIntVector ChunkCoordinate)
-{
-	DECLARE_CYCLE_STAT(TEXT("FGameThreadVoxelTask.LoadChunkAsync"), STAT_VoxelLoadChunkAsync, STATGROUP_TaskGraphTasks);
+	TArray<FG::Private::FAdmittedChunk> Admitted;
+	Admitted.Reserve(Budget);
 
-	FFGVoxelLoadHandle LoadHandle = MakeShared<FFGVoxelLoadHandleData, ESPMode::ThreadSafe>(FFGVoxelLoadHandleData());
-	
-	UFGVoxelUtils::RunCommandOnGameThread(this, [this, ChunkCoordinate, LoadHandle]()
+	for(int32 Work = 0; Work < Budget; Work++)
 	{
-		int32 NextIndex;
+		FG::Private::FChunkLoadCandidate Candidate;
+		Candidates.HeapPop(Candidate, EAllowShrinking::No);
+
+		FFGChunkLoadRequest Request = PendingRequests.FindAndRemoveChecked(Candidate.ChunkKey);
+		const bool KnownAir = FG::SkipAirChunks && IsChunkAboveSurface(Request.ChunkHandle->ChunkCoordinate);
 
-		if(!InternalChunkFreelist.IsEmpty()) // Steal from the freelist.
+		if(FG::DebugChunkLoading)
 		{
-			NextIndex = InternalChunkFreelist.Pop();
+			UFGVoxelUtils::DebugDrawChunk(GetWorld(), Request.ChunkHandle->ChunkCoordinate);
 		}
-		else // Reserve our index to append to the chunk data.
+
+		if(FG::VoxelImmediateMode)
 		{
-			NextIndex = FPlatformAtomics::InterlockedIncrement(&InternalChunkCount) - 1;
+			const double StartTime = FPlatformTime::Seconds();
+			const bool NeedsStages = GenerateChunk(Request.ChunkHandle, KnownAir);
+			RecordChunkStageCost(EFGChunkStage::Generation, FPlatformTime::Seconds() - StartTime);
+
+			FinishTerrainStage(MoveTemp(Request), NeedsStages);
+			continue;
 		}
 
-		FPlatformAtomics::InterlockedIncrement(&InternalNumPending);
+		Admitted.Add({ Candidate.ChunkKey, MoveTemp(Request), KnownAir });
+	}
 
-		FFGChunkHandle ChunkHandle = ConstructChunkHandle(ChunkCoordinate);
-		ChunkHandle->ChunkCoordinate = ChunkCoordinate;
-		ChunkHandle->ChunkDataIndex = NextIndex;
+	if(Admitted.IsEmpty())
+	{
+		return;
+	}
 
-		TSharedRef<FFGVoxelLoadHandleData> HandleDataRef = LoadHandle.ToSharedRef();
-		//FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchStartIndex, InternalNumPending);
-		FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchSize, 1);
-		
-		// @TODO: These arrays aren't safe to read on other threads while we are writing, need a mutex.
-		HandleDataRef->ChunkCoordinates.Add(ChunkCoordinate);
-		HandleDataRef->ChunkHandles.Add(ChunkHandle);
+	// Neighbouring columns next to each other, so each batch covers a compact patch the generator can share noise across.
+	Algo::Sort(Admitted, [](const FG::Private::FAdmittedChunk& A, const FG::Private::FAdmittedChunk& B)
+	{
+		const FIntVector& CoordA = A.Request.ChunkHandle->ChunkCoordinate;
+		const FIntVector& CoordB = B.Request.ChunkHandle->ChunkCoordinate;
+		const FIntVector TileA(CoordA.X >> 2, CoordA.Y >> 2, 0);
+		const FIntVector TileB(CoordB.X >> 2, CoordB.Y >> 2, 0);
 
-		InternalLoadHandles.Add(LoadHandle);
-		
-	}, GET_STATID(STAT_VoxelLoadChunkAsync));
-	
-	return LoadHandle;
-}
+		if(TileA.X != TileB.X) return TileA.X < TileB.X;
+		if(TileA.Y != TileB.Y) return TileA.Y < TileB.Y;
+		if(CoordA.X != CoordB.X) return CoordA.X < CoordB.X;
+		if(CoordA.Y != CoordB.Y) return CoordA.Y < CoordB.Y;
+		return CoordA.Z > CoordB.Z;
+	});
 
-FFGVoxelLoadHandle UFGVoxelGrid::LoadChunkBatchAsync(TArray<FIntVector> ChunkCoordinates)
-{
-	DECLARE_CYCLE_STAT(TEXT("FGameThreadVoxelTask.LoadChunkBatchAsync"), STAT_VoxelLoadChunkBatchAsync, STATGROUP_TaskGraphTasks);
+	// Never batch so much that workers go idle.
+	const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	const int32 BatchSize = FMath::Clamp(FMath::DivideAndRoundUp(Admitted.Num(), NumWorkers), 1, FMath::Max(FG::ChunkGenBatchSize, 1));
 
-	FFGVoxelLoadHandle LoadHandle = MakeShared<FFGVoxelLoadHandleData, ESPMode::ThreadSafe>(FFGVoxelLoadHandleData());
-	
-	UFGVoxelUtils::RunCommandOnGameThread(this, [this, ChunkCoordinates, LoadHandle]() {
-		ActiveChunkHandles.Reserve(ActiveChunkHandles.Num() + ChunkCoordinates.Num());
+	for(int32 BatchStart = 0; BatchStart < Admitted.Num(); BatchStart += BatchSize)
+	{
+		const int32 BatchEnd = FMath::Min(BatchStart + BatchSize, Admitted.Num());
 
+		TArray<FFGChunkKey> ChunkKeys;
 		TArray<FFGChunkHandle> ChunkHandles;
-		ChunkHandles.Reserve(ChunkCoordinates.Num());
+		TArray<bool> KnownAir;
 
-		for(int32 Chunk = 0; Chunk < ChunkCoordinates.Num(); Chunk++)
+		for(int32 Chunk = BatchStart; Chunk < BatchEnd; Chunk++)
+		{
+			ChunkKeys.Add(Admitted[Chunk].ChunkKey);
+			ChunkHandles.Add(Admitted[Chunk].Request.ChunkHandle);
+			KnownAir.Add(Admitted[Chunk].KnownAir);
+		}
+
+		// Generate in the background, the game thread picks it up from the completion queue.
+		UE::Tasks::FTask GenerationTask = UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[this, ChunkKeys = MoveTemp(ChunkKeys), ChunkHandles = MoveTemp(ChunkHandles), KnownAir = MoveTemp(KnownAir)]() mutable
 		{
-			int32 NextIndex;
+			TArray<bool, TInlineAllocator<16>> NeedsStages;
+			NeedsStages.SetNumZeroed(ChunkHandles.Num());
 
-			if(!InternalChunkFreelist.IsEmpty()) // Steal from the freelist.
-			{
-				NextIndex = InternalChunkFreelist.Pop();
-			}
-			else // Reserve our index to append to the chunk data.
+			const double StartTime = FPlatformTime::Seconds();
+			GenerateChunkBatch(ChunkHandles, KnownAir, NeedsStages);
+
+			const double SecondsPerChunk = (FPlatformTime::Seconds() - StartTime) / ChunkKeys.Num();
+			for(int32 Chunk = 0; Chunk < ChunkKeys.Num(); Chunk++)
 			{
-				NextIndex = FPlatformAtomics::InterlockedIncrement(&InternalChunkCount) - 1;
+				// Never drop a handle here, it may be the last reference, the game thread releases it.
+				CompletedChunks.Enqueue({ ChunkKeys[Chunk], MoveTemp(ChunkHandles[Chunk]), SecondsPerChunk, NeedsStages[Chunk] });
+				NumCompletedChunks.fetch_add(1, std::memory_order_relaxed);
 			}
+		});
 
-			FFGChunkHandle ChunkHandle = ConstructChunkHandle(ChunkCoordinates[Chunk]);
-			ChunkHandle->ChunkCoordinate = ChunkCoordinates[Chunk];
-			ChunkHandle->ChunkDataIndex = NextIndex;
-			ChunkHandles.Add(ChunkHandle);
+		for(int32 Chunk = BatchStart; Chunk < BatchEnd; Chunk++)
+		{
+			Admitted[Chunk].Request.GenerationTask = GenerationTask;
+			InFlightRequests.Add(Admitted[Chunk].ChunkKey, MoveTemp(Admitted[Chunk].Request));
 		}
-		
-		FPlatformAtomics::InterlockedAdd(&InternalNumPending, ChunkCoordinates.Num());
+	}
+}
 
-		TSharedRef<FFGVoxelLoadHandleData> HandleDataRef = LoadHandle.ToSharedRef();
-		//FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchStartIndex, InternalNumPending);
-		FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchSize, ChunkCoordinates.Num());
+void UFGVoxelGrid::BeginDestroy()
+{
+	// Tasks hold a raw pointer back to us, they have to finish first.
+	WaitForGeneration();
 
-		// @TODO: These arrays aren't safe to read on other threads while we are writing, need a mutex.
-		HandleDataRef->ChunkCoordinates = ChunkCoordinates;
-		HandleDataRef->ChunkHandles = ChunkHandles;
+	SaveModifiedChunks(false);
+	EditJournal.Reset(); // Blocks until every edit is written.
+	RegionStore.Reset(); // Blocks until every save is written.
 
-		InternalLoadHandles.Add(LoadHandle);
-		
-	}, GET_STATID(STAT_VoxelLoadChunkBatchAsync));
-	
-	return LoadHandle;
+	Super::BeginDestroy();
 }
 
-void UFGVoxelGrid::FlushAllChunks()
+void UFGVoxelGrid::DrainCompletedChunks()
 {
-	FPlatformAtomics::InterlockedExchange(&InternalChunkCount, 0);
-	ActiveChunkHandles.Empty();
-	InternalChunkData.Empty();
-	InternalGarbageChunks.Empty();
-	InternalChunkFreelist.Empty();
-	InternalLoadHandles.Empty();
-}
+	CSV_SCOPED_TIMING_STAT(FGVoxel, DrainCompletedChunks);
 
-FFGChunkHandle UFGVoxelGrid::FindChunk(FIntVector ChunkCoordinate)
-{
-	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
-	if(TWeakPtr<FFGChunkHandleData>* WeakChunkHandle = ActiveChunkHandles.Find(ChunkCoordinate))
+	const double StartTime = FPlatformTime::Seconds();
+	const double BudgetSeconds = FG::ChunkCompletionBudgetMs / 1000.0;
+
+	// What we expect the next chunk to cost the game thread once the renderers get hold of it.
+	const double PredictedSeconds = (GetChunkStageCostMs(EFGChunkStage::Meshing) + GetChunkStageCostMs(EFGChunkStage::ActorSpawn)) / 1000.0;
+
+	// Always take at least one so progress is made however tight the budget is.
+	bool FirstChunk = true;
+	FFGCompletedChunk Completed;
+
+	while(!CompletedChunks.IsEmpty())
 	{
-		if(WeakChunkHandle->IsValid())
+		if(!FirstChunk && FPlatformTime::Seconds() - StartTime + PredictedSeconds > BudgetSeconds)
+		{
+			break;
+		}
+
+		CompletedChunks.Dequeue(Completed);
+		NumCompletedChunks.fetch_sub(1, std::memory_order_relaxed);
+		RecordChunkStageCost(EFGChunkStage::Generation, Completed.GenerationSeconds);
+
+		FFGChunkLoadRequest Request;
+		if(InFlightRequests.RemoveAndCopyValue(Completed.ChunkKey, Request))
+		{
+			FinishTerrainStage(MoveTemp(Request), Completed.NeedsStages);
+		}
+		else // Not generating Terrain, so it's one of the later stages.
 		{
-			return WeakChunkHandle->Pin();
+			FinishGenerationStage(Completed.ChunkKey);
 		}
+		FirstChunk = false;
 	}
-	return FFGChunkHandle();
 }
 
-FFGChunkHandle UFGVoxelGrid::FindChunkChecked(FIntVector ChunkCoordinate)
+int32 UFGVoxelGrid::GetGenerationAdmission(int32 NumCandidates) const
 {
-	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+	// Keep enough measured work in flight to fill every worker for the budget, no more.
+	const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	const double CostMs = FMath::Max(GetChunkStageCostMs(EFGChunkStage::Generation), 0.01);
+	const int32 TargetInFlight = FMath::Max(1, FMath::FloorToInt32(FG::ChunkGenBudgetMs * NumWorkers / CostMs));
 
-	TWeakPtr<FFGChunkHandleData> WeakChunkHandle = ActiveChunkHandles.FindChecked(ChunkCoordinate);
-	checkf(WeakChunkHandle.IsValid(), TEXT("Invalid chunk handle!"));
-	return WeakChunkHandle.Pin();
+	const int32 MaxInFlight = FMath::Min(TargetInFlight, FG::ChunkGenBudget);
+	return FMath::Clamp(MaxInFlight - InFlightRequests.Num() - NumRunningStages, 0, NumCandidates);
 }
 
-bool UFGVoxelGrid::IsChunkGenerated(FIntVector ChunkCoordinate)
+void UFGVoxelGrid::RecordChunkStageCost(EFGChunkStage Stage, double Seconds)
 {
-	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+	checkf(IsInGameThread(), TEXT("Chunk stage costs can only be recorded on the game thread!"));
 
-	FFGChunkHandle ChunkHandle = FindChunk(ChunkCoordinate);
-	if(ChunkHandle.IsValid())
-	{
-		return ChunkHandle->Generated;
-		//return GetChunkDataUnsafe(ChunkHandle)->HasAnyFlags(EFGChunkFlags::Generated);
-	}
-	return false;
-}
+	// Rolling average, responsive enough to follow load changes without jumping on every outlier.
+	constexpr double Smoothing = 0.05;
 
-// @TODO: Maybe use a future / promise here instead of a mutex.
-FFGVoxelChunk* UFGVoxelGrid::GetChunkDataSafe(int32 ChunkDataIndex)
-{
-	checkf(InternalChunkData.IsValidIndex(ChunkDataIndex), TEXT("Invalid chunk data index!"));
-	FFGVoxelChunk* ChunkDataPtr = InternalChunkData.GetData() + ChunkDataIndex;
-	//UE::TScopeLock Lock(ChunkDataPtr->ChunkLocked);
-	return ChunkDataPtr;
-}
+	const int32 StageIndex = (int32)Stage;
+	const double Milliseconds = Seconds * 1000.0;
 
-// @TODO: Maybe use a future / promise here instead of a mutex.
-FFGVoxelChunk* UFGVoxelGrid::GetChunkDataSafe(FFGChunkHandle ChunkHandle)
-{
-	checkf(InternalChunkData.IsValidIndex(ChunkHandle->ChunkDataIndex), TEXT("Invalid chunk data index!"));
-	FFGVoxelChunk* ChunkDataPtr = InternalChunkData.GetData() + ChunkHandle->ChunkDataIndex;
-    //UE::TScopeLock Lock(ChunkDataPtr->ChunkLocked);
-    return ChunkDataPtr;
-}
+	StageCostMs[StageIndex] = StageCostSampled[StageIndex]
+		? FMath::Lerp(StageCostMs[StageIndex], Milliseconds, Smoothing)
+		: Milliseconds;
 
-FFGVoxelChunk* UFGVoxelGrid::GetChunkDataUnsafe(int32 ChunkDataIndex)
-{
-	checkf(InternalChunkData.IsValidIndex(ChunkDataIndex), TEXT("Invalid chunk data index!"));
-	return InternalChunkData.GetData() + ChunkDataIndex;
+	StageCostSampled[StageIndex] = true;
 }
 
-FFGVoxelChunk* UFGVoxelGrid::GetChunkDataUnsafe(FFGChunkHandle ChunkHandle)
+void UFGVoxelGrid::CompleteChunkRequest(const FFGChunkLoadRequest& Request)
 {
-	checkf(InternalChunkData.IsValidIndex(ChunkHandle->ChunkDataIndex), TEXT("Invalid chunk data index!"));
-	return InternalChunkData.GetData() + ChunkHandle->ChunkDataIndex;
+	// The worker is done with the chunk, only from here can the game thread see it.
+	FinishGeneratedChunk(*Request.ChunkHandle);
+
+	FG::TraceChunkStage(Request.ChunkHandle->ChunkCoordinate, EFGChunkTraceStage::Loaded);
+	ChunkIndex.SetGenerated(FFGChunkKey(Request.ChunkHandle->ChunkCoordinate));
+
+	if(Request.ChunkHandle->ChunkData->HasAnyFlags(EFGChunkFlags::Edited)) // The generator's surface may be wrong here.
+	{
+		RefreshColumnSummary(*Request.ChunkHandle);
+	}
+
+	for(const TWeakPtr<FFGVoxelLoadHandleData>& LoadHandleWeak : Request.LoadHandles)
+	{
+		if(FFGVoxelLoadHandle LoadHandle = LoadHandleWeak.Pin())
+		{
+			FinishChunkLoad(LoadHandle, Request.ChunkHandle);
+		}
+	}
 }
 
-void UFGVoxelGrid::GenerateChunk(FFGChunkHandle ChunkHandle)
+void UFGVoxelGrid::FinishTerrainStage(FFGChunkLoadRequest&& Request, bool NeedsStages)
 {
-	checkf(WorldGenerator.IsSet(), TEXT("Generation called without valid generator!"));
-	GetGenerator()->Generate(InternalChunkData, ChunkHandle);
-	//GetChunkDataUnsafe(ChunkHandle)->SetFlags(EFGChunkFlags::Generated);
-	ChunkHandle->Generated = true;
+	if(!NeedsStages)
+	{
+		Request.ChunkHandle->NextStage = EFGGenerationStage::Num;
+		CompleteChunkRequest(Request);
+		return;
+	}
+
+	Request.ChunkHandle->NextStage = GetGenerator()->GetNextStage(EFGGenerationStage::Terrain);
+	StagedChunks.Add(FFGChunkKey(Request.ChunkHandle->ChunkCoordinate), MoveTemp(Request));
 }
 
-FFGChunkHandle UFGVoxelGrid::ConstructChunkHandle(FIntVector ChunkCoordinate)
+void UFGVoxelGrid::TickGenerationStages()
 {
-	TWeakObjectPtr<UFGVoxelGrid> GridWeak = MakeWeakObjectPtr(this);
-	auto ChunkHandleDeleter = [GridWeak](void* ObjectToDelete)
+	CSV_SCOPED_TIMING_STAT(FGVoxel, TickGenerationStages);
+
+	TArray<FG::Private::FChunkLoadCandidate> Candidates;
+
+	for(TMap<FFGChunkKey, FFGChunkLoadRequest>::TIterator It = StagedChunks.CreateIterator(); It; ++It)
 	{
-		FFGChunkHandleData* ChunkData = reinterpret_cast<FFGChunkHandleData*>(ObjectToDelete);
-		
-		if(GridWeak.IsValid())
+		FFGChunkLoadRequest& Request = It.Value();
+		FFGChunkHandleData& ChunkHandle = *Request.ChunkHandle;
+
+		if(ChunkHandle.StageRunning)
 		{
-			GridWeak->ActiveChunkHandles.Remove(ChunkData->ChunkCoordinate);
-            GridWeak->InternalGarbageChunks.Push(ChunkData->ChunkCoordinate);
-            GridWeak->InternalChunkFreelist.Push(ChunkData->ChunkDataIndex);
+			continue;
 		}
 
-		FMemory::Free(ObjectToDelete);
-	};
+		Request.LoadHandles.RemoveAllSwap([](const TWeakPtr<FFGVoxelLoadHandleData>& LoadHandle)
+		{
+			return !LoadHandle.IsValid();
+		});
 
-	FFGChunkHandle OutChunkHandle = MakeShareable(new FFGChunkHandleData(), MoveTemp(ChunkHandleDeleter));
-	ActiveChunkHandles.Add(ChunkCoordinate, OutChunkHandle);
-	return OutChunkHandle;
+		// Nobody wants it anymore, and nobody is reading it, it unloads without ever being complete.
+		if(Request.LoadHandles.IsEmpty() && Request.NumDependents == 0 && ChunkHandle.StageReaders == 0)
+		{
+			ReleaseStageDependencies(Request);
+			It.RemoveCurrent();
+			continue;
+		}
+
+		// Only wanted as a neighbour, and already as far along as it's dependents need.
+		if(ChunkHandle.NextStage > Request.TargetStage)
+		{
+			continue;
+		}
+
+		// Always ask for the neighbours, even if this chunk is locked, so they're on their way.
+		if(RequestStageDependencies(Request) && ChunkHandle.StageReaders == 0)
+		{
+			Candidates.Add({ GetViewerPriority(ChunkHandle.ChunkCoordinate), Request.Sequence, It.Key() });
+		}
+	}
+
+	if(Candidates.IsEmpty())
+	{
+		return;
+	}
+
+	Algo::Sort(Candidates);
+
+	// Stages share the generation budget with Terrain, closest chunks first.
+	int32 Budget = FG::VoxelImmediateMode ? Candidates.Num() : GetGenerationAdmission(Candidates.Num());
+
+	for(const FG::Private::FChunkLoadCandidate& Candidate : Candidates)
+	{
+		if(Budget <= 0)
+		{
+			break;
+		}
+
+		// A stage started earlier in the loop may have locked this one or it's neighbours since.
+		FFGChunkLoadRequest* Request = StagedChunks.Find(Candidate.ChunkKey);
+		if(!Request || Request->ChunkHandle->StageRunning || Request->ChunkHandle->StageReaders > 0 || !RequestStageDependencies(*Request))
+		{
+			continue;
+		}
+
+		RunGenerationStage(Candidate.ChunkKey, *Request);
+		Budget--;
+	}
+}
+
+bool UFGVoxelGrid::RequestStageDependencies(FFGChunkLoadRequest& Request)
+{
+	const FIntVector ChunkCoordinate = Request.ChunkHandle->ChunkCoordinate;
+	const EFGGenerationStage Stage = Request.ChunkHandle->NextStage;
+	const int32 Radius = GetGenerator()->GetStageNeighbourRadius(Stage);
+	checkf(Radius >= 0, TEXT("Chunk is waiting on a stage the generator doesn't use!"));
+
+	// Neighbours have to be through the stage before, like the chunk itself.
+	const EFGGenerationStage NeededStage = (EFGGenerationStage)((int32)Stage - 1);
+	bool Ready = true;
+
+	for(int32 Z = -Radius; Z <= Radius; Z++)
+	{
+		for(int32 Y = -Radius; Y <= Radius; Y++)
+		{
+			for(int32 X = -Radius; X <= Radius; X++)
+			{
+				if(X == 0 && Y == 0 && Z == 0)
+				{
+					continue;
+				}
+
+				const FIntVector NeighbourCoordinate = ChunkCoordinate + FIntVector(X, Y, Z);
+				FFGChunkHandle Neighbour = FindChunk(NeighbourCoordinate);
+
+				if(!Neighbour.IsValid() || Neighbour->NextStage <= NeededStage)
+				{
+					// Missing or behind, make sure it's on it's way and going at least as far as we need.
+					Neighbour = RequestChunk(nullptr, NeighbourCoordinate, NeededStage);
+				}
+
+				if(!Request.Dependencies.Contains(Neighbour))
+				{
+					if(FFGChunkLoadRequest* NeighbourRequest = FindGenerationRequest(FFGChunkKey(NeighbourCoordinate)))
+					{
+						NeighbourRequest->NumDependents++;
+					}
+					Request.Dependencies.Add(Neighbour);
+				}
+
+				Ready &= Neighbour->NextStage > NeededStage && !Neighbour->StageRunning;
+			}
+		}
+	}
+
+	return Ready;
+}
+
+void UFGVoxelGrid::RunGenerationStage(FFGChunkKey ChunkKey, FFGChunkLoadRequest& Request)
+{
+	const FFGChunkHandle& ChunkHandle = Request.ChunkHandle;
+	const EFGGenerationStage Stage = ChunkHandle->NextStage;
+
+	FFGGenerationRegion Region;
+	Region.ChunkCoordinate = ChunkHandle->ChunkCoordinate;
+	Region.Radius = GetGenerator()->GetStageNeighbourRadius(Stage);
+
+	const int32 RegionSize = Region.Radius * 2 + 1;
+	Region.Chunks.SetNumZeroed(RegionSize * RegionSize * RegionSize);
+
+	// Lock the neighbours for reading, RequestStageDependencies has made sure they're all there.
+	for(int32 Z = -Region.Radius; Z <= Region.Radius; Z++)
+	{
+		for(int32 Y = -Region.Radius; Y <= Region.Radius; Y++)
+		{
+			for(int32 X = -Region.Radius; X <= Region.Radius; X++)
+			{
+				const FIntVector Offset(X, Y, Z);
+				if(Offset == FIntVector::ZeroValue)
+				{
+					Region.Chunks[Region.GetChunkIndex(Offset)] = ChunkHandle->ChunkData;
+					continue;
+				}
+
+				FFGChunkHandle Neighbour = FindChunkChecked(Region.ChunkCoordinate + Offset);
+				Neighbour->StageReaders++;
+				Region.Chunks[Region.GetChunkIndex(Offset)] = Neighbour->ChunkData;
+				Request.StageReads.Add(MoveTemp(Neighbour));
+			}
+		}
+	}
+
+	ChunkHandle->StageRunning = true;
+	NumRunningStages++;
+
+	const bool LastStage = GetGenerator()->GetNextStage(Stage) == EFGGenerationStage::Num;
+
+	if(FG::VoxelImmediateMode)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		GenerateChunkStage(ChunkHandle, Stage, Region, LastStage);
+		RecordChunkStageCost(EFGChunkStage::Generation, FPlatformTime::Seconds() - StartTime);
+
+		FinishGenerationStage(ChunkKey);
+		return;
+	}
+
+	Request.GenerationTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, ChunkKey, ChunkHandle = ChunkHandle, Stage, Region = MoveTemp(Region), LastStage]() mutable
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		GenerateChunkStage(ChunkHandle, Stage, Region, LastStage);
+
+		// Handed back rather than dropped, see FFGCompletedChunk::ChunkHandle.
+		CompletedChunks.Enqueue({ ChunkKey, MoveTemp(ChunkHandle), FPlatformTime::Seconds() - StartTime });
+		NumCompletedChunks.fetch_add(1, std::memory_order_relaxed);
+	});
+}
+
+void UFGVoxelGrid::FinishGenerationStage(FFGChunkKey ChunkKey)
+{
+	FFGChunkLoadRequest& Request = StagedChunks.FindChecked(ChunkKey);
+	FFGChunkHandleData& ChunkHandle = *Request.ChunkHandle;
+
+	ChunkHandle.StageRunning = false;
+	NumRunningStages--;
+
+	TArray<FFGChunkHandle, TInlineAllocator<26>> Released;
+	for(FFGChunkHandle& Neighbour : Request.StageReads)
+	{
+		if(--Neighbour->StageReaders == 0)
+		{
+			Released.Add(MoveTemp(Neighbour));
+		}
+	}
+	Request.StageReads.Reset();
+
+	ChunkHandle.NextStage = GetGenerator()->GetNextStage(ChunkHandle.NextStage);
+
+	if(ChunkHandle.NextStage == EFGGenerationStage::Num)
+	{
+		FFGChunkLoadRequest Finished = StagedChunks.FindAndRemoveChecked(ChunkKey);
+		ReleaseStageDependencies(Finished);
+		CompleteChunkRequest(Finished);
+	}
+
+	// Last, listeners write to the chunks and we're done with the request.
+	for(const FFGChunkHandle& Neighbour : Released)
+	{
+		OnStageReadsReleased.Broadcast(Neighbour);
+	}
+}
+
+void UFGVoxelGrid::ReleaseStageDependencies(FFGChunkLoadRequest& Request)
+{
+	for(const FFGChunkHandle& Dependency : Request.Dependencies)
+	{
+		// Neighbours that finished since have no request left to count us in.
+		if(FFGChunkLoadRequest* DependencyRequest = FindGenerationRequest(FFGChunkKey(Dependency->ChunkCoordinate)))
+		{
+			DependencyRequest->NumDependents--;
+		}
+	}
+	Request.Dependencies.Empty();
+}
+
+void UFGVoxelGrid::WaitForGeneration()
+{
+	for(TPair<FFGChunkKey, FFGChunkLoadRequest>& InFlight : InFlightRequests)
+	{
+		InFlight.Value.GenerationTask.Wait();
+	}
+
+	for(TPair<FFGChunkKey, FFGChunkLoadRequest>& Staged : StagedChunks)
+	{
+		if(Staged.Value.ChunkHandle->StageRunning)
+		{
+			Staged.Value.GenerationTask.Wait();
+		}
+	}
+}
+
+void UFGVoxelGrid::GatherViewers()
+{
+	ViewerCoordinates.Reset();
+
+	// Local camera, covers the editor viewport too. Identity on dedicated servers.
+	if(GetWorld()->GetNetMode() != NM_DedicatedServer)
+	{
+		ViewerCoordinates.Add(UFGVoxelUtils::VectorToChunkCoord(UFGUtils::GetCameraViewTransform(GetWorld()).GetLocation()));
+	}
+
+	// Every player we know about, so the server streams around remote players too.
+	for(FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if(const APawn* Pawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			ViewerCoordinates.AddUnique(UFGVoxelUtils::VectorToChunkCoord(Pawn->GetActorLocation()));
+		}
+	}
+}
+
+FFGChunkLoadRequest* UFGVoxelGrid::FindGenerationRequest(FFGChunkKey ChunkKey)
+{
+	FFGChunkLoadRequest* Request = PendingRequests.Find(ChunkKey);
+	if(!Request)
+	{
+		Request = InFlightRequests.Find(ChunkKey);
+	}
+	if(!Request)
+	{
+		Request = StagedChunks.Find(ChunkKey);
+	}
+	return Request;
+}
+
+double UFGVoxelGrid::GetViewerPriority(FIntVector ChunkCoordinate) const
+{
+	double Priority = ViewerCoordinates.IsEmpty() ? 0.0 : UE_DOUBLE_BIG_NUMBER;
+
+	for(const FIntVector& ViewerCoordinate : ViewerCoordinates)
+	{
+		Priority = FMath::Min(Priority, (double)(ChunkCoordinate - ViewerCoordinate).SizeSquared());
+	}
+	return Priority;
+}
+
+FFGChunkHandle UFGVoxelGrid::RequestChunk(const FFGVoxelLoadHandle& LoadHandle, FIntVector ChunkCoordinate, EFGGenerationStage TargetStage)
+{
+	checkf(IsInGameThread(), TEXT("Chunks can only be requested on the game thread!"));
+
+	const FFGChunkKey ChunkKey(ChunkCoordinate);
+
+	if(FFGChunkLoadRequest* PendingRequest = FindGenerationRequest(ChunkKey)) // Already on it's way, merge.
+	{
+		if(LoadHandle.IsValid())
+		{
+			PendingRequest->LoadHandles.Add(LoadHandle);
+		}
+		PendingRequest->TargetStage = FMath::Max(PendingRequest->TargetStage, TargetStage);
+		return PendingRequest->ChunkHandle;
+	}
+
+	FFGChunkHandle ChunkHandle = FindChunk(ChunkCoordinate);
+
+	if(ChunkHandle.IsValid() && ChunkHandle->Generated) // Already loaded, complete next tick.
+	{
+		if(LoadHandle.IsValid())
+		{
+			ReadyChunks.Emplace(LoadHandle, ChunkHandle);
+		}
+		return ChunkHandle;
+	}
+
+	if(!ChunkHandle.IsValid())
+	{
+		FG::TraceChunkStage(ChunkCoordinate, EFGChunkTraceStage::Requested);
+		ChunkHandle = ConstructChunkHandle(ChunkCoordinate);
+
+		int32 CachedIndex;
+		TArray<uint8> ColdBytes;
+		bool CacheHit = false;
+
+		if(ChunkCache.TakeResident(ChunkKey, CachedIndex)) // Still resident, just hand the slot back.
+		{
+			BindChunkSlot(ChunkHandle, CachedIndex);
+			CacheHit = true;
+		}
+		else if(ChunkCache.TakeCold(ChunkKey, ColdBytes)) // Cold, decompress into a fresh slot.
+		{
+			AssignChunkSlot(ChunkHandle);
+			CacheHit = ChunkHandle->ChunkData->Decompress(ColdBytes);
+		}
+		else
+		{
+			AssignChunkSlot(ChunkHandle);
+		}
+
+		if(CacheHit) // No generation needed, complete next tick like any other loaded chunk.
+		{
+			FG::TraceChunkStage(ChunkCoordinate, EFGChunkTraceStage::Loaded);
+			ChunkHandle->Generated = true;
+			ChunkHandle->NextStage = EFGGenerationStage::Num;
+			ChunkIndex.SetGenerated(ChunkKey);
+			if(LoadHandle.IsValid())
+			{
+				ReadyChunks.Emplace(LoadHandle, ChunkHandle);
+			}
+
+			if(ChunkHandle->ChunkData->HasAnyFlags(EFGChunkFlags::Edited)) // Our summary may have been trimmed since.
+			{
+				RefreshColumnSummary(*ChunkHandle);
+			}
+			return ChunkHandle;
+		}
+
+		ChunkCache.RecordMiss();
+
+		// Nothing saved could be hiding up here without persistence, so it's air and needs no worker.
+		if(!RegionStore.IsValid() && FG::SkipAirChunks && IsChunkAboveSurface(ChunkCoordinate))
+		{
+			FG::TraceChunkStage(ChunkCoordinate, EFGChunkTraceStage::Loaded);
+			ChunkHandle->ChunkData->Reset();
+			ChunkHandle->Generated = true;
+			ChunkHandle->NextStage = EFGGenerationStage::Num;
+			ChunkIndex.SetGenerated(ChunkKey);
+			if(LoadHandle.IsValid())
+			{
+				ReadyChunks.Emplace(LoadHandle, ChunkHandle);
+			}
+			return ChunkHandle;
+		}
+	}
+
+	FFGChunkLoadRequest& Request = PendingRequests.Add(ChunkKey);
+	Request.ChunkHandle = ChunkHandle;
+	if(LoadHandle.IsValid())
+	{
+		Request.LoadHandles.Add(LoadHandle);
+	}
+	Request.Sequence = NextRequestSequence++;
+	Request.TargetStage = TargetStage;
+	ChunkHandle->NextStage = EFGGenerationStage::Terrain; // A handle left part way up the ladder starts again.
+	return ChunkHandle;
+}
+
+void UFGVoxelGrid::FinishChunkLoad(const FFGVoxelLoadHandle& LoadHandle, const FFGChunkHandle& ChunkHandle)
+{
+	LoadHandle->LoadCount += 1;
+	LoadHandle->OnFinishedLoadingChunk.Broadcast(ChunkHandle);
+
+	if(LoadHandle->GetLoadCount() == LoadHandle->GetBatchSize())
+	{
+		LoadHandle->OnFinishedLoadingBatch.Broadcast(MoveTemp(LoadHandle->ChunkHandles));
+	}
+}
+
+void UFGVoxelGrid::SetGeneratorType(TSubclassOf<UFGVoxelGenerator> GeneratorType)
+{
+	// Saves queued by the flush may be deltas, which have to be taken against the old generator.
+	FlushAllChunks();
+	if(RegionStore.IsValid())
+	{
+		RegionStore->Flush();
+	}
+
+	WorldGenerator = NewObject<UFGVoxelGenerator>(this, GeneratorType);
+	if(!GVoxelTypeMap.IsEmpty()) // Otherwise the voxel system resolves them once it's enumerated them.
+	{
+		GetGenerator()->ResolveVoxelTypes();
+	}
+	ColumnSummaries.Empty(); // Predicted by the old generator.
+	UpdatePersistence();
+}
+
+void UFGVoxelGrid::UpdatePersistence()
+{
+	if(!FG::VoxelPersistence)
+	{
+		EditJournal.Reset();
+		RegionStore.Reset();
+	}
+	else if(!RegionStore.IsValid() && GetWorld() && GetWorld()->IsGameWorld())
+	{
+		const FString Directory = FPaths::ProjectSavedDir() / TEXT("Voxel") / GetWorld()->GetName();
+		RegionStore = MakeUnique<FFGRegionStore>(Directory);
+		EditJournal = MakeUnique<FFGEditJournal>(Directory); // Reads back edits from a previous run.
+	}
+
+	if(RegionStore.IsValid() && HasGenerator())
+	{
+		// Deltas are against Terrain alone, which needs no neighbours to rebuild. Anything later stages
+		// wrote is saved as changed voxels, like an edit.
+		const uint32 BaselineId = GetGenerator()->GetBaselineId();
+
+		// Must build exactly what GenerateChunk would, or deltas will apply to the wrong voxels.
+		RegionStore->SetBaseline(BaselineId, [this](FIntVector ChunkCoordinate, FFGVoxelChunk& OutChunk)
+		{
+			FFGChunkHandle BaselineHandle = MakeShared<FFGChunkHandleData>();
+			BaselineHandle->ChunkCoordinate = ChunkCoordinate;
+			BaselineHandle->ChunkData = &OutChunk;
+
+			GetGenerator()->Generate(OutChunk, BaselineHandle);
+			OutChunk.ShrinkPalette();
+		});
+	}
+}
+
+void UFGVoxelGrid::SaveModifiedChunks(bool WaitForWrites)
+{
+	checkf(IsInGameThread(), TEXT("Chunks can only be saved on the game thread!"));
+
+	for(const TWeakPtr<FFGChunkHandleData>& SlotHandle : SlotHandles)
+	{
+		if(FFGChunkHandle ChunkHandle = SlotHandle.Pin(); ChunkHandle.IsValid() && ChunkHandle->Generated)
+		{
+			SaveChunkIfModified(ChunkHandle->ChunkCoordinate, *ChunkHandle->ChunkData);
+		}
+	}
+
+	if(WaitForWrites && RegionStore.IsValid())
+	{
+		RegionStore->Flush();
+	}
+}
+
+void UFGVoxelGrid::RecordVoxelEdit(FIntVector ChunkCoordinate, int32 VoxelIndex, uint32 OldType, uint32 NewType)
+{
+	FFGChunkHandle ChunkHandle = FindChunk(ChunkCoordinate);
+	if(ChunkHandle.IsValid())
+	{
+		ChunkHandle->ChunkData->SetFlags(EFGChunkFlags::Edited);
+
+		const bool WasSolid = OldType != VOXELTYPE_NONE;
+		const bool IsSolid = NewType != VOXELTYPE_NONE;
+
+		FFGColumnSummary* Summary = WasSolid != IsSolid ? FindOrAddColumnSummary(FIntVector2(ChunkCoordinate.X, ChunkCoordinate.Y)) : nullptr;
+		if(Summary && ChunkHandle->Generated)
+		{
+			FIntVector VoxelCoordinate;
+			UFGVoxelUtils::UnflattenVoxelCoordFast(VoxelIndex, VoxelCoordinate);
+			RefreshSurfaceVoxel(*Summary, *ChunkHandle, VoxelCoordinate.X, VoxelCoordinate.Y);
+		}
+	}
+
+	if(EditJournal.IsValid())
+	{
+		EditJournal->Append(ChunkCoordinate, VoxelIndex, OldType, NewType);
+	}
+}
+
+void UFGVoxelGrid::TickEditJournal(float DeltaTime)
+{
+	if(!EditJournal.IsValid())
+	{
+		return;
+	}
+
+	JournalFlushTimer += DeltaTime;
+	JournalCheckpointTimer += DeltaTime;
+
+	// The size check would keep firing while the last checkpoint waits on region writes.
+	const bool CheckpointDue = !EditJournal->IsCheckpointing()
+		&& (JournalCheckpointTimer >= FG::JournalCheckpointInterval
+		|| EditJournal->GetFileSize() > (int64)FG::JournalCheckpointMB * 1024 * 1024);
+
+	if(CheckpointDue && (EditJournal->GetFileSize() > 0 || EditJournal->GetNumPendingEdits() > 0))
+	{
+		CheckpointEditJournal();
+	}
+	else if(JournalFlushTimer * 1000.0f >= FG::JournalFlushIntervalMs)
+	{
+		EditJournal->FlushAsync();
+		JournalFlushTimer = 0.0f;
+	}
+}
+
+void UFGVoxelGrid::CheckpointEditJournal()
+{
+	// The checkpoint assumes every edit so far is in a queued save, so this has to come first.
+	SaveModifiedChunks(false);
+	EditJournal->Checkpoint(*RegionStore);
+
+	JournalFlushTimer = 0.0f;
+	JournalCheckpointTimer = 0.0f;
+}
+
+void UFGVoxelGrid::SaveChunkIfModified(FIntVector ChunkCoordinate, FFGVoxelChunk& ChunkData)
+{
+	if(RegionStore.IsValid() && ChunkData.HasAnyFlags(EFGChunkFlags::Modified))
+	{
+		RegionStore->SaveChunk(ChunkCoordinate, ChunkData);
+		ChunkData.ClearFlags(EFGChunkFlags::Modified);
+
+		if(EditJournal.IsValid())
+		{
+			EditJournal->MarkSaved(ChunkCoordinate);
+		}
+	}
+}
+
+FFGVoxelLoadHandle UFGVoxelGrid::LoadChunkAsync(FIntVector ChunkCoordinate)
+{
+	DECLARE_CYCLE_STAT(TEXT("FGameThreadVoxelTask.LoadChunkAsync"), STAT_VoxelLoadChunkAsync, STATGROUP_TaskGraphTasks);
+
+	FFGVoxelLoadHandle LoadHandle = MakeShared<FFGVoxelLoadHandleData, ESPMode::ThreadSafe>(FFGVoxelLoadHandleData());
+	
+	UFGVoxelUtils::RunCommandOnGameThread(this, [this, ChunkCoordinate, LoadHandle]()
+	{
+		FFGChunkHandle ChunkHandle = RequestChunk(LoadHandle, ChunkCoordinate);
+
+		TSharedRef<FFGVoxelLoadHandleData> HandleDataRef = LoadHandle.ToSharedRef();
+		FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchSize, 1);
+		
+		// @TODO: These arrays aren't safe to read on other threads while we are writing, need a mutex.
+		HandleDataRef->ChunkCoordinates.Add(ChunkCoordinate);
+		HandleDataRef->ChunkHandles.Add(ChunkHandle);
+		
+	}, GET_STATID(STAT_VoxelLoadChunkAsync));
+	
+	return LoadHandle;
+}
+
+FFGVoxelLoadHandle UFGVoxelGrid::LoadChunkBatchAsync(TArray<FIntVector> ChunkCoordinates)
+{
+	DECLARE_CYCLE_STAT(TEXT("FGameThreadVoxelTask.LoadChunkBatchAsync"), STAT_VoxelLoadChunkBatchAsync, STATGROUP_TaskGraphTasks);
+
+	FFGVoxelLoadHandle LoadHandle = MakeShared<FFGVoxelLoadHandleData, ESPMode::ThreadSafe>(FFGVoxelLoadHandleData());
+	
+	UFGVoxelUtils::RunCommandOnGameThread(this, [this, ChunkCoordinates, LoadHandle]() {
+
+		TArray<FFGChunkHandle> ChunkHandles;
+		ChunkHandles.Reserve(ChunkCoordinates.Num());
+
+		for(int32 Chunk = 0; Chunk < ChunkCoordinates.Num(); Chunk++)
+		{
+			ChunkHandles.Add(RequestChunk(LoadHandle, ChunkCoordinates[Chunk]));
+		}
+
+		TSharedRef<FFGVoxelLoadHandleData> HandleDataRef = LoadHandle.ToSharedRef();
+		FPlatformAtomics::InterlockedExchange(&HandleDataRef->BatchSize, ChunkCoordinates.Num());
+
+		// @TODO: These arrays aren't safe to read on other threads while we are writing, need a mutex.
+		HandleDataRef->ChunkCoordinates = ChunkCoordinates;
+		HandleDataRef->ChunkHandles = ChunkHandles;
+		
+	}, GET_STATID(STAT_VoxelLoadChunkBatchAsync));
+	
+	return LoadHandle;
+}
+
+void UFGVoxelGrid::FlushAllChunks()
+{
+	WaitForGeneration();
+	SaveModifiedChunks(false); // Edits outlive the flush, they'll load back from disk.
+	while(CompletedChunks.Dequeue()) {}
+	NumCompletedChunks = 0;
+	InFlightRequests.Empty();
+	PendingRequests.Empty();
+	StagedChunks.Empty();
+	NumRunningStages = 0;
+	ChunkCache.Empty();
+	ReadyChunks.Empty();
+	ColumnSummaries.Empty();
+
+	FPlatformAtomics::InterlockedExchange(&InternalChunkCount, 0);
+	ChunkIndex.Empty(); // Waits out any readers before the chunk storage goes away.
+	ActiveChunkSlots.Empty();
+	SlotHandles.Empty();
+	InternalChunkData.Empty();
+	InternalGarbageChunks.Empty();
+	InternalChunkFreelist.Empty();
+}
+
+FFGChunkHandle UFGVoxelGrid::FindChunk(FIntVector ChunkCoordinate)
+{
+	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+	if(const int32* ChunkSlot = ActiveChunkSlots.Find(FFGChunkKey(ChunkCoordinate)))
+	{
+		return SlotHandles[*ChunkSlot].Pin();
+	}
+	return FFGChunkHandle();
+}
+
+FFGChunkHandle UFGVoxelGrid::FindChunkChecked(FIntVector ChunkCoordinate)
+{
+	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+
+	const int32* ChunkSlot = ActiveChunkSlots.Find(FFGChunkKey(ChunkCoordinate));
+	checkf(ChunkSlot, TEXT("Chunk %s is not loaded!"), *ChunkCoordinate.ToString());
+
+	FFGChunkHandle ChunkHandle = SlotHandles[*ChunkSlot].Pin();
+	checkf(ChunkHandle.IsValid(), TEXT("Invalid chunk handle!"));
+	return ChunkHandle;
+}
+
+FFGChunkHandle UFGVoxelGrid::FindGeneratedChunk(FIntVector ChunkCoordinate)
+{
+	FFGChunkHandle ChunkHandle = FindChunk(ChunkCoordinate);
+	if(ChunkHandle.IsValid() && ChunkHandle->Generated)
+	{
+		return ChunkHandle;
+	}
+	return FFGChunkHandle();
+}
+
+bool UFGVoxelGrid::IsChunkGenerated(FIntVector ChunkCoordinate)
+{
+	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+
+	FFGChunkHandle ChunkHandle = FindChunk(ChunkCoordinate);
+	if(ChunkHandle.IsValid())
+	{
+		return ChunkHandle->Generated;
+		//return GetChunkDataUnsafe(ChunkHandle)->HasAnyFlags(EFGChunkFlags::Generated);
+	}
+	return false;
+}
+
+FFGChunkNeighbourhood UFGVoxelGrid::GetChunkNeighbourhood(const FFGChunkHandle& ChunkHandle)
+{
+	checkf(IsInGameThread(), TEXT("Attempted to find chunks on non-game thread!"));
+	checkf(ChunkHandle.IsValid(), TEXT("Invalid chunk handle!"));
+
+	FFGChunkNeighbourhood Neighbourhood;
+	auto Cell = [&Neighbourhood](int32 X, int32 Y, int32 Z) -> FFGChunkHandleData*&
+	{
+		return Neighbourhood.Chunks[(X + 1) + (Y + 1) * 3 + (Z + 1) * 9];
+	};
+
+	// Step across one face from a chunk we already have, if we have it.
+	auto Step = [](const FFGChunkHandleData* From, int32 Axis, int32 Sign) -> FFGChunkHandleData*
+	{
+		return From ? From->GetNeighbour((EFGChunkFace)(Axis * 2 + (Sign < 0))) : nullptr;
+	};
+
+	Cell(0, 0, 0) = ChunkHandle.Get();
+
+	// Faces step off the centre, edges off the faces either side of them and corners off the edges.
+	for(int32 NumAxes = 1; NumAxes <= 3; NumAxes++)
+	{
+		for(int32 Z = -1; Z <= 1; Z++)
+		{
+			for(int32 Y = -1; Y <= 1; Y++)
+			{
+				for(int32 X = -1; X <= 1; X++)
+				{
+					if((X != 0) + (Y != 0) + (Z != 0) != NumAxes)
+					{
+						continue;
+					}
+
+					FFGChunkHandleData* Chunk = X != 0 ? Step(Cell(0, Y, Z), 0, X) : nullptr;
+					Chunk = !Chunk && Y != 0 ? Step(Cell(X, 0, Z), 1, Y) : Chunk;
+					Chunk = !Chunk && Z != 0 ? Step(Cell(X, Y, 0), 2, Z) : Chunk;
+
+					// Every chunk we could have stepped from is unloaded, it may still be there though.
+					if(!Chunk && NumAxes > 1)
+					{
+						const int32* ChunkSlot = ActiveChunkSlots.Find(FFGChunkKey(ChunkHandle->ChunkCoordinate + FIntVector(X, Y, Z)));
+						Chunk = ChunkSlot ? SlotHandles[*ChunkSlot].Pin().Get() : nullptr;
+					}
+					Cell(X, Y, Z) = Chunk;
+				}
+			}
+		}
+	}
+
+	return Neighbourhood;
+}
+
+bool UFGVoxelGrid::GetSurfaceVoxelZ(FIntVector2 VoxelXY, int32& OutVoxelZ)
+{
+	checkf(IsInGameThread(), TEXT("Column summaries are game thread only!"));
+
+	// Shifts and masks floor, so negative coordinates land in the right column.
+	constexpr int32 ChunkShift = FMath::ConstExprCeilLogTwo(ChunkSizeX);
+	static_assert(1 << ChunkShift == ChunkSizeX, "Chunk size must be a power of two to shift and mask by it!");
+
+	const FIntVector2 ChunkColumn(VoxelXY.X >> ChunkShift, VoxelXY.Y >> ChunkShift);
+	const FFGColumnSummary* Summary = FindOrAddColumnSummary(ChunkColumn);
+	if(!Summary)
+	{
+		return false;
+	}
+
+	const int32 TopVoxelZ = Summary->TopVoxelZ[UFGVoxelUtils::FlattenVoxelCoord2D(FIntVector2(VoxelXY.X & (ChunkSizeX - 1), VoxelXY.Y & (ChunkSizeX - 1)))];
+	if(TopVoxelZ == FFGColumnSummary::NoSurface)
+	{
+		return false;
+	}
+
+	OutVoxelZ = TopVoxelZ;
+	return true;
+}
+
+bool UFGVoxelGrid::IsChunkAboveSurface(FIntVector ChunkCoordinate)
+{
+	FFGColumnSummary* Summary = FindOrAddColumnSummary(FIntVector2(ChunkCoordinate.X, ChunkCoordinate.Y));
+	if(!Summary)
+	{
+		return false;
+	}
+
+	if(Summary->MaxTopDirty)
+	{
+		Summary->MaxTopVoxelZ = FFGColumnSummary::NoSurface;
+		for(const int16 TopVoxelZ : Summary->TopVoxelZ)
+		{
+			Summary->MaxTopVoxelZ = FMath::Max(Summary->MaxTopVoxelZ, TopVoxelZ);
+		}
+		Summary->MaxTopDirty = false;
+	}
+
+	return ChunkCoordinate.Z * ChunkSizeX > Summary->MaxTopVoxelZ;
+}
+
+FFGColumnSummary* UFGVoxelGrid::FindOrAddColumnSummary(FIntVector2 ChunkColumn)
+{
+	checkf(IsInGameThread(), TEXT("Column summaries are game thread only!"));
+
+	if(TUniquePtr<FFGColumnSummary>* Summary = ColumnSummaries.Find(ChunkColumn))
+	{
+		return Summary->Get();
+	}
+
+	if(!WorldGenerator.IsSet())
+	{
+		return nullptr;
+	}
+
+	TStaticArray<int32, ChunkSizeXY> Heights;
+	if(!GetGenerator()->GenerateColumnHeights(ChunkColumn, Heights))
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<FFGColumnSummary> Summary = MakeUnique<FFGColumnSummary>();
+	Summary->GeneratedMinZ = MAX_int16;
+
+	for(int32 Column = 0; Column < ChunkSizeXY; Column++)
+	{
+		// Worlds never get near the int16 range, but clamp rather than wrap if one does.
+		const int16 TopVoxelZ = Heights[Column] == MIN_int32
+			? FFGColumnSummary::NoSurface
+			: (int16)FMath::Clamp<int32>(Heights[Column], FFGColumnSummary::NoSurface + 1, MAX_int16);
+
+		Summary->TopVoxelZ[Column] = TopVoxelZ;
+		Summary->GeneratedTopVoxelZ[Column] = TopVoxelZ;
+
+		if(TopVoxelZ != FFGColumnSummary::NoSurface)
+		{
+			Summary->GeneratedMinZ = FMath::Min(Summary->GeneratedMinZ, TopVoxelZ);
+			Summary->GeneratedMaxZ = FMath::Max(Summary->GeneratedMaxZ, TopVoxelZ);
+		}
+	}
+
+	if(Summary->GeneratedMaxZ == FFGColumnSummary::NoSurface) // Nothing solid anywhere in the column.
+	{
+		Summary->GeneratedMinZ = FFGColumnSummary::NoSurface;
+	}
+	Summary->MaxTopVoxelZ = Summary->GeneratedMaxZ;
+
+	return ColumnSummaries.Add(ChunkColumn, MoveTemp(Summary)).Get();
+}
+
+void UFGVoxelGrid::RefreshColumnSummary(const FFGChunkHandleData& ChunkHandle)
+{
+	FFGColumnSummary* Summary = FindOrAddColumnSummary(FIntVector2(ChunkHandle.ChunkCoordinate.X, ChunkHandle.ChunkCoordinate.Y));
+	if(!Summary)
+	{
+		return;
+	}
+
+	for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+	{
+		for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++)
+		{
+			RefreshSurfaceVoxel(*Summary, ChunkHandle, VoxelX, VoxelY);
+		}
+	}
+}
+
+void UFGVoxelGrid::RefreshSurfaceVoxel(FFGColumnSummary& Summary, const FFGChunkHandleData& ChunkHandle, int32 VoxelX, int32 VoxelY)
+{
+	// The top-most solid voxel of one voxel column in a chunk, INDEX_NONE if it's all air.
+	auto FindTopVoxel = [VoxelX, VoxelY](const FFGVoxelChunk& ChunkData) -> int32
+	{
+		if(ChunkData.IsUniform())
+		{
+			return ChunkData.GetUniformType() != VOXELTYPE_NONE ? ChunkSizeX - 1 : INDEX_NONE;
+		}
+
+		FFGVoxelChunk& MutableChunkData = const_cast<FFGVoxelChunk&>(ChunkData); // GetVoxel hands out a reference.
+		for(int32 VoxelZ = ChunkSizeX - 1; VoxelZ >= 0; VoxelZ--)
+		{
+			if(MutableChunkData.GetVoxel(FIntVector(VoxelX, VoxelY, VoxelZ)) != VOXELTYPE_NONE)
+			{
+				return VoxelZ;
+			}
+		}
+		return INDEX_NONE;
+	};
+
+	const int32 Column = UFGVoxelUtils::FlattenVoxelCoord2D(FIntVector2(VoxelX, VoxelY));
+	const int32 OldTopVoxelZ = Summary.TopVoxelZ[Column];
+	const int32 ChunkBaseZ = ChunkHandle.ChunkCoordinate.Z * ChunkSizeX;
+
+	if(OldTopVoxelZ >= ChunkBaseZ + ChunkSizeX) // The surface is above us, nothing in here can move it.
+	{
+		return;
+	}
+
+	int32 NewTopVoxelZ = FFGColumnSummary::NoSurface;
+
+	if(const int32 TopVoxel = FindTopVoxel(*ChunkHandle.ChunkData); TopVoxel != INDEX_NONE)
+	{
+		NewTopVoxelZ = ChunkBaseZ + TopVoxel;
+	}
+	else if(OldTopVoxelZ < ChunkBaseZ) // Still all air and the surface was already below us.
+	{
+		return;
+	}
+	else // We just dug out the surface, follow the column down through whatever is loaded below.
+	{
+		const FFGChunkHandleData* Below = ChunkHandle.GetNeighbour(EFGChunkFace::NegZ);
+		int32 BelowBaseZ = ChunkBaseZ - ChunkSizeX;
+
+		while(Below && Below->Generated)
+		{
+			if(const int32 TopVoxel = FindTopVoxel(*Below->ChunkData); TopVoxel != INDEX_NONE)
+			{
+				NewTopVoxelZ = BelowBaseZ + TopVoxel;
+				break;
+			}
+
+			Below = Below->GetNeighbour(EFGChunkFace::NegZ);
+			BelowBaseZ -= ChunkSizeX;
+		}
+
+		// Ran into a chunk we don't have, trust the generator for it, but no higher than it's top.
+		if(NewTopVoxelZ == FFGColumnSummary::NoSurface && Summary.GeneratedTopVoxelZ[Column] != FFGColumnSummary::NoSurface)
+		{
+			NewTopVoxelZ = FMath::Min<int32>(Summary.GeneratedTopVoxelZ[Column], BelowBaseZ + ChunkSizeX - 1);
+		}
+	}
+
+	Summary.TopVoxelZ[Column] = (int16)FMath::Clamp(NewTopVoxelZ, (int32)FFGColumnSummary::NoSurface, (int32)MAX_int16);
+
+	if(Summary.TopVoxelZ[Column] > Summary.MaxTopVoxelZ)
+	{
+		Summary.MaxTopVoxelZ = Summary.TopVoxelZ[Column];
+	}
+	else if(OldTopVoxelZ == Summary.MaxTopVoxelZ && Summary.TopVoxelZ[Column] < OldTopVoxelZ)
+	{
+		Summary.MaxTopDirty = true; // Might have been the only column that high.
+	}
+}
+
+void UFGVoxelGrid::TrimColumnSummaries()
+{
+	const int32 Budget = FMath::Max(FG::ColumnSummaryBudget, 1);
+	if(ColumnSummaries.Num() <= Budget)
+	{
+		return;
+	}
+
+	// Furthest from every viewer first, trim down to 3/4 of the budget so we aren't doing this every tick.
+	TArray<TPair<int64, FIntVector2>> Columns;
+	Columns.Reserve(ColumnSummaries.Num());
+
+	for(const TPair<FIntVector2, TUniquePtr<FFGColumnSummary>>& Summary : ColumnSummaries)
+	{
+		int64 Distance = ViewerCoordinates.IsEmpty() ? 0 : MAX_int64;
+		for(const FIntVector& ViewerCoordinate : ViewerCoordinates)
+		{
+			const int64 DeltaX = Summary.Key.X - ViewerCoordinate.X;
+			const int64 DeltaY = Summary.Key.Y - ViewerCoordinate.Y;
+			Distance = FMath::Min(Distance, DeltaX * DeltaX + DeltaY * DeltaY);
+		}
+		Columns.Emplace(Distance, Summary.Key);
+	}
+
+	const int32 NumToTrim = ColumnSummaries.Num() - Budget * 3 / 4;
+	Algo::Sort(Columns, [](const TPair<int64, FIntVector2>& A, const TPair<int64, FIntVector2>& B)
+	{
+		return A.Key > B.Key;
+	});
+
+	for(int32 Trim = 0; Trim < NumToTrim; Trim++)
+	{
+		ColumnSummaries.Remove(Columns[Trim].Value);
+	}
+}
+
+FFGVoxelChunk* UFGVoxelGrid::FindChunkDataConcurrent(FIntVector ChunkCoordinate) const
+{
+	FFGChunkIndex::FEntry Entry;
+	if(ChunkIndex.Find(FFGChunkKey(ChunkCoordinate), Entry))
+	{
+		return Entry.ChunkData;
+	}
+	return nullptr;
+}
+
+bool UFGVoxelGrid::IsChunkGeneratedConcurrent(FIntVector ChunkCoordinate) const
+{
+	FFGChunkIndex::FEntry Entry;
+	return ChunkIndex.Find(FFGChunkKey(ChunkCoordinate), Entry) && Entry.Generated;
+}
+
+// @TODO: Maybe use a future / promise here instead of a mutex.
+FFGVoxelChunk* UFGVoxelGrid::GetChunkDataSafe(int32 ChunkDataIndex)
+{
+	checkf(InternalChunkData.IsValidIndex(ChunkDataIndex), TEXT("Invalid chunk data index!"));
+	FFGVoxelChunk* ChunkDataPtr = &InternalChunkData[ChunkDataIndex];
+	//UE::TScopeLock Lock(ChunkDataPtr->ChunkLocked);
+	return ChunkDataPtr;
+}
+
+// @TODO: Maybe use a future / promise here instead of a mutex.
+FFGVoxelChunk* UFGVoxelGrid::GetChunkDataSafe(FFGChunkHandle ChunkHandle)
+{
+	checkf(ChunkHandle->ChunkData, TEXT("Chunk handle has no chunk data!"));
+	FFGVoxelChunk* ChunkDataPtr = ChunkHandle->ChunkData;
+    //UE::TScopeLock Lock(ChunkDataPtr->ChunkLocked);
+    return ChunkDataPtr;
+}
+
+FFGVoxelChunk* UFGVoxelGrid::GetChunkDataUnsafe(int32 ChunkDataIndex)
+{
+	checkf(InternalChunkData.IsValidIndex(ChunkDataIndex), TEXT("Invalid chunk data index!"));
+	return &InternalChunkData[ChunkDataIndex];
+}
+
+FFGVoxelChunk* UFGVoxelGrid::GetChunkDataUnsafe(FFGChunkHandle ChunkHandle)
+{
+	checkf(ChunkHandle->ChunkData, TEXT("Chunk handle has no chunk data!"));
+	return ChunkHandle->ChunkData;
+}
+
+bool UFGVoxelGrid::GenerateChunk(FFGChunkHandle ChunkHandle, bool KnownAir)
+{
+	bool NeedsStages = false;
+	GenerateChunkBatch(MakeArrayView(&ChunkHandle, 1), MakeArrayView(&KnownAir, 1), MakeArrayView(&NeedsStages, 1));
+	return NeedsStages;
+}
+
+void UFGVoxelGrid::GenerateChunkBatch(TConstArrayView<FFGChunkHandle> ChunkHandles, TConstArrayView<bool> KnownAir, TArrayView<bool> OutNeedsStages)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UFGVoxelGrid::GenerateChunkBatch);
+	checkf(WorldGenerator.IsSet(), TEXT("Generation called without valid generator!"));
+	checkf(ChunkHandles.Num() == KnownAir.Num() && ChunkHandles.Num() == OutNeedsStages.Num(), TEXT("Every chunk in a batch needs to say if it's known to be air!"));
+
+	const bool HasLaterStages = GetGenerator()->HasLaterStages();
+	TArray<FFGChunkHandle, TInlineAllocator<16>> ToGenerate;
+
+	for(int32 Chunk = 0; Chunk < ChunkHandles.Num(); Chunk++)
+	{
+		const FFGChunkHandle& ChunkHandle = ChunkHandles[Chunk];
+		FG::TraceChunkStage(ChunkHandle->ChunkCoordinate, EFGChunkTraceStage::GenerateStart);
+
+		FFGVoxelChunk& ChunkData = *ChunkHandle->ChunkData;
+		ChunkData.Reset(); // Slot may be recycled from an unloaded chunk.
+		OutNeedsStages[Chunk] = false;
+
+		// Saved chunks take priority, we're already on a worker so the read is as async as generating.
+		// They were saved complete, so skip every stage.
+		if(RegionStore.IsValid() && RegionStore->LoadChunk(ChunkHandle->ChunkCoordinate, ChunkData))
+		{
+			ChunkData.SetFlags(EFGChunkFlags::Edited);
+		}
+		else
+		{
+			ChunkData.Reset(); // A failed load may have left something behind.
+
+			if(!KnownAir[Chunk]) // Above the surface the generator would only make air.
+			{
+				ToGenerate.Add(ChunkHandle);
+				OutNeedsStages[Chunk] = HasLaterStages;
+			}
+		}
+	}
+
+	if(!ToGenerate.IsEmpty())
+	{
+		GetGenerator()->GenerateBatch(ToGenerate);
+
+		for(const FFGChunkHandle& ChunkHandle : ToGenerate)
+		{
+			ChunkHandle->ChunkData->ShrinkPalette(); // Collapses single type chunks down to uniform.
+		}
+	}
+
+	for(int32 Chunk = 0; Chunk < ChunkHandles.Num(); Chunk++)
+	{
+		// Chunks no stage would touch, like solid ground, don't wait on their neighbours.
+		if(OutNeedsStages[Chunk] && !GetGenerator()->NeedsLaterStages(*ChunkHandles[Chunk]->ChunkData, ChunkHandles[Chunk]->ChunkCoordinate))
+		{
+			OutNeedsStages[Chunk] = false;
+		}
+
+		if(!OutNeedsStages[Chunk]) // Staged chunks finish after their last stage.
+		{
+			FG::TraceChunkStage(ChunkHandles[Chunk]->ChunkCoordinate, EFGChunkTraceStage::GenerateEnd);
+		}
+	}
+}
+
+void UFGVoxelGrid::GenerateChunkStage(const FFGChunkHandle& ChunkHandle, EFGGenerationStage Stage, const FFGGenerationRegion& Region, bool LastStage)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UFGVoxelGrid::GenerateChunkStage);
+
+	GetGenerator()->GenerateStage(Stage, Region);
+
+	if(LastStage)
+	{
+		ChunkHandle->ChunkData->ShrinkPalette(); // Carving may have left types nothing uses.
+		FG::TraceChunkStage(ChunkHandle->ChunkCoordinate, EFGChunkTraceStage::GenerateEnd);
+	}
+}
+
+void UFGVoxelGrid::FinishGeneratedChunk(FFGChunkHandleData& ChunkHandle)
+{
+	checkf(IsInGameThread(), TEXT("Chunks can only be marked generated on the game thread!"));
+
+	FFGVoxelChunk& ChunkData = *ChunkHandle.ChunkData;
+
+	// Edits from a previous run that never made it into the region file.
+	TArray<FFGEditJournal::FRecord> ReplayedEdits;
+	if(EditJournal.IsValid() && EditJournal->FindReplayedEdits(ChunkHandle.ChunkCoordinate, ReplayedEdits))
+	{
+		for(const FFGEditJournal::FRecord& Edit : ReplayedEdits)
+		{
+			ChunkData.SetVoxel(Edit.VoxelIndex, Edit.NewType);
+		}
+		ChunkData.SetFlags(EFGChunkFlags::Modified | EFGChunkFlags::Edited); // Saving it lets the journal drop them.
+	}
+	//GetChunkDataUnsafe(ChunkHandle)->SetFlags(EFGChunkFlags::Generated);
+	ChunkHandle.Generated = true;
+}
+
+FFGChunkHandle UFGVoxelGrid::ConstructChunkHandle(FIntVector ChunkCoordinate)
+{
+	TWeakObjectPtr<UFGVoxelGrid> GridWeak = MakeWeakObjectPtr(this);
+	auto ChunkHandleDeleter = [GridWeak](void* ObjectToDelete)
+	{
+		FFGChunkHandleData* ChunkData = reinterpret_cast<FFGChunkHandleData*>(ObjectToDelete);
+		
+		if(GridWeak.IsValid())
+		{
+			// Only unmap if the coordinate hasn't since been handed to a newer handle.
+			const FFGChunkKey ChunkKey(ChunkData->ChunkCoordinate);
+			const int32* MappedSlot = GridWeak->ActiveChunkSlots.Find(ChunkKey);
+			const bool IsMapped = MappedSlot && *MappedSlot == ChunkData->ChunkDataIndex;
+			if(IsMapped)
+			{
+				GridWeak->ActiveChunkSlots.Remove(ChunkKey);
+			}
+			GridWeak->ChunkIndex.Remove(ChunkKey, ChunkData->ChunkDataIndex);
+
+            GridWeak->InternalGarbageChunks.Push(ChunkData->ChunkCoordinate);
+			GridWeak->SaveChunkIfModified(ChunkData->ChunkCoordinate, *ChunkData->ChunkData);
+
+			if(IsMapped && ChunkData->Generated && FG::ChunkCacheBudgetMB > 0) // Keep it around in case we come back.
+			{
+				GridWeak->RetainChunkSlot(ChunkKey, ChunkData->ChunkDataIndex);
+			}
+			else // Workers may still be reading this slot, it goes back on the freelist once they drain.
+			{
+				GridWeak->ChunkIndex.RetireSlot(ChunkData->ChunkDataIndex);
+			}
+		}
+
+		ChunkData->UnlinkNeighbours();
+		FMemory::Free(ObjectToDelete);
+	};
+
+	FFGChunkHandle OutChunkHandle = MakeShareable(new FFGChunkHandleData(), MoveTemp(ChunkHandleDeleter));
+	OutChunkHandle->ChunkCoordinate = ChunkCoordinate;
+	return OutChunkHandle;
+}
+
+void UFGVoxelGrid::AssignChunkSlot(FFGChunkHandle ChunkHandle)
+{
+	checkf(IsInGameThread(), TEXT("Chunk storage can only grow on the game thread!"));
+
+	int32 NextIndex;
+
+	if(!InternalChunkFreelist.IsEmpty()) // Steal from the freelist.
+	{
+		NextIndex = InternalChunkFreelist.Pop();
+	}
+	else // Reserve our index to append to the chunk data.
+	{
+		NextIndex = FPlatformAtomics::InterlockedIncrement(&InternalChunkCount) - 1;
+	}
+
+	// Pages never move, so growing here can't invalidate any chunk pointer held elsewhere.
+	InternalChunkData.GrowTo(NextIndex + 1);
+
+	BindChunkSlot(ChunkHandle, NextIndex);
+}
+
+void UFGVoxelGrid::BindChunkSlot(FFGChunkHandle ChunkHandle, int32 ChunkDataIndex)
+{
+	ChunkHandle->ChunkDataIndex = ChunkDataIndex;
+	ChunkHandle->ChunkData = &InternalChunkData[ChunkDataIndex];
+
+	if(SlotHandles.Num() <= ChunkDataIndex)
+	{
+		SlotHandles.SetNum(ChunkDataIndex + 1);
+	}
+	SlotHandles[ChunkDataIndex] = ChunkHandle;
+	ActiveChunkSlots.FindOrAdd(FFGChunkKey(ChunkHandle->ChunkCoordinate), ChunkDataIndex) = ChunkDataIndex;
+	ChunkIndex.Add(FFGChunkKey(ChunkHandle->ChunkCoordinate), { ChunkHandle->ChunkData, ChunkDataIndex, false });
+	LinkChunkNeighbours(*ChunkHandle);
+}
+
+void UFGVoxelGrid::LinkChunkNeighbours(FFGChunkHandleData& ChunkHandle)
+{
+	for(int32 Face = 0; Face < (int32)EFGChunkFace::Num; Face++)
+	{
+		const FIntVector NeighbourCoordinate = ChunkHandle.ChunkCoordinate + FFGChunkHandleData::GetFaceOffset((EFGChunkFace)Face);
+		const int32* NeighbourSlot = ActiveChunkSlots.Find(FFGChunkKey(NeighbourCoordinate));
+		const FFGChunkHandle Neighbour = NeighbourSlot ? SlotHandles[*NeighbourSlot].Pin() : FFGChunkHandle();
+
+		ChunkHandle.Neighbours[Face] = Neighbour.Get();
+		if(Neighbour.IsValid()) // Takes over from any older handle still alive for this coordinate.
+		{
+			Neighbour->Neighbours[Face ^ 1] = &ChunkHandle;
+		}
+	}
+}
+
+void UFGVoxelGrid::RetainChunkSlot(FFGChunkKey ChunkKey, int32 ChunkDataIndex)
+{
+	const FFGVoxelChunk& ChunkData = InternalChunkData[ChunkDataIndex];
+	ChunkCache.Retain(ChunkKey, ChunkDataIndex, sizeof(FFGVoxelChunk) + ChunkData.GetAllocatedSize());
+	TrimChunkCache();
+}
+
+void UFGVoxelGrid::TrimChunkCache()
+{
+	const int64 ResidentBudget = (int64)FMath::Max(FG::ChunkCacheBudgetMB, 0) * 1024 * 1024;
+	const int64 ColdBudget = (int64)FMath::Max(FG::ChunkCacheColdBudgetMB, 0) * 1024 * 1024;
+
+	ChunkCache.Trim(ResidentBudget, ColdBudget, [this, ColdBudget](FFGChunkKey ChunkKey, int32 ChunkDataIndex, TArray<uint8>& OutColdBytes)
+	{
+		if(ColdBudget > 0)
+		{
+			InternalChunkData[ChunkDataIndex].Compress(OutColdBytes);
+		}
+		ChunkIndex.RetireSlot(ChunkDataIndex);
+	});
 }
@@ -5,23 +5,182 @@
 
 #include "Generators/FGVoxelGenerator.h"
 #include "Containers/FGVoxelChunk.h"
+#include "Containers/FGPagedArray.h"
+#include "Containers/FGChunkKey.h"
+#include "Containers/FGChunkIndex.h"
+#include "Containers/FGChunkCache.h"
+#include "Containers/FGRegionStore.h"
+#include "Containers/FGEditJournal.h"
+#include "Containers/MpscQueue.h"
+#include "Tasks/Task.h"
 #include "FGVoxelGrid.generated.h"
 
+/**
+ * The six faces of a chunk, opposite faces are paired so Face ^ 1 is the other side.
+ */
+enum class EFGChunkFace : uint8
+{
+	PosX,
+	NegX,
+	PosY,
+	NegY,
+	PosZ,
+	NegZ,
+	Num
+};
+
 struct FFGChunkHandleData
 {
 	FIntVector ChunkCoordinate = FIntVector::ZeroValue;
 	int32 ChunkDataIndex = INDEX_NONE;
-	bool Generated = false;
+	FFGVoxelChunk* ChunkData = nullptr; // Stable for the lifetime of the handle, safe to cache.
+	bool Generated = false; // Set by the game thread once workers are done writing the chunk. Game thread only.
+
+	/**
+	 * Loaded face neighbours by EFGChunkFace, so crossing a chunk border doesn't need a map lookup.
+	 * Linked by the grid when a chunk is loaded and unlinked when either side is destroyed.
+	 * Game thread only, and a neighbour may still be generating so check it's Generated flag.
+	 */
+	FFGChunkHandleData* Neighbours[(int32)EFGChunkFace::Num] = {};
+
+	/** The next generation stage the chunk needs, Num once it's complete. Game thread only. */
+	EFGGenerationStage NextStage = EFGGenerationStage::Terrain;
+
+	/** A stage is generating this chunk, nothing else may read or write it. Game thread only. */
+	bool StageRunning = false;
+
+	/**
+	 * How many running stages are reading this chunk as a neighbour, it can't be written until they're done.
+	 * Game thread only, see UFGVoxelGrid::OnStageReadsReleased.
+	 */
+	int32 StageReaders = 0;
 
 	FFGChunkHandleData() = default;
+
+	/**
+	 * Get the loaded chunk on the other side of a face.
+	 * @param Face - The face to look across.
+	 * @return The neighbour, or nullptr if it isn't loaded.
+	 */
+	FFGChunkHandleData* GetNeighbour(EFGChunkFace Face) const { return Neighbours[(int32)Face]; }
+
+	/**
+	 * Get the chunk coordinate offset across a face.
+	 * @param Face - The face.
+	 * @return A unit offset along the face's axis.
+	 */
+	static FIntVector GetFaceOffset(EFGChunkFace Face)
+	{
+		static const FIntVector FaceOffsets[(int32)EFGChunkFace::Num] =
+		{
+			FIntVector( 1,  0,  0),
+			FIntVector(-1,  0,  0),
+			FIntVector( 0,  1,  0),
+			FIntVector( 0, -1,  0),
+			FIntVector( 0,  0,  1),
+			FIntVector( 0,  0, -1)
+		};
+		return FaceOffsets[(int32)Face];
+	}
+
+	/** Clear every link to and from this chunk, it's neighbours forget it. */
+	void UnlinkNeighbours()
+	{
+		for(int32 Face = 0; Face < (int32)EFGChunkFace::Num; Face++)
+		{
+			FFGChunkHandleData* Neighbour = Neighbours[Face];
+			if(Neighbour && Neighbour->Neighbours[Face ^ 1] == this)
+			{
+				Neighbour->Neighbours[Face ^ 1] = nullptr;
+			}
+			Neighbours[Face] = nullptr;
+		}
+	}
 };
 
 using FFGChunkHandle = TSharedPtr<FFGChunkHandleData>;
 
+/**
+ * A chunk and the 26 loaded chunks around it, for work that reads across chunk borders.
+ * Gathered in one go by UFGVoxelGrid::GetChunkNeighbourhood, game thread only, and only
+ * valid until the chunks it points at could be unloaded, so don't keep it past the frame.
+ */
+struct FFGChunkNeighbourhood
+{
+	/** Indexed by (X + 1) + (Y + 1) * 3 + (Z + 1) * 9, the centre chunk is 13. */
+	FFGChunkHandleData* Chunks[27] = {};
+
+	/**
+	 * Get a chunk by it's offset from the centre.
+	 * @param Offset - Chunk offset, each axis -1 to 1.
+	 * @return The chunk, or nullptr if it isn't loaded.
+	 */
+	FFGChunkHandleData* GetChunk(FIntVector Offset) const
+	{
+		checkf(FMath::Abs(Offset.X) <= 1 && FMath::Abs(Offset.Y) <= 1 && FMath::Abs(Offset.Z) <= 1,
+			TEXT("Offset %s is outside of the neighbourhood!"), *Offset.ToString());
+
+		return Chunks[(Offset.X + 1) + (Offset.Y + 1) * 3 + (Offset.Z + 1) * 9];
+	}
+
+	/**
+	 * Get a voxel by it's coordinate relative to the centre chunk, so -32 to 63 on each axis.
+	 * @param VoxelCoordinate - The voxel coordinate relative to the centre chunk.
+	 * @return The voxel type, air if it's chunk isn't loaded or generated.
+	 */
+	uint32 GetVoxel(FIntVector VoxelCoordinate) const
+	{
+		using namespace FG::Const;
+
+		const FIntVector Offset(
+			(VoxelCoordinate.X + ChunkSizeX) / ChunkSizeX - 1,
+			(VoxelCoordinate.Y + ChunkSizeX) / ChunkSizeX - 1,
+			(VoxelCoordinate.Z + ChunkSizeX) / ChunkSizeX - 1);
+
+		const FFGChunkHandleData* Chunk = GetChunk(Offset);
+		if(!Chunk || !Chunk->Generated)
+		{
+			return VOXELTYPE_NONE;
+		}
+
+		return Chunk->ChunkData->GetVoxel(FIntVector(
+			VoxelCoordinate.X & (ChunkSizeX - 1),
+			VoxelCoordinate.Y & (ChunkSizeX - 1),
+			VoxelCoordinate.Z & (ChunkSizeX - 1)));
+	}
+};
+
+/**
+ * Where the surface is in a column of chunks, so the air above it never has to be generated.
+ * Heights are world voxel Z, stored narrow as there's one of these per column we've been near.
+ */
+struct FFGColumnSummary
+{
+	static constexpr int16 NoSurface = MIN_int16;
+
+	/** Top-most solid voxel of each voxel column after edits, indexed by FlattenVoxelCoord2D. */
+	TStaticArray<int16, FG::Const::ChunkSizeXY> TopVoxelZ;
+
+	/** Top-most solid voxel of each voxel column as the generator makes it, used below unloaded chunks. */
+	TStaticArray<int16, FG::Const::ChunkSizeXY> GeneratedTopVoxelZ;
+
+	/** Lowest and highest surface the generator makes in the column. */
+	int16 GeneratedMinZ = NoSurface;
+	int16 GeneratedMaxZ = NoSurface;
+
+	/** Highest of TopVoxelZ, nothing above it is solid. Recomputed lazily once an edit lowers the surface. */
+	int16 MaxTopVoxelZ = NoSurface;
+	bool MaxTopDirty = false;
+};
+
 /**
  * Handle for an asynchronous chunk load operation.
  * This type should be used as FFGVoxelLoadHandle rather than directly so that
  * copies of the actual handle may be made a passed around.
+ *
+ * The grid only holds this weakly, so keep a reference for as long as you
+ * still want the chunks. Dropping every reference cancels anything that
+ * hasn't started generating yet, unless another load also asked for it.
  */
 class FGVOXEL_API FFGVoxelLoadHandleData
 {
@@ -32,16 +191,14 @@ public:
 		ChunkHandles({ InChunkHandle }),
 		ChunkCoordinates({ InChunkCoordinate }),
 		BatchSize(InBatchLength),
-		LoadCount(0),
-		LoadedIndices({})
+		LoadCount(0)
 	{}
 
 	FFGVoxelLoadHandleData(int32 InBatchLength, TArray<FIntVector> InChunkCoordinates, TArray<FFGChunkHandle> InChunkHandles) :
 		ChunkHandles(InChunkHandles),
 		ChunkCoordinates(InChunkCoordinates),
 		BatchSize(InBatchLength),
-		LoadCount(0),
-		LoadedIndices({})
+		LoadCount(0)
 	{}
 
 	TMulticastDelegate<void(FFGChunkHandle)>			OnFinishedLoadingChunk;
@@ -60,17 +217,70 @@ public:
 	TArray<FFGChunkHandle>	ChunkHandles;
 	TArray<FIntVector>		ChunkCoordinates;
 
+	/** Speculative loads like prefetches, only generated once nothing else near the viewers is waiting. */
+	bool					LowPriority = false;
+
 private:
 
 	FFGVoxelLoadHandleData() = default;
 
 	volatile int32          BatchSize;
 	volatile int32			LoadCount;
-	TArray<int32>			LoadedIndices;
 };
 
 using FFGVoxelLoadHandle = TSharedPtr<FFGVoxelLoadHandleData>;
 
+/**
+ * Stages a chunk goes through on it's way in, for measuring what each one costs.
+ */
+enum class EFGChunkStage : uint8
+{
+	Generation,		// Worker thread.
+	Meshing,		// Game thread.
+	ActorSpawn,		// Game thread.
+	Num
+};
+
+/**
+ * A chunk that finished generating in the background, waiting for the game thread.
+ */
+struct FFGCompletedChunk
+{
+	FFGChunkKey ChunkKey;
+
+	/**
+	 * The worker's reference to the chunk, handed back so it's released on the game thread. If every load
+	 * gave up on the chunk while it was generating this can be the last one, and the deleter isn't thread safe.
+	 */
+	FFGChunkHandle ChunkHandle;
+
+	double GenerationSeconds = 0.0;
+	bool NeedsStages = false; // Terrain finished, but the generator has later stages to run.
+};
+
+/**
+ * A chunk waiting to be generated, shared by every load that asked for it.
+ */
+struct FFGChunkLoadRequest
+{
+	FFGChunkHandle ChunkHandle;
+	TArray<TWeakPtr<FFGVoxelLoadHandleData>, TInlineAllocator<1>> LoadHandles;
+	uint64 Sequence = 0; // Request order, breaks ties between chunks at the same distance.
+	UE::Tasks::FTask GenerationTask; // Only valid once the chunk is generating.
+
+	/** Last stage the chunk has to reach, lower for chunks only wanted as a neighbour of another chunk's stage. */
+	EFGGenerationStage TargetStage = EFGGenerationStage::Num;
+
+	/** Staged chunks that need this one as a neighbour, it isn't cancelled while there are any. */
+	int32 NumDependents = 0;
+
+	/** Neighbours this chunk's stages need, kept loaded until it's complete. */
+	TArray<FFGChunkHandle> Dependencies;
+
+	/** Neighbours the running stage is reading. */
+	TArray<FFGChunkHandle> StageReads;
+};
+
 /**
  * Data grid for sparse voxel data on the CPU.
  *
@@ -88,11 +298,71 @@ using FFGVoxelLoadHandle = TSharedPtr<FFGVoxelLoadHandleData>;
  * Ideally we will map out the virtual address ranges for our pools and
  * hold a ptr to the end of the allocation of the pools, letting us
  * gradually prefetch the entire range of chunks in each pool.
+ *
+ * The pools live in FFGVoxelArena, one slab per bits per voxel, and the
+ * chunks in InternalChunkData are just small headers pointing into them.
+ * The headers themselves are paged, so a chunk never moves once allocated
+ * and growing the grid never copies existing chunks.
+ *
+ * Pending chunks are generated closest first. Every tick each request is
+ * scored by it's distance to the nearest viewer and the closest ones up to
+ * the generation budget are popped off a heap, so requests that fall behind
+ * a fast moving player simply wait, or are cancelled when their load handle
+ * is dropped. Asking for a chunk that is already pending or loaded shares
+ * the existing chunk rather than generating it twice.
+ *
+ * Generation never blocks the game thread. Chunks are generated on
+ * background tasks which push their key onto a lock free completion queue,
+ * and the game thread drains that queue within FG.ChunkCompletionBudgetMs
+ * each tick, firing the load handle callbacks as it goes.
+ *
+ * Both sides are budgeted in time rather than chunk count. The grid keeps a
+ * rolling cost per chunk for each EFGChunkStage, admitting only as much
+ * generation as fits FG.ChunkGenBudgetMs per worker, and stopping the drain
+ * when the next chunk's predicted meshing and actor spawn would overrun.
+ *
+ * Generated chunks outlive their last handle in an LRU cache capped by
+ * FG.ChunkCacheBudgetMB, optionally spilling to a compressed cold tier, so
+ * coming back to an area we've already been doesn't generate it again.
+ *
+ * Chunks flagged Modified are written to region files when they unload, and
+ * loading a chunk checks it's region file on the generation worker before
+ * falling back to the generator. See FFGRegionStore.
+ *
+ * Individual edits also go to a write ahead journal, flushed in batches in
+ * the background and folded into the region files by a periodic checkpoint,
+ * so a crash loses at most FG.JournalFlushIntervalMs of edits. Journaled
+ * edits are replayed over chunks as they generate. See FFGEditJournal.
+ *
+ * Each XY column of chunks keeps a summary of where it's surface is, seeded
+ * from the generator and kept up to date with edits. Chunks entirely above
+ * the surface are known to be air, so they skip the generator, and without
+ * persistence they skip the workers entirely. See FFGColumnSummary.
+ *
+ * Generators can add stages after Terrain that read neighbouring chunks,
+ * see EFGGenerationStage. Once it's Terrain is done a chunk waits in
+ * StagedChunks, and each tick every chunk whose neighbours have reached
+ * the stage before it's next one runs it on a worker, pulling in any
+ * missing neighbours as requests that only go as far as they're needed.
+ * A running stage locks it's chunk for writing and it's neighbours for
+ * reading, so stages that overlap never run at once.
+ *
+ * Loaded chunk handles are linked to their six face neighbours, so walking
+ * across chunk borders is a pointer read rather than a map lookup, see
+ * FFGChunkHandleData::GetNeighbour and GetChunkNeighbourhood().
+ *
+ * FindChunk and friends are game thread only. Worker threads look chunks
+ * up through the concurrent index instead, see GetChunkIndex(). A slot is
+ * only recycled once every reader that could have seen it has drained.
  */
 UCLASS()
 class FGVOXEL_API UFGVoxelGrid : public UObject, public FTickableGameObject
 {
 	GENERATED_BODY()
+
+	/** Drives generation directly, there is no world to tick the scheduler. */
+	friend class UFGVoxelBenchCommandlet;
+
 public:
 	
 	//~ Begin Super
@@ -100,6 +370,7 @@ public:
 	void Tick(float DeltaTime) override;
 	bool IsTickableInEditor() const override { return true; }
 	TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UFGVoxelGrid, STATGROUP_Tickables) }
+	void BeginDestroy() override;
 	//~ End Super
 
 	/**
@@ -139,6 +410,50 @@ public:
 	 */
 	void FlushAllChunks();
 
+	/**
+	 * Write every loaded chunk flagged Modified to it's region file.
+	 * Chunks are saved automatically when they unload, this is for explicit saves.
+	 * @param WaitForWrites - Block until the writes are on disk.
+	 */
+	void SaveModifiedChunks(bool WaitForWrites);
+
+	/**
+	 * Broadcast when the last stage reading a chunk as a neighbour finishes, so writes that were held back
+	 * while StageReaders was above 0 can be made. Game thread only.
+	 */
+	TMulticastDelegate<void(FFGChunkHandle)> OnStageReadsReleased;
+
+	/**
+	 * Journal a voxel edit so it survives a crash before the chunk is saved.
+	 * The caller still flags the chunk Modified.
+	 * @param ChunkCoordinate - The chunk that was edited.
+	 * @param VoxelIndex - Flattened voxel index inside the chunk.
+	 * @param OldType - The voxel type before the edit.
+	 * @param NewType - The voxel type after the edit.
+	 */
+	void RecordVoxelEdit(FIntVector ChunkCoordinate, int32 VoxelIndex, uint32 OldType, uint32 NewType);
+
+	/**
+	 * How many chunks are waiting to be generated or still generating.
+	 * @return The number of pending chunk requests.
+	 */
+	int32 GetNumPendingChunks() const { return PendingRequests.Num() + InFlightRequests.Num() + StagedChunks.Num(); }
+
+	/**
+	 * Feed a measured cost for one chunk into the rolling average for it's stage, game thread only.
+	 * Meshers and the actor manager call this so the grid can budget the work it hands them.
+	 * @param Stage - The stage that was measured.
+	 * @param Seconds - How long the stage took for a single chunk.
+	 */
+	void RecordChunkStageCost(EFGChunkStage Stage, double Seconds);
+
+	/**
+	 * Get the rolling average cost of a stage.
+	 * @param Stage - The stage to get.
+	 * @return The average cost per chunk in milliseconds, 0 if it was never measured.
+	 */
+	double GetChunkStageCostMs(EFGChunkStage Stage) const { return StageCostMs[(int32)Stage]; }
+
 	/**
 	 * Find a chunks data by it's coordinate.
 	 * @param ChunkCoordinate - The chunk coordinate to find.
@@ -153,6 +468,13 @@ public:
 	 */
 	FFGChunkHandle FindChunkChecked(FIntVector ChunkCoordinate);
 
+	/**
+	 * Find a chunk that's safe to read, one a worker may still be generating counts as not loaded.
+	 * @param ChunkCoordinate - The chunk coordinate to find.
+	 * @return The chunk handle, or invalid if it isn't loaded or is still generating.
+	 */
+	FFGChunkHandle FindGeneratedChunk(FIntVector ChunkCoordinate);
+
 	/**
 	 * Check if the chunk at the given coordinate has been generated or loaded.
 	 * @param ChunkCoordinate - The chunk coordinate to check.
@@ -160,13 +482,61 @@ public:
 	 */
 	bool IsChunkGenerated(FIntVector ChunkCoordinate);
 
+	/**
+	 * Gather a chunk and every loaded chunk around it, following neighbour links where it can.
+	 * @param ChunkHandle - The chunk at the centre.
+	 * @return The 3x3x3 neighbourhood, missing chunks are nullptr.
+	 */
+	FFGChunkNeighbourhood GetChunkNeighbourhood(const FFGChunkHandle& ChunkHandle);
+
+	/**
+	 * Get the top-most solid voxel of a voxel column without generating anything, O(1) once the column
+	 * has been summarised. Accounts for edits to chunks that have been loaded, the rest is predicted.
+	 * @param VoxelXY - World voxel XY of the column.
+	 * @param OutVoxelZ - World voxel Z of the surface voxel.
+	 * @return false if the generator can't predict it's surface or the column has nothing solid.
+	 */
+	bool GetSurfaceVoxelZ(FIntVector2 VoxelXY, int32& OutVoxelZ);
+
+	/**
+	 * Check if a chunk is entirely above the surface of it's column, so it's air unless it was saved with edits.
+	 * @param ChunkCoordinate - The chunk coordinate to check.
+	 * @return true if nothing in the chunk can be solid.
+	 */
+	bool IsChunkAboveSurface(FIntVector ChunkCoordinate);
+
+	/**
+	 * Get the lock free chunk index, readable from any thread inside an FFGChunkReadScope.
+	 * Changes on the game thread are published once per grid tick, so this can lag by a frame.
+	 * @return The concurrent chunk index.
+	 */
+	const FFGChunkIndex& GetChunkIndex() const { return ChunkIndex; }
+
+	/**
+	 * Find a chunks data from any thread. Must be called inside an FFGChunkReadScope on
+	 * GetChunkIndex(), the chunk memory is only guaranteed to stay valid until it ends.
+	 * Reading voxels that are still being generated is up to the caller to avoid.
+	 * @param ChunkCoordinate - The chunk coordinate to find.
+	 * @return The chunk data, or nullptr if the chunk isn't loaded.
+	 */
+	FFGVoxelChunk* FindChunkDataConcurrent(FIntVector ChunkCoordinate) const;
+
+	/**
+	 * Check if the chunk at the given coordinate has been generated, from any thread.
+	 * Must be called inside an FFGChunkReadScope on GetChunkIndex().
+	 * @param ChunkCoordinate - The chunk coordinate to check.
+	 * @returns true if the chunk has been generated or loaded.
+	 */
+	bool IsChunkGeneratedConcurrent(FIntVector ChunkCoordinate) const;
+
 	/**
 	 * Safely get the chunk data at the given index, if the chunk is locked, the callee
 	 * thread will be stalled out until the chunk unlocks. Avoid using this where possible
 	 * since this can cause hitching - don't just use the unsafe version, be sensible with
 	 * your access patterns.
 	 * 
-	 * This reference is not safe to store.
+	 * The address is stable while the chunk is loaded, but store the handle rather than the
+	 * index, since the index is recycled once the chunk unloads.
 	 * 
 	 * @param ChunkDataIndex - The index of the chunk data to get.
 	 * @returns The chunk data at the given index.
@@ -177,7 +547,7 @@ public:
 	 * Get the chunk data at the given index, this is unsafe and should only be used when
 	 * you can absolutely guarantee that the chunk data is not being written on another thread.
 	 * 
-	 * This reference is not safe to store.
+	 * The pointer is safe to store for as long as you hold the handle.
 	 * 
 	 * @param ChunkHandle - The handle of the chunk data to get.
 	 * @return The chunk data from the given handle.
@@ -188,7 +558,7 @@ public:
 	 * Get the chunk data at the given index, this is unsafe and should only be used when
 	 * you can absolutely guarantee that the chunk data is not being written on another thread.
 	 * 
-	 * This reference is not safe to store.
+	 * The address is stable while the chunk is loaded, but the index is recycled once it unloads.
 	 * 
 	 * @param ChunkDataIndex - The index of the chunk data to get.
 	 * @return The chunk data at the given index.
@@ -199,7 +569,7 @@ public:
 	 * Get the chunk data at the given index, this is unsafe and should only be used when
 	 * you can absolutely guarantee that the chunk data is not being written on another thread.
 	 * 
-	 * This reference is not safe to store.
+	 * The pointer is safe to store for as long as you hold the handle.
 	 * 
 	 * @param ChunkHandle - The handle of the chunk data to get.
 	 * @return The chunk data from the given handle.
@@ -209,13 +579,40 @@ public:
 private:
 	
 	/**
-	 * Generate a chunk's data, loading saved data from memory if required.
+	 * Generate a chunk's data, loading saved data from it's region file if there is any.
 	 * Used for multithreaded generation, therefore must be used with care
 	 * only in the correct contexts. To externally use this function you
 	 * should be using either LoadChunkAsync or LoadChunkSynchronous.
 	 * @param ChunkHandle - The data that should be written to.
+	 * @param KnownAir - The chunk is above the surface, skip the generator and leave it as air.
+	 * @return true if only Terrain ran and the chunk still needs the generator's later stages.
+	 */
+	bool GenerateChunk(FFGChunkHandle ChunkHandle, bool KnownAir = false);
+
+	/**
+	 * Generate several chunks on the calling thread, sharing generator work between them.
+	 * Same rules as GenerateChunk for each chunk.
+	 * @param ChunkHandles - The chunks to generate.
+	 * @param KnownAir - For each chunk, if it's above the surface and can skip the generator.
+	 * @param OutNeedsStages - For each chunk, set if it still needs the generator's later stages.
 	 */
-	void GenerateChunk(FFGChunkHandle ChunkHandle);
+	void GenerateChunkBatch(TConstArrayView<FFGChunkHandle> ChunkHandles, TConstArrayView<bool> KnownAir, TArrayView<bool> OutNeedsStages);
+
+	/**
+	 * Run one stage after Terrain for a chunk, on the calling thread.
+	 * @param ChunkHandle - The chunk, locked for the stage by RunGenerationStage.
+	 * @param Stage - The stage to run.
+	 * @param Region - The chunk and it's neighbours.
+	 * @param LastStage - This is the generator's last stage, so the chunk is complete after it.
+	 */
+	void GenerateChunkStage(const FFGChunkHandle& ChunkHandle, EFGGenerationStage Stage, const FFGGenerationRegion& Region, bool LastStage);
+
+	/**
+	 * Replay journaled edits over a chunk that has been through every stage and mark it generated.
+	 * Game thread only, once the worker is done with it, so nothing on the game thread sees it half written.
+	 * @param ChunkHandle - The chunk.
+	 */
+	void FinishGeneratedChunk(FFGChunkHandleData& ChunkHandle);
 
 	TMulticastDelegate<void(FIntVector)> OnUnloadedChunk;
 	
@@ -223,16 +620,228 @@ private:
 	TOptional<TObjectPtr<UFGVoxelGenerator>> WorldGenerator;
 	
 	FFGChunkHandle ConstructChunkHandle(FIntVector ChunkCoordinate);
+
+	/**
+	 * Request a chunk for a load, merging with any existing request or loaded chunk.
+	 * @param LoadHandle - The load that wants the chunk, null when it's only wanted as a stage's neighbour.
+	 * @param ChunkCoordinate - The chunk coordinate to load.
+	 * @param TargetStage - The last stage it has to reach.
+	 * @return The handle of the chunk that will be generated.
+	 */
+	FFGChunkHandle RequestChunk(const FFGVoxelLoadHandle& LoadHandle, FIntVector ChunkCoordinate, EFGGenerationStage TargetStage = EFGGenerationStage::Num);
+
+	/**
+	 * Find the request for a chunk that is still on it's way, waiting, generating or part way through it's stages.
+	 * @param ChunkKey - The chunk.
+	 * @return The request, or nullptr if the chunk isn't being generated.
+	 */
+	FFGChunkLoadRequest* FindGenerationRequest(FFGChunkKey ChunkKey);
+
+	/**
+	 * Score a chunk by how close it is to the nearest viewer, lowest goes first.
+	 * @param ChunkCoordinate - The chunk coordinate.
+	 * @return Distance squared in chunks to the nearest viewer.
+	 */
+	double GetViewerPriority(FIntVector ChunkCoordinate) const;
+
+	/**
+	 * Fire the callbacks for a chunk finishing in a load, and the batch if it was the last.
+	 * @param LoadHandle - The load that wanted the chunk.
+	 * @param ChunkHandle - The chunk that finished.
+	 */
+	void FinishChunkLoad(const FFGVoxelLoadHandle& LoadHandle, const FFGChunkHandle& ChunkHandle);
+
+	/** Refresh the chunk coordinates of everything we prioritize loading around. */
+	void GatherViewers();
+
+	/** Fire callbacks for chunks finished in the background, until the completion budget runs out. */
+	void DrainCompletedChunks();
+
+	/**
+	 * Mark a generated chunk as generated and fire the callbacks of every load that wanted it.
+	 * @param Request - The finished request.
+	 */
+	void CompleteChunkRequest(const FFGChunkLoadRequest& Request);
+
+	/**
+	 * Hand a chunk on once it's Terrain is done, either to the stage scheduler or straight to it's loads.
+	 * @param Request - The request, moved from.
+	 * @param NeedsStages - The chunk still needs the generator's later stages.
+	 */
+	void FinishTerrainStage(FFGChunkLoadRequest&& Request, bool NeedsStages);
+
+	/** Start every staged chunk's next stage whose neighbours are ready, closest first. */
+	void TickGenerationStages();
+
+	/**
+	 * Make sure every neighbour the next stage of a chunk reads is loaded and on it's way to the stage before.
+	 * @param Request - The staged chunk's request.
+	 * @return true if every neighbour is ready to be read right now.
+	 */
+	bool RequestStageDependencies(FFGChunkLoadRequest& Request);
+
+	/**
+	 * Lock a staged chunk and it's neighbours and start it's next stage.
+	 * @param ChunkKey - The chunk.
+	 * @param Request - It's request in StagedChunks.
+	 */
+	void RunGenerationStage(FFGChunkKey ChunkKey, FFGChunkLoadRequest& Request);
+
+	/**
+	 * Unlock a chunk after a stage and move it up the ladder, completing it after the last.
+	 * @param ChunkKey - The chunk that finished a stage.
+	 */
+	void FinishGenerationStage(FFGChunkKey ChunkKey);
+
+	/**
+	 * Let go of a staged chunk's neighbours, once it's complete or cancelled.
+	 * @param Request - The staged chunk's request.
+	 */
+	void ReleaseStageDependencies(FFGChunkLoadRequest& Request);
+
+	/** Block until every chunk generating in the background has finished. */
+	void WaitForGeneration();
+
+	/**
+	 * How many more chunks we can start generating this tick, from the measured generation cost.
+	 * @param NumCandidates - How many chunks are waiting.
+	 * @return The number of chunks to admit.
+	 */
+	int32 GetGenerationAdmission(int32 NumCandidates) const;
+
+	/**
+	 * Reserve a slot in the chunk storage for a handle, reusing freed slots first.
+	 * @param ChunkHandle - The handle to assign the slot to.
+	 */
+	void AssignChunkSlot(FFGChunkHandle ChunkHandle);
+
+	/**
+	 * Point a handle at a chunk slot and map it's coordinate to the slot.
+	 * @param ChunkHandle - The handle to bind.
+	 * @param ChunkDataIndex - The slot to bind it to.
+	 */
+	void BindChunkSlot(FFGChunkHandle ChunkHandle, int32 ChunkDataIndex);
+
+	/**
+	 * Link a chunk to every loaded face neighbour, both ways.
+	 * @param ChunkHandle - The chunk that was just bound to a slot.
+	 */
+	void LinkChunkNeighbours(FFGChunkHandleData& ChunkHandle);
+
+	/**
+	 * Hand a released chunk's slot to the cache instead of freeing it.
+	 * @param ChunkKey - The chunk that was released.
+	 * @param ChunkDataIndex - The slot it lives in.
+	 */
+	void RetainChunkSlot(FFGChunkKey ChunkKey, int32 ChunkDataIndex);
+
+	/** Evict cached chunks until the cache fits it's budgets, retiring their slots. */
+	void TrimChunkCache();
+
+	/**
+	 * Queue a chunk to be saved if it was edited since it was last saved.
+	 * @param ChunkCoordinate - The chunk coordinate.
+	 * @param ChunkData - The chunk, it's Modified flag is cleared.
+	 */
+	void SaveChunkIfModified(FIntVector ChunkCoordinate, FFGVoxelChunk& ChunkData);
+
+	/** Flush the edit journal and checkpoint it into the region files when it's due. */
+	void TickEditJournal(float DeltaTime);
+
+	/** Save every modified chunk and fold the journal into the region files. */
+	void CheckpointEditJournal();
+
+	/** Create or destroy the region store and journal to match FG.VoxelPersistence. */
+	void UpdatePersistence();
+
+	/**
+	 * Find a column's surface summary, asking the generator for it the first time.
+	 * @param ChunkColumn - XY chunk coordinate of the column.
+	 * @return The summary, or nullptr if the generator can't predict the surface.
+	 */
+	FFGColumnSummary* FindOrAddColumnSummary(FIntVector2 ChunkColumn);
+
+	/**
+	 * Bring a column's surface up to date with every voxel column of a chunk, after it loaded with edits.
+	 * @param ChunkHandle - The generated chunk.
+	 */
+	void RefreshColumnSummary(const FFGChunkHandleData& ChunkHandle);
+
+	/**
+	 * Bring one voxel column's surface up to date with a chunk, walking down through loaded chunks if it dropped.
+	 * @param Summary - The chunk's column summary.
+	 * @param ChunkHandle - The generated chunk.
+	 * @param VoxelX - Voxel X inside the chunk.
+	 * @param VoxelY - Voxel Y inside the chunk.
+	 */
+	void RefreshSurfaceVoxel(FFGColumnSummary& Summary, const FFGChunkHandleData& ChunkHandle, int32 VoxelX, int32 VoxelY);
+
+	/** Drop the summaries furthest from every viewer once there are more than FG.ColumnSummaryBudget. */
+	void TrimColumnSummaries();
+
+	/** How many chunks are allocated per page of chunk storage. */
+	static constexpr int32 ChunksPerPage = 256;
 	
-	TMap<FIntVector, TWeakPtr<FFGChunkHandleData>> ActiveChunkHandles;
+	/** Packed chunk key to chunk slot, for every loaded chunk. */
+	Experimental::TRobinHoodHashMap<FFGChunkKey, int32> ActiveChunkSlots;
+
+	/** The handle that currently owns each chunk slot, indexed by ChunkDataIndex. */
+	TArray<TWeakPtr<FFGChunkHandleData>> SlotHandles;
+
+	/** Snapshot of ActiveChunkSlots for worker threads, also defers slot reuse until readers drain. */
+	FFGChunkIndex ChunkIndex;
+
+	/** Generated chunks nobody holds a handle to anymore, kept around until memory pressure evicts them. */
+	FFGChunkCache ChunkCache;
+
+	/** Region files for saved chunks, null when persistence is off or outside of game worlds. */
+	TUniquePtr<FFGRegionStore> RegionStore;
+
+	/** Write ahead log of edits, declared after RegionStore as it must be destroyed first. */
+	TUniquePtr<FFGEditJournal> EditJournal;
+
+	/** Seconds since the journal was last flushed / checkpointed. */
+	float JournalFlushTimer = 0.0f;
+	float JournalCheckpointTimer = 0.0f;
+
+	/** Surface summary per XY chunk column, rebuilt from the generator if trimmed. Game thread only. */
+	TMap<FIntVector2, TUniquePtr<FFGColumnSummary>> ColumnSummaries;
+
+	/** Chunks waiting to be generated, re-scored by viewer distance every tick. */
+	TMap<FFGChunkKey, FFGChunkLoadRequest> PendingRequests;
+
+	/** Chunks generating on background tasks, kept here so new requests can merge onto them. */
+	TMap<FFGChunkKey, FFGChunkLoadRequest> InFlightRequests;
+
+	/** Chunks past Terrain working their way through the generator's later stages. */
+	TMap<FFGChunkKey, FFGChunkLoadRequest> StagedChunks;
+
+	/** How many stages are running on background tasks, they share the generation budget. */
+	int32 NumRunningStages = 0;
+
+	/** Chunks that finished generating, pushed from any thread and drained on the game thread. */
+	TMpscQueue<FFGCompletedChunk> CompletedChunks;
+
+	/** How many entries are in CompletedChunks, the queue can't count itself. */
+	std::atomic<int32> NumCompletedChunks = 0;
+
+	/** Rolling average cost per chunk of each stage. */
+	double StageCostMs[(int32)EFGChunkStage::Num] = {};
+	bool StageCostSampled[(int32)EFGChunkStage::Num] = {};
+
+	/** Loads that merged onto an already generated chunk, their callbacks fire next tick. */
+	TArray<TPair<TWeakPtr<FFGVoxelLoadHandleData>, FFGChunkHandle>> ReadyChunks;
+
+	/** Chunk coordinates of every viewer, refreshed each tick. */
+	TArray<FIntVector, TInlineAllocator<8>> ViewerCoordinates;
+
+	uint64 NextRequestSequence = 0;
 
 	// @TODO: Review default ctor! Unitinialized values
 	// @TODO: Don't think we wanna use mutex for chunk locking, use futures.
 	
-	int32							InternalNumPending;
 	volatile int32					InternalChunkCount;
-	TArray<FFGVoxelChunk>	        InternalChunkData;
+	TFGPagedArray<FFGVoxelChunk, ChunksPerPage> InternalChunkData;
 	TArray<FIntVector>				InternalGarbageChunks;
 	TArray<int32>			        InternalChunkFreelist;
-	TArray<FFGVoxelLoadHandle>		InternalLoadHandles;
 };
@@ -44,6 +44,7 @@ public class FGVoxel : ModuleRules
 			"GeometryFramework",
 			"GameplayAbilities",
 			"GameplayTags",
+			"Json",
 		});
 
 		if (Target.bBuildEditor)
@@ -8,11 +8,14 @@
 #include "FGVoxelDefines.generated.h"
 
 enum { VOXELTYPE_NONE = NULL };	// Empty voxel (air)
+enum { VOXELTYPE_MAX = MAX_uint16 };	// Highest voxel type a chunk can hold, whole chunks are encoded and decoded as uint16.
 
 enum class EFGChunkFlags : uint32
 {
 	NoFlags,
 	Generated = 1 << 0, // Chunk finished it's generation.
+	Modified = 1 << 1,	// Chunk was edited since it was last saved.
+	Edited = 1 << 2,	// Chunk differs from the generator's output, edited or loaded from a save.
 };
 ENUM_CLASS_FLAGS(EFGChunkFlags)
 
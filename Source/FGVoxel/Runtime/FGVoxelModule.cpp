@@ -5,9 +5,13 @@
 
 #include "Modules/ModuleManager.h"
 #include "Misc/CoreDelegates.h"
+#include "Generators/FGVoxelNoise.h"
+#include "Logging/StructuredLog.h"
 
 void FFGVoxelModule::StartupModule()
 {
+	UE_LOGFMT(LogTemp, Log, "FGVoxel noise SIMD level {Level}", FG::GetNoiseSIMDLevelName(FG::GetNoiseSIMDLevel()));
+
 	//const FString ShaderDirectory = FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders"));
 	//AddShaderSourceDirectoryMapping(TEXT("/Project"), ShaderDirectory);
 
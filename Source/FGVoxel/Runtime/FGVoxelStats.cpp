@@ -0,0 +1,34 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelStats.h"
+
+DEFINE_STAT(STAT_FGVoxel_Remeshes);
+DEFINE_STAT(STAT_FGVoxel_RenderLoads);
+DEFINE_STAT(STAT_FGVoxel_PrefetchLoads);
+
+CSV_DEFINE_CATEGORY_MODULE(FGVOXEL_API, FGVoxel, true);
+
+#if UE_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_DEFINE(FGVoxelChannel);
+
+UE_TRACE_EVENT_BEGIN(FGVoxel, ChunkStage)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(int32, X)
+	UE_TRACE_EVENT_FIELD(int32, Y)
+	UE_TRACE_EVENT_FIELD(int32, Z)
+	UE_TRACE_EVENT_FIELD(uint8, Stage)
+UE_TRACE_EVENT_END()
+
+void FG::TraceChunkStage(FIntVector ChunkCoordinate, EFGChunkTraceStage Stage)
+{
+	UE_TRACE_LOG(FGVoxel, ChunkStage, FGVoxelChannel)
+		<< ChunkStage.Cycle(FPlatformTime::Cycles64())
+		<< ChunkStage.X(ChunkCoordinate.X)
+		<< ChunkStage.Y(ChunkCoordinate.Y)
+		<< ChunkStage.Z(ChunkCoordinate.Z)
+		<< ChunkStage.Stage((uint8)Stage);
+}
+
+#endif
@@ -0,0 +1,62 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Trace/Trace.h"
+
+/**
+ * Profiling hooks for the voxel pipeline.
+ *
+ * Stats live in the FGVoxelGrid group (stat FGVoxelGrid). The same numbers are
+ * also written as CSV custom stats in the FGVoxel category, which works on
+ * dedicated servers where there's no stat display (csvprofile start/stop).
+ *
+ * Per chunk lifetimes go to the FGVoxel trace channel (-trace=default,fgvoxel),
+ * one ChunkStage event with a cycle timestamp each time a chunk moves through
+ * EFGChunkTraceStage, so a capture can line up request to visible per chunk.
+ */
+DECLARE_STATS_GROUP(TEXT("FGVoxelGrid"), STATGROUP_FGVoxelGrid, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Remeshes"),			STAT_FGVoxel_Remeshes,		STATGROUP_FGVoxelGrid, FGVOXEL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Render Loads"),		STAT_FGVoxel_RenderLoads,	STATGROUP_FGVoxelGrid, FGVOXEL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Prefetch Loads"),	STAT_FGVoxel_PrefetchLoads,	STATGROUP_FGVoxelGrid, FGVOXEL_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(FGVOXEL_API, FGVoxel);
+
+/** Points in a chunk's life recorded on the FGVoxel trace channel. */
+enum class EFGChunkTraceStage : uint8
+{
+	Requested,		// First asked for, no handle existed yet.
+	GenerateStart,
+	GenerateEnd,
+	Loaded,			// Handed to the loads that asked for it.
+	MeshStart,
+	MeshEnd,
+	Visible,		// Mesh handed to the renderer.
+};
+
+#if UE_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_EXTERN(FGVoxelChannel, FGVOXEL_API);
+
+namespace FG
+{
+	/**
+	 * Record a chunk reaching a stage, any thread. Does nothing unless the FGVoxel channel is on.
+	 * @param ChunkCoordinate The chunk.
+	 * @param Stage The stage it just reached.
+	 */
+	FGVOXEL_API void TraceChunkStage(FIntVector ChunkCoordinate, EFGChunkTraceStage Stage);
+}
+
+#else
+
+namespace FG
+{
+	FORCEINLINE void TraceChunkStage(FIntVector ChunkCoordinate, EFGChunkTraceStage Stage) {}
+}
+
+#endif
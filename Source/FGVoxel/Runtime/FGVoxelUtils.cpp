@@ -104,7 +104,7 @@ int32 UFGVoxelUtils::GetVoxelTypeAtLocation(UWorld* World, const FVector& VoxelL
 	//	FLinearColor::Blue,
 	//	0.25);
 	
-	FFGChunkHandle ChunkHandle = VoxelGrid->FindChunk(ChunkCoordinate);
+	FFGChunkHandle ChunkHandle = VoxelGrid->FindGeneratedChunk(ChunkCoordinate);
 	
 	if(ChunkHandle.IsValid())
 	{
@@ -113,6 +113,26 @@ int32 UFGVoxelUtils::GetVoxelTypeAtLocation(UWorld* World, const FVector& VoxelL
 	return VOXELTYPE_NONE;
 }
 
+bool UFGVoxelUtils::GetSurfaceLocation(UWorld* World, const FVector& Location, FVector& OutSurfaceLocation)
+{
+	auto* VoxSys = World->GetSubsystem<UFGVoxelSystem>();
+	if(!VoxSys || !VoxSys->VoxelGrid->HasGenerator())
+	{
+		return false;
+	}
+
+	const FIntVector2 VoxelXY(FMath::FloorToInt32(Location.X / VoxelSizeUU), FMath::FloorToInt32(Location.Y / VoxelSizeUU));
+
+	int32 SurfaceVoxelZ;
+	if(!VoxSys->VoxelGrid->GetSurfaceVoxelZ(VoxelXY, SurfaceVoxelZ))
+	{
+		return false;
+	}
+
+	OutSurfaceLocation = FVector(Location.X, Location.Y, (SurfaceVoxelZ + 1) * VoxelSizeUU);
+	return true;
+}
+
 TOptional<FFGVoxelRayHit> UFGVoxelUtils::RayVoxelIntersection(UWorld* World, const FVector Start, const FVector End)
 {
     FVector RayDirection = (End - Start).GetSafeNormal();
@@ -154,9 +174,44 @@ TOptional<FFGVoxelRayHit> UFGVoxelUtils::RayVoxelIntersection(UWorld* World, con
 		return TOptional<FFGVoxelRayHit>();
 	}
 
+	// Only look the chunk up again when the ray crosses into a new one.
+	FIntVector CachedChunkCoordinate = FIntVector(MAX_int32);
+	FFGChunkHandleData* CachedHandle = nullptr;
+	FFGVoxelChunk* CachedChunk = nullptr;
+
     while (true)
     {
-        if (GetVoxelTypeAtLocation(World, FVector(TargetVoxel) * VoxelSizeUU) > VOXELTYPE_NONE)
+        const FVector VoxelLocation = FVector(TargetVoxel) * VoxelSizeUU;
+        const FIntVector StepChunkCoordinate = VectorToChunkCoord(VoxelLocation);
+
+        if (StepChunkCoordinate != CachedChunkCoordinate)
+        {
+            // We step one axis at a time so the new chunk is a face neighbour, follow it's link if we can.
+            const FIntVector ChunkStep = StepChunkCoordinate - CachedChunkCoordinate;
+            const int32 StepAxis = ChunkStep.X != 0 ? 0 : ChunkStep.Y != 0 ? 1 : 2;
+
+            if (CachedHandle && FMath::Abs(ChunkStep.X) + FMath::Abs(ChunkStep.Y) + FMath::Abs(ChunkStep.Z) == 1)
+            {
+                CachedHandle = CachedHandle->GetNeighbour((EFGChunkFace)(StepAxis * 2 + (ChunkStep[StepAxis] < 0)));
+            }
+            else
+            {
+                CachedHandle = VoxSys->VoxelGrid->FindChunk(StepChunkCoordinate).Get();
+            }
+
+            CachedChunkCoordinate = StepChunkCoordinate;
+            // Neighbour links include chunks a worker is still writing, those read as air like unloaded ones.
+            CachedChunk = CachedHandle && CachedHandle->Generated ? CachedHandle->ChunkData : nullptr;
+        }
+
+        uint32 VoxelType = VOXELTYPE_NONE;
+        if (CachedChunk)
+        {
+            // Uniform chunks answer for every voxel without touching voxel data.
+            VoxelType = CachedChunk->IsUniform() ? CachedChunk->GetUniformType() : CachedChunk->GetVoxel(VectorToVoxelCoord(VoxelLocation));
+        }
+
+        if (VoxelType > VOXELTYPE_NONE)
         {
             FVector VoxelCenter = FVector(TargetVoxel) * VoxelSizeUU + FVector(VoxelSizeUU / 2.0f);
             return FFGVoxelRayHit(Start, End, VoxelCenter, CurrentPosition, LastStepDirection);
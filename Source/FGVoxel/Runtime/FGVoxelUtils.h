@@ -238,6 +238,15 @@ public:
 	 */
 	static FGVOXEL_API int32 GetVoxelTypeAtLocation(UWorld* World, const FVector& VoxelLocation);
 
+	/**
+	 * Find the top of the terrain under a location without generating any chunks, for spawn placement and the like.
+	 * @param World The world to check against.
+	 * @param Location The location to check under, only X and Y are used.
+	 * @param OutSurfaceLocation The location on top of the top-most solid voxel.
+	 * @returns false if the surface can't be predicted here or there is nothing solid.
+	 */
+	static FGVOXEL_API bool GetSurfaceLocation(UWorld* World, const FVector& Location, FVector& OutSurfaceLocation);
+
 	/**
 	 * Raycast traversal into a voxel grid using DDA algorithm.
 	 * @param World The world to check against.
@@ -4,7 +4,47 @@
 #include "FGVoxelGenerator.h"
 #include "Containers/FGVoxelGrid.h"
 
+void UFGVoxelGenerator::Generate(FFGVoxelChunk& ChunkData, FFGChunkHandle ChunkHandle)
+{
+	const TArrayView<uint16> Voxels = GetScratchVoxels();
+	if(GenerateVoxels(ChunkHandle->ChunkCoordinate, Voxels))
+	{
+		ChunkData.EncodeAll(Voxels);
+	}
+}
+
+void UFGVoxelGenerator::GenerateBatch(TConstArrayView<FFGChunkHandle> ChunkHandles)
+{
+	for(const FFGChunkHandle& ChunkHandle : ChunkHandles)
+	{
+		Generate(*ChunkHandle->ChunkData, ChunkHandle);
+	}
+}
+
+EFGGenerationStage UFGVoxelGenerator::GetNextStage(EFGGenerationStage Stage) const
+{
+	for(int32 Next = (int32)Stage + 1; Next < (int32)EFGGenerationStage::Num; Next++)
+	{
+		if(GetStageNeighbourRadius((EFGGenerationStage)Next) != INDEX_NONE)
+		{
+			return (EFGGenerationStage)Next;
+		}
+	}
+	return EFGGenerationStage::Num;
+}
+
 UFGVoxelGrid* UFGVoxelGenerator::GetOwningVoxelGrid() const
 {
 	return CastChecked<UFGVoxelGrid>(GetOuter());
-}
\ No newline at end of file
+}
+
+TArrayView<uint16> UFGVoxelGenerator::GetScratchVoxels()
+{
+	// One per worker so chunks generate in parallel, kept around so we don't allocate per chunk.
+	static thread_local TArray<uint16> ScratchVoxels;
+	if(ScratchVoxels.IsEmpty())
+	{
+		ScratchVoxels.SetNumUninitialized(FG::Const::ChunkSizeXYZ);
+	}
+	return ScratchVoxels;
+}
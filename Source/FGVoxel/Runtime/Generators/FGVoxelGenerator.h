@@ -9,12 +9,173 @@
 struct FFGChunkHandleData;
 using FFGChunkHandle = TSharedPtr<FFGChunkHandleData>;
 
+/**
+ * Passes a chunk goes through on it's way to being generated, in order. Terrain is Generate and never
+ * looks outside of the chunk, the rest are optional and can read neighbours, see GenerateStage.
+ */
+enum class EFGGenerationStage : uint8
+{
+	Terrain,		// Base shape.
+	Carving,		// Caves and overhangs.
+	Ores,			// Ore veins.
+	Decoration,		// Trees and structures.
+	Finalization,	// Anything that needs the chunk and it's surroundings complete.
+	Num
+};
+
+/**
+ * The chunks a generation stage can see, the chunk being generated and every chunk within the stage's
+ * neighbour radius. Neighbours have all finished the previous stage and are read only, nothing else
+ * writes to any of them while the stage runs.
+ */
+struct FFGGenerationRegion
+{
+	FIntVector ChunkCoordinate = FIntVector::ZeroValue;
+	int32 Radius = 0;
+
+	/** Every chunk in the region, indexed by GetChunkIndex. */
+	TArray<FFGVoxelChunk*, TInlineAllocator<27>> Chunks;
+
+	/**
+	 * Get where a chunk is stored by it's offset from the centre.
+	 * @param Offset - Chunk offset, each axis -Radius to Radius.
+	 * @return Index into Chunks.
+	 */
+	int32 GetChunkIndex(FIntVector Offset) const
+	{
+		checkf(FMath::Abs(Offset.X) <= Radius && FMath::Abs(Offset.Y) <= Radius && FMath::Abs(Offset.Z) <= Radius,
+			TEXT("Offset %s is outside of the region!"), *Offset.ToString());
+
+		const int32 Size = Radius * 2 + 1;
+		return (Offset.X + Radius) + (Offset.Y + Radius) * Size + (Offset.Z + Radius) * Size * Size;
+	}
+
+	/** The chunk being generated, the only one that can be written. */
+	FFGVoxelChunk& GetChunk() const { return *Chunks[GetChunkIndex(FIntVector::ZeroValue)]; }
+
+	/**
+	 * Get a voxel by it's coordinate relative to the centre chunk, anywhere in the region.
+	 * @param VoxelCoordinate - The voxel coordinate relative to the centre chunk.
+	 * @return The voxel type.
+	 */
+	uint32 GetVoxel(FIntVector VoxelCoordinate) const
+	{
+		using namespace FG::Const;
+
+		const FIntVector Offset(
+			FMath::DivideAndRoundDown(VoxelCoordinate.X, ChunkSizeX),
+			FMath::DivideAndRoundDown(VoxelCoordinate.Y, ChunkSizeX),
+			FMath::DivideAndRoundDown(VoxelCoordinate.Z, ChunkSizeX));
+
+		return Chunks[GetChunkIndex(Offset)]->GetVoxel(FIntVector(
+			VoxelCoordinate.X & (ChunkSizeX - 1),
+			VoxelCoordinate.Y & (ChunkSizeX - 1),
+			VoxelCoordinate.Z & (ChunkSizeX - 1)));
+	}
+};
+
 UCLASS()
 class UFGVoxelGenerator : public UObject
 {
 	GENERATED_BODY()
 public:
 	
-	virtual void Generate(TArray<FFGVoxelChunk> &ChunkData, FFGChunkHandle ChunkHandle) {}
+	/**
+	 * Look up the voxel types the generator paints with, so generating never goes through the gameplay
+	 * tags manager. Called when the generator is created if voxel types are already known, and again
+	 * whenever GVoxelTypeMap is rebuilt.
+	 */
+	virtual void ResolveVoxelTypes() {}
+
+	/**
+	 * Generate the voxels for a single chunk.
+	 * Defaults to GenerateVoxels into a scratch buffer, then encoding it into the chunk in one go.
+	 * @param ChunkData - The chunk to write to, starts off as uniform air.
+	 * @param ChunkHandle - The handle of the chunk being generated.
+	 */
+	virtual void Generate(FFGVoxelChunk& ChunkData, FFGChunkHandle ChunkHandle);
+
+	/**
+	 * Write a whole chunk of voxel types to a flat buffer, the cheap way to generate. Plain loops over
+	 * the buffer vectorize, where SetVoxel pays for a palette search and ref counting on every voxel.
+	 * @param ChunkCoordinate - The chunk being generated.
+	 * @param OutVoxels - ChunkSizeXYZ voxel types in voxel index order, every one must be written.
+	 * @return false if the generator doesn't support it, the chunk is left as air.
+	 */
+	virtual bool GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const { return false; }
+
+	/**
+	 * Generate several chunks in one go, so work like noise can be shared across them. Chunks near
+	 * each other are batched together, but nothing stops a batch from being scattered.
+	 * Defaults to generating each chunk on it's own.
+	 * @param ChunkHandles - The chunks to generate, each starts off as uniform air.
+	 */
+	virtual void GenerateBatch(TConstArrayView<FFGChunkHandle> ChunkHandles);
+
+	/**
+	 * How far a stage needs to see around the chunk it's generating, in chunks. Before a chunk runs a stage,
+	 * every chunk within the radius is generated up to the stage before it, like a status ladder.
+	 * Terrain is always 0, later stages default to unused.
+	 * @param Stage - The stage.
+	 * @return The radius, or INDEX_NONE if the generator doesn't use the stage.
+	 */
+	virtual int32 GetStageNeighbourRadius(EFGGenerationStage Stage) const { return Stage == EFGGenerationStage::Terrain ? 0 : INDEX_NONE; }
+
+	/**
+	 * Run a stage after Terrain for one chunk, on a worker thread. Only the centre chunk may be written,
+	 * so a feature crossing a border is painted by every chunk it touches, from inputs each can see
+	 * like the feature's origin. Anything a neighbour's own run of the stage writes may or may not be
+	 * there yet, so only rely on what earlier stages made.
+	 * @param Stage - The stage to run, one GetStageNeighbourRadius says is used.
+	 * @param Region - The chunk and it's neighbours.
+	 */
+	virtual void GenerateStage(EFGGenerationStage Stage, const FFGGenerationRegion& Region) {}
+
+	/**
+	 * Does a chunk need the later stages at all, now Terrain has made it? Chunks that don't skip straight
+	 * to done without waiting on their neighbours, so say no wherever no stage would write anything.
+	 * @param ChunkData - The chunk as Terrain left it.
+	 * @param ChunkCoordinate - The chunk's coordinate.
+	 * @return false if every later stage would leave the chunk as it is.
+	 */
+	virtual bool NeedsLaterStages(const FFGVoxelChunk& ChunkData, FIntVector ChunkCoordinate) const { return true; }
+
+	/**
+	 * Does the generator use any stage after Terrain?
+	 * @return true if chunks need the grid to run more stages after Generate.
+	 */
+	bool HasLaterStages() const { return GetNextStage(EFGGenerationStage::Terrain) != EFGGenerationStage::Num; }
+
+	/**
+	 * Get the next stage the generator uses.
+	 * @param Stage - The stage just finished.
+	 * @return The next used stage, Num once there are none left.
+	 */
+	EFGGenerationStage GetNextStage(EFGGenerationStage Stage) const;
+
+	/**
+	 * Identifies this generator's Terrain output, saved chunks are stored as deltas against it.
+	 * Two generators with the same id must Generate the same voxels for every chunk, so mix in a version
+	 * that's bumped whenever the output changes.
+	 * @return The baseline id, or 0 if the output isn't deterministic and chunks must be saved in full.
+	 */
+	virtual uint32 GetBaselineId() const { return 0; }
+
+	/**
+	 * Predict the surface of a column of chunks without generating them, so the air above it can be skipped.
+	 * Called on the game thread the first time a column is used, so keep it cheap. Must never report a
+	 * voxel column lower than Generate and every later stage would make it.
+	 * @param ChunkColumn - XY chunk coordinate of the column.
+	 * @param OutTopVoxelZ - World voxel Z of the top-most solid voxel in each voxel column, indexed by
+	 *                       FlattenVoxelCoord2D. MIN_int32 where a voxel column has nothing solid.
+	 * @return false if the surface can't be predicted, every chunk in the column is then generated.
+	 */
+	virtual bool GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const { return false; }
+
 	UFGVoxelGrid* GetOwningVoxelGrid() const;
+
+protected:
+
+	/** ChunkSizeXYZ voxel types for the calling thread to generate into, contents are left over from the last use. */
+	static TArrayView<uint16> GetScratchVoxels();
 };
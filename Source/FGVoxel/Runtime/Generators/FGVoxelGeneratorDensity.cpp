@@ -0,0 +1,331 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelGeneratorDensity.h"
+#include "FGVoxelNoise.h"
+#include "FastNoise/FastNoise.h"
+#include "GameplayTagsManager.h"
+#include "Containers/FGVoxelGrid.h"
+
+namespace FG::Private
+{
+	static constexpr int32 DensitySeed = 1337;
+	static constexpr int32 CheeseSeed = 7331;
+	static constexpr int32 WormSeedA = 4242;
+	static constexpr int32 WormSeedB = 2424;
+
+	/** Part of the baseline id, bump it whenever Generate's output changes. */
+	static constexpr uint32 DensityVersion = 1;
+
+	/** Lattice spacing in voxels, PaintChunk upsamples a lattice cell as one 4 wide vector along Z. */
+	static constexpr int32 DensityLatticeStep = 4;
+
+	/** Lattice points along each axis, the far face is shared with the next chunk over. */
+	static constexpr int32 DensityLatticeSize = FG::Const::ChunkSizeX / DensityLatticeStep + 1;
+	static constexpr int32 DensityLatticeSizeXYZ = DensityLatticeSize * DensityLatticeSize * DensityLatticeSize;
+
+	/**
+	 * Most noise samples a chunk may cost, the terrain and three cave fields over the whole lattice.
+	 * Upsampling is a fixed amount of work per voxel, so this is what caps the cost of a chunk.
+	 */
+	static constexpr int32 DensityMaxSamplesPerChunk = 4096;
+	static_assert(DensityLatticeSizeXYZ * 4 <= DensityMaxSamplesPerChunk, "Density lattice is over the per chunk noise budget!");
+
+	/** Per voxel, the same scale as the natural generator's hills. */
+	static constexpr float DensityTerrainFrequency = 0.01f;
+
+	/** World voxel Z the height bias is centred on, and how many voxels it takes to outweigh the noise. */
+	static constexpr int32 DensitySurfaceVoxelZ = 0;
+	static constexpr float DensityHeightFalloff = 16.f;
+
+	static constexpr float CheeseFrequency = 0.02f;
+	static constexpr float CheeseThreshold = 0.55f;	// Open wherever the cheese noise is above this.
+	static constexpr float WormFrequency = 0.015f;
+	static constexpr float WormRadius = 0.06f;		// Open wherever both worm fields are this close to zero.
+
+	/** Caves only open where the terrain density is above this, so they stay under the surface. */
+	static constexpr float CaveRoof = 0.3f;
+
+	/**
+	 * Highest world voxel Z that can ever be solid. The terrain noise is clamped to +-1, so a lattice point
+	 * is only solid below DensitySurfaceVoxelZ + DensityHeightFalloff, and upsampling can carry that up to a cell higher.
+	 */
+	static constexpr int32 DensityTopVoxelZ = DensitySurfaceVoxelZ + (int32)DensityHeightFalloff + DensityLatticeStep - 2;
+
+	/** What a chunk's lattice says about it. */
+	enum class EDensityFill : uint8
+	{
+		Air,	// Every lattice point is open.
+		Solid,	// Every lattice point is solid.
+		Mixed,	// Needs upsampling.
+	};
+
+	/**
+	 * The density noise tree for the calling thread, see GetNaturalNoise for why it's per thread.
+	 * Rebuilt if FG.Voxel.NoiseSIMDLevel changes.
+	 */
+	static const FastNoise::SmartNode<>& GetDensityNoise()
+	{
+		thread_local FastNoise::SmartNode<> SimplexNoise;
+		thread_local FastSIMD::eLevel SimplexLevel = FastSIMD::Level_Null;
+
+		const FastSIMD::eLevel Level = FG::GetNoiseSIMDLevel();
+		if(Level != SimplexLevel)
+		{
+			SimplexNoise = FastNoise::NewFromEncodedNodeTree(UFGVoxelGeneratorDensity::DensityNoiseTree, Level);
+			SimplexLevel = Level;
+		}
+		return SimplexNoise;
+	}
+
+	/**
+	 * Sample one noise field at every lattice point of a chunk.
+	 * FastNoise runs X innermost and voxels run Z innermost, so the axes are handed over reversed,
+	 * the noise doesn't care which way round it's sampled.
+	 * @param ChunkCoordinate The chunk.
+	 * @param Frequency Noise frequency per voxel.
+	 * @param Seed Noise seed.
+	 * @param OutNoise DensityLatticeSizeXYZ samples, indexed Z + Y * Size + X * Size * Size.
+	 */
+	static void GenerateLatticeNoise(FIntVector ChunkCoordinate, float Frequency, int32 Seed, float* RESTRICT OutNoise)
+	{
+		using namespace FG::Const;
+
+		const FIntVector Start = ChunkCoordinate * (ChunkSizeX / DensityLatticeStep);
+
+		GetDensityNoise()->GenUniformGrid3D(
+			OutNoise,
+			Start.Z,
+			Start.Y,
+			Start.X,
+			DensityLatticeSize,
+			DensityLatticeSize,
+			DensityLatticeSize,
+			Frequency * DensityLatticeStep,
+			Seed);
+	}
+
+	/**
+	 * Density at every lattice point of a chunk, solid above zero.
+	 * @param ChunkCoordinate The chunk.
+	 * @param OutLattice DensityLatticeSizeXYZ densities, indexed like GenerateLatticeNoise.
+	 * @return Air or Solid if every lattice point agrees. Upsampling only blends lattice points, so the whole chunk does too.
+	 */
+	static EDensityFill GenerateDensityLattice(FIntVector ChunkCoordinate, float* RESTRICT OutLattice)
+	{
+		using namespace FG::Const;
+
+		GenerateLatticeNoise(ChunkCoordinate, DensityTerrainFrequency, DensitySeed, OutLattice);
+
+		// Height bias of each lattice layer, falls off above the surface and climbs below it.
+		TStaticArray<float, DensityLatticeSize> HeightBias;
+		for(int32 LatticeZ = 0; LatticeZ < DensityLatticeSize; LatticeZ++)
+		{
+			const int32 VoxelZ = ChunkCoordinate.Z * ChunkSizeX + LatticeZ * DensityLatticeStep;
+			HeightBias[LatticeZ] = (DensitySurfaceVoxelZ - VoxelZ) / DensityHeightFalloff;
+		}
+
+		float MaxDensity = -UE_MAX_FLT;
+		for(int32 Line = 0; Line < DensityLatticeSize * DensityLatticeSize; Line++)
+		{
+			float* RESTRICT Densities = OutLattice + Line * DensityLatticeSize;
+			for(int32 LatticeZ = 0; LatticeZ < DensityLatticeSize; LatticeZ++)
+			{
+				Densities[LatticeZ] = FMath::Clamp(Densities[LatticeZ], -1.f, 1.f) + HeightBias[LatticeZ];
+				MaxDensity = FMath::Max(MaxDensity, Densities[LatticeZ]);
+			}
+		}
+
+		// Caves only remove, so a chunk that's all air already is done, most of the sky stops here.
+		if(MaxDensity <= 0.f)
+		{
+			return EDensityFill::Air;
+		}
+
+		// Carving below takes the min of the terrain and CaveRoof - terrain, which can't win until the
+		// terrain is over half of CaveRoof. Chunks near the surface skip the cave noise without changing a thing.
+		if(MaxDensity > CaveRoof * 0.5f)
+		{
+			TStaticArray<float, DensityLatticeSizeXYZ> Cheese;
+			TStaticArray<float, DensityLatticeSizeXYZ> WormA;
+			TStaticArray<float, DensityLatticeSizeXYZ> WormB;
+
+			GenerateLatticeNoise(ChunkCoordinate, CheeseFrequency, CheeseSeed, Cheese.GetData());
+			GenerateLatticeNoise(ChunkCoordinate, WormFrequency, WormSeedA, WormA.GetData());
+			GenerateLatticeNoise(ChunkCoordinate, WormFrequency, WormSeedB, WormB.GetData());
+
+			for(int32 Point = 0; Point < DensityLatticeSizeXYZ; Point++)
+			{
+				const float CheeseDensity = CheeseThreshold - Cheese[Point];
+				const float WormDensity = FMath::Max(FMath::Abs(WormA[Point]), FMath::Abs(WormB[Point])) - WormRadius;
+
+				// Fade the caves out as the terrain thins towards the surface, rather than cutting them off.
+				const float CaveDensity = FMath::Max(FMath::Min(CheeseDensity, WormDensity), CaveRoof - OutLattice[Point]);
+				OutLattice[Point] = FMath::Min(OutLattice[Point], CaveDensity);
+			}
+		}
+
+		float MinDensity = UE_MAX_FLT;
+		MaxDensity = -UE_MAX_FLT;
+		for(int32 Point = 0; Point < DensityLatticeSizeXYZ; Point++)
+		{
+			MinDensity = FMath::Min(MinDensity, OutLattice[Point]);
+			MaxDensity = FMath::Max(MaxDensity, OutLattice[Point]);
+		}
+
+		if(MaxDensity <= 0.f)
+		{
+			return EDensityFill::Air;
+		}
+		return MinDensity > 0.f ? EDensityFill::Solid : EDensityFill::Mixed;
+	}
+}
+
+void UFGVoxelGeneratorDensity::ResolveVoxelTypes()
+{
+	UGameplayTagsManager& TagMgr = UGameplayTagsManager::Get();
+
+	GrassId = GVoxelTypeMap.FindChecked(TagMgr.RequestGameplayTag("Voxel.FG.Grass"));
+	DirtId = GVoxelTypeMap.FindChecked(TagMgr.RequestGameplayTag("Voxel.FG.Dirt"));
+}
+
+void UFGVoxelGeneratorDensity::Generate(FFGVoxelChunk& ChunkData, FFGChunkHandle ChunkHandle)
+{
+	using namespace FG::Private;
+
+	checkf(DirtId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+
+	TStaticArray<float, DensityLatticeSizeXYZ> Lattice;
+	switch(GenerateDensityLattice(ChunkHandle->ChunkCoordinate, Lattice.GetData()))
+	{
+	case EDensityFill::Air:
+		break; // Chunks start off as air.
+
+	case EDensityFill::Solid:
+		ChunkData.Fill(DirtId); // Nothing above is open, so there's no grass.
+		break;
+
+	case EDensityFill::Mixed:
+		{
+			const TArrayView<uint16> Voxels = GetScratchVoxels();
+			PaintChunk(Voxels, Lattice.GetData());
+			ChunkData.EncodeAll(Voxels);
+		}
+		break;
+	}
+}
+
+bool UFGVoxelGeneratorDensity::GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const
+{
+	using namespace FG::Private;
+
+	checkf(DirtId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+
+	TStaticArray<float, DensityLatticeSizeXYZ> Lattice;
+	switch(GenerateDensityLattice(ChunkCoordinate, Lattice.GetData()))
+	{
+	case EDensityFill::Air:
+		FMemory::Memzero(OutVoxels.GetData(), OutVoxels.NumBytes());
+		break;
+
+	case EDensityFill::Solid:
+		for(uint16& Voxel : OutVoxels)
+		{
+			Voxel = (uint16)DirtId;
+		}
+		break;
+
+	case EDensityFill::Mixed:
+		PaintChunk(OutVoxels, Lattice.GetData());
+		break;
+	}
+	return true;
+}
+
+bool UFGVoxelGeneratorDensity::GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const
+{
+	// Overhangs mean there's no cheap exact surface, but the height bias puts a hard ceiling on it,
+	// which is all skipping the air above needs. Surface lookups land a few voxels high and fall.
+	for(int32& TopVoxelZ : OutTopVoxelZ)
+	{
+		TopVoxelZ = FG::Private::DensityTopVoxelZ;
+	}
+	return true;
+}
+
+void UFGVoxelGeneratorDensity::PaintChunk(TArrayView<uint16> OutVoxels, const float* RESTRICT Lattice) const
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	static_assert(DensityLatticeStep == 4, "PaintChunk upsamples a lattice cell per 4 wide vector!");
+	static_assert(ChunkSizeX < 64, "PaintChunk keeps a column and the voxel above it in a 64 bit mask!");
+
+	checkf(GrassId != VOXELTYPE_NONE && DirtId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+	checkf(OutVoxels.Num() == ChunkSizeXYZ, TEXT("PaintChunk expects a full chunk of voxels!"));
+
+	constexpr int32 Size = DensityLatticeSize;
+
+	// Where each voxel of a cell sits between it's two lattice points along Z.
+	const VectorRegister4Float CellFractions = MakeVectorRegisterFloat(0.f, 0.25f, 0.5f, 0.75f);
+	const VectorRegister4Float Zero = VectorZeroFloat();
+
+	const int32 Grass = GrassId;
+	const int32 Dirt = DirtId;
+	uint16* RESTRICT Voxels = OutVoxels.GetData();
+
+	for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+	{
+		const int32 CellX = VoxelX / DensityLatticeStep;
+		const float FracX = (VoxelX % DensityLatticeStep) / (float)DensityLatticeStep;
+
+		for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++, Voxels += ChunkSizeX)
+		{
+			const int32 CellY = VoxelY / DensityLatticeStep;
+			const float FracY = (VoxelY % DensityLatticeStep) / (float)DensityLatticeStep;
+
+			const float* RESTRICT Line00 = Lattice + (CellX * Size + CellY) * Size;
+			const float* RESTRICT Line01 = Line00 + Size;
+			const float* RESTRICT Line10 = Line00 + Size * Size;
+			const float* RESTRICT Line11 = Line10 + Size;
+
+			// Bilinear down to a single line of lattice points through this voxel column.
+			float Column[Size];
+			for(int32 LatticeZ = 0; LatticeZ < Size; LatticeZ++)
+			{
+				const float Near = FMath::Lerp(Line00[LatticeZ], Line01[LatticeZ], FracY);
+				const float Far = FMath::Lerp(Line10[LatticeZ], Line11[LatticeZ], FracY);
+				Column[LatticeZ] = FMath::Lerp(Near, Far, FracX);
+			}
+
+			// Then linear along Z a cell per vector, only keeping which voxels came out solid.
+			uint64 SolidMask = 0;
+			for(int32 Cell = 0; Cell < Size - 1; Cell++)
+			{
+				const VectorRegister4Float Low = VectorSetFloat1(Column[Cell]);
+				const VectorRegister4Float High = VectorSetFloat1(Column[Cell + 1]);
+				const VectorRegister4Float Density = VectorMultiplyAdd(VectorSubtract(High, Low), CellFractions, Low);
+
+				SolidMask |= (uint64)VectorMaskBits(VectorCompareGT(Density, Zero)) << (Cell * DensityLatticeStep);
+			}
+
+			// The last lattice point is the first voxel of the chunk above, so the top voxel knows if it's covered.
+			SolidMask |= (uint64)(Column[Size - 1] > 0.f) << ChunkSizeX;
+
+			// Grass where the voxel above is open, dirt under it.
+			for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++)
+			{
+				const int32 Solid = (int32)((SolidMask >> VoxelZ) & 1);
+				const int32 Covered = (int32)((SolidMask >> (VoxelZ + 1)) & 1);
+				Voxels[VoxelZ] = (uint16)(Solid * (Grass + (Dirt - Grass) * Covered));
+			}
+		}
+	}
+}
+
+uint32 UFGVoxelGeneratorDensity::GetBaselineId() const
+{
+	// Deterministic from the seeds, see UFGVoxelGeneratorNatural::GetBaselineId.
+	const uint32 ClassCrc = FCrc::StrCrc32(*GetClass()->GetPathName(), (uint32)FG::Private::DensitySeed);
+	return FCrc::MemCrc32(&FG::Private::DensityVersion, sizeof(FG::Private::DensityVersion), ClassCrc);
+}
@@ -0,0 +1,45 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "FGVoxelGenerator.h"
+#include "FGVoxelGeneratorDensity.generated.h"
+
+/**
+ * 3D terrain with overhangs and caves, where the natural generator is a 2D height map.
+ *
+ * Solid wherever a density is above zero. The density is 3D noise biased by height, so it falls off
+ * above the surface and climbs below it, with cheese caves (blobs) and worm caves (tunnels where two
+ * noise fields both cross zero) carved out of it. It's sampled on a coarse lattice and trilinearly
+ * upsampled, so the noise cost per chunk is fixed whatever the terrain looks like.
+ */
+UCLASS()
+class UFGVoxelGeneratorDensity : public UFGVoxelGenerator
+{
+	GENERATED_BODY()
+public:
+
+	/** FastNoise2 encoded node tree every density field is sampled from, plain simplex. */
+	static constexpr const char* DensityNoiseTree = "CAA=";
+
+	//~ Begin Super
+	virtual void ResolveVoxelTypes() override;
+	virtual void Generate(FFGVoxelChunk& ChunkData, FFGChunkHandle ChunkHandle) override;
+	virtual bool GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const override;
+	virtual bool GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const override;
+	virtual uint32 GetBaselineId() const override;
+	//~ End Super
+
+private:
+
+	/**
+	 * Fill a chunk's voxels from it's density lattice.
+	 * @param OutVoxels ChunkSizeXYZ voxel types to write to, in voxel index order.
+	 * @param Lattice Density at every lattice point of the chunk, Z innermost.
+	 */
+	void PaintChunk(TArrayView<uint16> OutVoxels, const float* RESTRICT Lattice) const;
+
+	int32 GrassId = VOXELTYPE_NONE;
+	int32 DirtId = VOXELTYPE_NONE;
+};
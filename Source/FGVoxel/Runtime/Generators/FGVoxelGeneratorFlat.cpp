@@ -7,33 +7,53 @@
 #include "Containers/FGVoxelGrid.h"
 #include "GameplayTagsManager.h"
 
-void UFGVoxelGeneratorFlat::Generate(TArray<FFGVoxelChunk>& ChunkData, FFGChunkHandle ChunkHandle)
+namespace FG::Private
+{
+	static constexpr double FlatTerrainHeight = -FG::Const::VoxelSizeUU; // Terrain height.
+}
+
+void UFGVoxelGeneratorFlat::ResolveVoxelTypes()
+{
+	GrassId = GVoxelTypeMap.FindChecked(UGameplayTagsManager::Get().RequestGameplayTag("Voxel.FG.Grass"));
+}
+
+bool UFGVoxelGeneratorFlat::GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const
 {
 	using namespace FG::Const;
 
-	Super::Generate(ChunkData, ChunkHandle);
-	
-	UGameplayTagsManager& TagMgr = UGameplayTagsManager::Get();
-	FGameplayTag GrassTagName = TagMgr.RequestGameplayTag("Voxel.FG.Grass");
-	int32 GrassId = GVoxelTypeMap.FindChecked(GrassTagName);
+	checkf(GrassId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+
+	static constexpr double TerrainHeight = FG::Private::FlatTerrainHeight;
+
+	FVector ChunkLocation = UFGVoxelUtils::ChunkCoordToVector(ChunkCoordinate);
+
+	// Every voxel column is the same, so paint one and copy it across the chunk.
+	uint16* RESTRICT Voxels = OutVoxels.GetData();
+	for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++)
+	{
+		float VoxelZHeight = ChunkLocation.Z + VoxelZ * VoxelSizeUU;
+		uint16 PaintType = VoxelZHeight < TerrainHeight;
+
+		Voxels[VoxelZ] = (uint16)(GrassId * PaintType);
+	}
+
+	for(int32 Column = 1; Column < ChunkSizeXY; Column++)
+	{
+		FMemory::Memcpy(Voxels + Column * ChunkSizeX, Voxels, ChunkSizeX * sizeof(uint16));
+	}
+	return true;
+}
+
+bool UFGVoxelGeneratorFlat::GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const
+{
+	using namespace FG::Const;
 
-	static constexpr double TerrainHeight = -VoxelSizeUU; // Terrain height.
+	// Solid while Z * VoxelSizeUU < TerrainHeight, same everywhere.
+	const int32 TopVoxelZ = FMath::CeilToInt32(FG::Private::FlatTerrainHeight / VoxelSizeUU) - 1;
 
-	FVector ChunkLocation = UFGVoxelUtils::ChunkCoordToVector(ChunkHandle->ChunkCoordinate);
-	FFGVoxelChunk* VoxelChunk = GetOwningVoxelGrid()->GetChunkDataUnsafe(ChunkHandle);
-	
-	int32 VoxelIndex = 0;
-	for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+	for(int32 Column = 0; Column < ChunkSizeXY; Column++)
 	{
-		for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++)
-		{
-			for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++, VoxelIndex++)
-			{
-				float VoxelZHeight = ChunkLocation.Z + VoxelZ * VoxelSizeUU;
-				int32 PaintType = VoxelZHeight < TerrainHeight;
-
-				VoxelChunk->SetVoxel(VoxelIndex, GrassId * PaintType);
-			}
-		}
+		OutTopVoxelZ[Column] = TopVoxelZ;
 	}
+	return true;
 }
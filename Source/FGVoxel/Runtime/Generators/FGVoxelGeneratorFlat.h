@@ -13,6 +13,12 @@ class UFGVoxelGeneratorFlat : public UFGVoxelGenerator
 public:
 
 	//~ Begin Super
-	virtual void Generate(TArray<FFGVoxelChunk>& ChunkData, FFGChunkHandle ChunkHandle) override;
+	virtual void ResolveVoxelTypes() override;
+	virtual bool GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const override;
+	virtual bool GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const override;
 	//~ End Super
+
+private:
+
+	int32 GrassId = VOXELTYPE_NONE;
 };
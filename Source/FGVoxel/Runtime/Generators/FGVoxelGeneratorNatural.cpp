@@ -2,57 +2,411 @@
 // Author: Sunny Blake-Webber
 
 #include "FGVoxelGeneratorNatural.h"
+#include "FGVoxelNoise.h"
 #include "FastNoise/FastNoise.h"
 #include "FGVoxelUtils.h"
 #include "GameplayTagsManager.h"
 #include "Containers/FGVoxelGrid.h"
 
-void UFGVoxelGeneratorNatural::Generate(TArray<FFGVoxelChunk>& ChunkData, FFGChunkHandle ChunkHandle)
+namespace FG::Private
 {
-	using namespace FG::Const;
-	
-	Super::Generate(ChunkData, ChunkHandle);
+	static constexpr int32 NaturalSeed = 1337;
+	static constexpr float NaturalFrequency = 0.01f;
+	static constexpr float NaturalTerrainHeight = 1000.f;
+
+	/** Part of the baseline id, bump it whenever Generate's output changes or old deltas apply to the wrong voxels. */
+	static constexpr uint32 NaturalVersion = 1;
+
+	/** Compact batches share one noise call, scattered ones would pay for columns nobody asked for. */
+	static constexpr int32 NaturalMaxBatchWaste = 2;
+
+	/**
+	 * The height noise tree for the calling thread. Building a tree isn't free and it's ref count
+	 * isn't thread safe, so rather than one per chunk or one shared, each worker keeps it's own.
+	 * Rebuilt if FG.Voxel.NoiseSIMDLevel changes, the level is baked in when it's built.
+	 */
+	static const FastNoise::SmartNode<>& GetNaturalNoise()
+	{
+		thread_local FastNoise::SmartNode<> SimplexNoise;
+		thread_local FastSIMD::eLevel SimplexLevel = FastSIMD::Level_Null;
+
+		const FastSIMD::eLevel Level = FG::GetNoiseSIMDLevel();
+		if(Level != SimplexLevel)
+		{
+			SimplexNoise = FastNoise::NewFromEncodedNodeTree(UFGVoxelGeneratorNatural::HeightNoiseTree, Level);
+			SimplexLevel = Level;
+		}
+		return SimplexNoise;
+	}
+
+	/**
+	 * Terrain height of every voxel column in a rectangle, in one noise call.
+	 * Shared by generation and the column summaries, and the same for a column whatever rectangle it's in.
+	 * @param MinVoxel XY world voxel coordinate of the first column.
+	 * @param SizeX Width of the rectangle in voxel columns.
+	 * @param SizeY Height of the rectangle in voxel columns.
+	 * @param OutHeights Height in world units, indexed X + Y * SizeX.
+	 */
+	static void GenerateNaturalHeights(FIntVector2 MinVoxel, int32 SizeX, int32 SizeY, float* RESTRICT OutHeights)
+	{
+		GetNaturalNoise()->GenUniformGrid2D(
+			OutHeights,
+			MinVoxel.X,
+			MinVoxel.Y,
+			SizeX,
+			SizeY,
+			NaturalFrequency,
+			NaturalSeed);
+
+		for(int32 Column = 0; Column < SizeX * SizeY; Column++)
+		{
+			OutHeights[Column] *= NaturalTerrainHeight;
+		}
+	}
+
+	/**
+	 * Terrain height of every voxel column in a rectangle of chunk columns.
+	 * @param MinColumn XY chunk coordinate of the first column.
+	 * @param NumColumnsX Width of the rectangle in chunk columns.
+	 * @param NumColumnsY Height of the rectangle in chunk columns.
+	 * @param OutHeights Height in world units, indexed X + Y * NumColumnsX * ChunkSizeX in voxels.
+	 */
+	static void GenerateNaturalChunkHeights(FIntVector2 MinColumn, int32 NumColumnsX, int32 NumColumnsY, float* RESTRICT OutHeights)
+	{
+		using namespace FG::Const;
+
+		GenerateNaturalHeights(FIntVector2(MinColumn.X * ChunkSizeX, MinColumn.Y * ChunkSizeX), NumColumnsX * ChunkSizeX, NumColumnsY * ChunkSizeX, OutHeights);
+	}
+
+	/** Generate paints a voxel solid when Z * VoxelSizeUU < Height, so the top one sits just under it. */
+	static int32 GetNaturalTopVoxelZ(float Height)
+	{
+		return FMath::CeilToInt32(Height / (float)FG::Const::VoxelSizeUU) - 1;
+	}
+
+	/** Boulders are spread out by giving each cell of voxel columns at most one. */
+	static constexpr int32 NaturalBoulderCellSize = 8;
+
+	/** Chance out of 100 that a cell has a boulder. */
+	static constexpr int32 NaturalBoulderChance = 20;
+
+	static constexpr int32 NaturalBoulderRadius = 2;
+
+	/** Squared distance from the centre a voxel can be and still be part of the boulder, a bit rounder than the radius squared. */
+	static constexpr int32 NaturalBoulderRadiusSq = NaturalBoulderRadius * NaturalBoulderRadius + NaturalBoulderRadius;
+
+	/**
+	 * Where a cell's boulder is. Only depends on the cell, so every chunk the boulder touches agrees.
+	 * @param Cell XY coordinate of the cell, in cells.
+	 * @param OutOrigin XY world voxel coordinate of the boulder's centre column.
+	 * @return false if the cell has no boulder.
+	 */
+	static bool FindNaturalBoulder(FIntVector2 Cell, FIntVector2& OutOrigin)
+	{
+		const int32 CellCoordinate[2] = { Cell.X, Cell.Y };
+		const uint32 Hash = FCrc::MemCrc32(CellCoordinate, sizeof(CellCoordinate), (uint32)NaturalSeed);
 
-	UGameplayTagsManager& TagMgr = UGameplayTagsManager::Get();
-	FGameplayTag GrassTagName = TagMgr.RequestGameplayTag("Voxel.FG.Grass");
-	int32 GrassId = GVoxelTypeMap.FindChecked(GrassTagName);
+		if(Hash % 100 >= NaturalBoulderChance)
+		{
+			return false;
+		}
 
-	FVector ChunkLocation = UFGVoxelUtils::ChunkCoordToVector(ChunkHandle->ChunkCoordinate);
+		OutOrigin.X = Cell.X * NaturalBoulderCellSize + (int32)((Hash >> 8) % NaturalBoulderCellSize);
+		OutOrigin.Y = Cell.Y * NaturalBoulderCellSize + (int32)((Hash >> 16) % NaturalBoulderCellSize);
+		return true;
+	}
+
+	/**
+	 * Call a function with the origin of every boulder that overlaps a rectangle of voxel columns.
+	 * @param MinVoxel XY world voxel coordinate of the rectangle's first column.
+	 * @param MaxVoxel XY world voxel coordinate of the rectangle's last column, inclusive.
+	 * @param Func Called with each boulder's origin, see FindNaturalBoulder.
+	 */
+	template<typename FuncType>
+	static void ForEachNaturalBoulder(FIntVector2 MinVoxel, FIntVector2 MaxVoxel, FuncType&& Func)
+	{
+		const FIntVector2 MinOrigin = MinVoxel - FIntVector2(NaturalBoulderRadius, NaturalBoulderRadius);
+		const FIntVector2 MaxOrigin = MaxVoxel + FIntVector2(NaturalBoulderRadius, NaturalBoulderRadius);
+
+		const FIntVector2 MinCell(FMath::DivideAndRoundDown(MinOrigin.X, NaturalBoulderCellSize), FMath::DivideAndRoundDown(MinOrigin.Y, NaturalBoulderCellSize));
+		const FIntVector2 MaxCell(FMath::DivideAndRoundDown(MaxOrigin.X, NaturalBoulderCellSize), FMath::DivideAndRoundDown(MaxOrigin.Y, NaturalBoulderCellSize));
+
+		for(int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++)
+		{
+			for(int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++)
+			{
+				FIntVector2 Origin;
+				if(FindNaturalBoulder(FIntVector2(CellX, CellY), Origin)
+					&& Origin.X >= MinOrigin.X && Origin.X <= MaxOrigin.X
+					&& Origin.Y >= MinOrigin.Y && Origin.Y <= MaxOrigin.Y)
+				{
+					Func(Origin);
+				}
+			}
+		}
+	}
+}
+
+void UFGVoxelGeneratorNatural::ResolveVoxelTypes()
+{
+	GrassId = GVoxelTypeMap.FindChecked(UGameplayTagsManager::Get().RequestGameplayTag("Voxel.FG.Grass"));
+	DirtId = GVoxelTypeMap.FindChecked(UGameplayTagsManager::Get().RequestGameplayTag("Voxel.FG.Dirt"));
+}
+
+bool UFGVoxelGeneratorNatural::GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const
+{
+	using namespace FG::Const;
 
-	static constexpr int32 Seed = 1337;
-	auto SimplexNoise = FastNoise::NewFromEncodedNodeTree("CAA=", FastSIMD::Level_AVX2);
-	
 	TStaticArray<float, ChunkSizeXY> NoiseData;
-	float* RESTRICT NoiseDataPtr = NoiseData.GetData();
-	
-	static constexpr float Frequency = 0.01f;
-	static constexpr float TerrainHeight = 1000.f;
-	
-	SimplexNoise->GenUniformGrid2D(
-		NoiseDataPtr,
-		ChunkHandle->ChunkCoordinate.X * ChunkSizeX,
-		ChunkHandle->ChunkCoordinate.Y * ChunkSizeX,
-		ChunkSizeX,
-		ChunkSizeX,
-		Frequency,
-		Seed);
-
-	FFGVoxelChunk* VoxelChunk = GetOwningVoxelGrid()->GetChunkDataUnsafe(ChunkHandle);
-
-	int32 VoxelIndex = 0;
-	for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+	FG::Private::GenerateNaturalChunkHeights(FIntVector2(ChunkCoordinate.X, ChunkCoordinate.Y), 1, 1, NoiseData.GetData());
+
+	PaintChunk(OutVoxels, ChunkCoordinate, NoiseData.GetData(), ChunkSizeX);
+	return true;
+}
+
+void UFGVoxelGeneratorNatural::GenerateBatch(TConstArrayView<FFGChunkHandle> ChunkHandles)
+{
+	using namespace FG::Const;
+
+	FIntVector2 MinColumn(MAX_int32, MAX_int32);
+	FIntVector2 MaxColumn(MIN_int32, MIN_int32);
+
+	for(const FFGChunkHandle& ChunkHandle : ChunkHandles)
 	{
-		for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++)
+		MinColumn.X = FMath::Min(MinColumn.X, ChunkHandle->ChunkCoordinate.X);
+		MinColumn.Y = FMath::Min(MinColumn.Y, ChunkHandle->ChunkCoordinate.Y);
+		MaxColumn.X = FMath::Max(MaxColumn.X, ChunkHandle->ChunkCoordinate.X);
+		MaxColumn.Y = FMath::Max(MaxColumn.Y, ChunkHandle->ChunkCoordinate.Y);
+	}
+
+	const int64 NumColumnsX = (int64)MaxColumn.X - MinColumn.X + 1;
+	const int64 NumColumnsY = (int64)MaxColumn.Y - MinColumn.Y + 1;
+
+	if(NumColumnsX * NumColumnsY > (int64)ChunkHandles.Num() * FG::Private::NaturalMaxBatchWaste)
+	{
+		Super::GenerateBatch(ChunkHandles);
+		return;
+	}
+
+	// One long span of noise for every column in the batch, chunks stacked in a column share it.
+	const int32 Stride = (int32)NumColumnsX * ChunkSizeX;
+
+	TArray<float> NoiseData;
+	NoiseData.SetNumUninitialized((int32)(NumColumnsX * NumColumnsY) * ChunkSizeXY);
+	FG::Private::GenerateNaturalChunkHeights(MinColumn, (int32)NumColumnsX, (int32)NumColumnsY, NoiseData.GetData());
+
+	const TArrayView<uint16> Voxels = GetScratchVoxels();
+	for(const FFGChunkHandle& ChunkHandle : ChunkHandles)
+	{
+		const int32 OffsetX = (ChunkHandle->ChunkCoordinate.X - MinColumn.X) * ChunkSizeX;
+		const int32 OffsetY = (ChunkHandle->ChunkCoordinate.Y - MinColumn.Y) * ChunkSizeX;
+
+		PaintChunk(Voxels, ChunkHandle->ChunkCoordinate, NoiseData.GetData() + OffsetX + OffsetY * Stride, Stride);
+		ChunkHandle->ChunkData->EncodeAll(Voxels);
+	}
+}
+
+int32 UFGVoxelGeneratorNatural::GetStageNeighbourRadius(EFGGenerationStage Stage) const
+{
+	switch(Stage)
+	{
+	case EFGGenerationStage::Terrain:
+		return 0;
+	case EFGGenerationStage::Decoration:
+		return 1; // Boulders reach a few voxels over the border, never further than the next chunk.
+	default:
+		return INDEX_NONE;
+	}
+}
+
+bool UFGVoxelGeneratorNatural::NeedsLaterStages(const FFGVoxelChunk& ChunkData, FIntVector ChunkCoordinate) const
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	if(!ChunkData.IsUniform())
+	{
+		return true;
+	}
+
+	// Boulders only paint over air, so solid chunks underground are done after Terrain.
+	if(ChunkData.GetUniformType() != VOXELTYPE_NONE)
+	{
+		return false;
+	}
+
+	// Nor can they reach air higher than a boulder on top of the tallest terrain.
+	const int32 MaxBoulderVoxelZ = GetNaturalTopVoxelZ(NaturalTerrainHeight) + 1 + NaturalBoulderRadius;
+	return ChunkCoordinate.Z * ChunkSizeX <= MaxBoulderVoxelZ;
+}
+
+void UFGVoxelGeneratorNatural::GenerateStage(EFGGenerationStage Stage, const FFGGenerationRegion& Region)
+{
+	if(Stage == EFGGenerationStage::Decoration)
+	{
+		PaintBoulders(Region);
+	}
+}
+
+bool UFGVoxelGeneratorNatural::GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	// Boulders centred just outside the column still hang over it, so take in their origins too.
+	constexpr int32 Margin = NaturalBoulderRadius;
+	constexpr int32 Size = ChunkSizeX + Margin * 2;
+
+	const FIntVector2 MinVoxel(ChunkColumn.X * ChunkSizeX, ChunkColumn.Y * ChunkSizeX);
+	const FIntVector2 MaxVoxel = MinVoxel + FIntVector2(ChunkSizeX - 1, ChunkSizeX - 1);
+
+	TStaticArray<float, Size * Size> Heights;
+	GenerateNaturalHeights(MinVoxel - FIntVector2(Margin, Margin), Size, Size, Heights.GetData());
+
+	for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++)
+	{
+		for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+		{
+			const float Height = Heights[(VoxelX + Margin) + (VoxelY + Margin) * Size];
+			OutTopVoxelZ[UFGVoxelUtils::FlattenVoxelCoord2D(FIntVector2(VoxelX, VoxelY))] = GetNaturalTopVoxelZ(Height);
+		}
+	}
+
+	// Raise every column a boulder covers to the boulder's top there. Boulders only paint over air,
+	// so this can be higher than what ends up solid, but never lower.
+	ForEachNaturalBoulder(MinVoxel, MaxVoxel, [&](FIntVector2 Origin)
+	{
+		const FIntVector2 Local = Origin - MinVoxel;
+		const int32 CentreZ = GetNaturalTopVoxelZ(Heights[(Local.X + Margin) + (Local.Y + Margin) * Size]) + 1;
+
+		for(int32 OffsetY = -NaturalBoulderRadius; OffsetY <= NaturalBoulderRadius; OffsetY++)
+		{
+			for(int32 OffsetX = -NaturalBoulderRadius; OffsetX <= NaturalBoulderRadius; OffsetX++)
+			{
+				const FIntVector2 Column(Local.X + OffsetX, Local.Y + OffsetY);
+				const int32 RemainingSq = NaturalBoulderRadiusSq - OffsetX * OffsetX - OffsetY * OffsetY;
+
+				if(Column.X < 0 || Column.X >= ChunkSizeX || Column.Y < 0 || Column.Y >= ChunkSizeX || RemainingSq < 0)
+				{
+					continue;
+				}
+
+				int32& TopVoxelZ = OutTopVoxelZ[UFGVoxelUtils::FlattenVoxelCoord2D(Column)];
+				TopVoxelZ = FMath::Max(TopVoxelZ, CentreZ + FMath::FloorToInt32(FMath::Sqrt((float)RemainingSq)));
+			}
+		}
+	});
+	return true;
+}
+
+void UFGVoxelGeneratorNatural::PaintBoulders(const FFGGenerationRegion& Region) const
+{
+	using namespace FG::Const;
+	using namespace FG::Private;
+
+	checkf(DirtId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+	checkf(Region.Radius >= 1, TEXT("Boulders need to see the neighbouring chunks!"));
+
+	FFGVoxelChunk& ChunkData = Region.GetChunk();
+	const FIntVector ChunkVoxel = Region.ChunkCoordinate * ChunkSizeX;
+	const FIntVector2 MinVoxel(ChunkVoxel.X, ChunkVoxel.Y);
+
+	ForEachNaturalBoulder(MinVoxel, MinVoxel + FIntVector2(ChunkSizeX - 1, ChunkSizeX - 1), [&](FIntVector2 Origin)
+	{
+		const FIntVector2 Local = Origin - MinVoxel;
+
+		// Only boulders sitting on terrain from just under the chunk to just over it can reach into it.
+		const int32 MinTopZ = -1 - NaturalBoulderRadius;
+		const int32 MaxTopZ = ChunkSizeX - 2 + NaturalBoulderRadius;
+
+		// Neighbours may already have painted their own boulders, but only ever with dirt, so the
+		// first grass down the column is the terrain surface whatever order the chunks ran in.
+		if(Region.GetVoxel(FIntVector(Local.X, Local.Y, MaxTopZ + 1)) == (uint32)GrassId)
+		{
+			return; // Surface is too high.
+		}
+
+		int32 TopZ = MinTopZ - 1;
+		for(int32 VoxelZ = MaxTopZ; VoxelZ >= MinTopZ; VoxelZ--)
+		{
+			if(Region.GetVoxel(FIntVector(Local.X, Local.Y, VoxelZ)) == (uint32)GrassId)
+			{
+				TopZ = VoxelZ;
+				break;
+			}
+		}
+
+		if(TopZ < MinTopZ)
 		{
-			float GenHeight = NoiseDataPtr[VoxelX + VoxelY * ChunkSizeX] * TerrainHeight;
-					
-			for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++, VoxelIndex++)
+			return; // Surface is too low.
+		}
+
+		const FIntVector Centre(Local.X, Local.Y, TopZ + 1);
+		for(int32 OffsetZ = -NaturalBoulderRadius; OffsetZ <= NaturalBoulderRadius; OffsetZ++)
+		{
+			for(int32 OffsetY = -NaturalBoulderRadius; OffsetY <= NaturalBoulderRadius; OffsetY++)
 			{
-				float VoxelZHeight = ChunkLocation.Z + VoxelZ * VoxelSizeUU;
-				int32 PaintType = VoxelZHeight < GenHeight;
+				for(int32 OffsetX = -NaturalBoulderRadius; OffsetX <= NaturalBoulderRadius; OffsetX++)
+				{
+					const FIntVector Voxel = Centre + FIntVector(OffsetX, OffsetY, OffsetZ);
+
+					if(OffsetX * OffsetX + OffsetY * OffsetY + OffsetZ * OffsetZ > NaturalBoulderRadiusSq
+						|| Voxel.X < 0 || Voxel.X >= ChunkSizeX
+						|| Voxel.Y < 0 || Voxel.Y >= ChunkSizeX
+						|| Voxel.Z < 0 || Voxel.Z >= ChunkSizeX)
+					{
+						continue;
+					}
 
-				VoxelChunk->SetVoxel(VoxelIndex, GrassId * PaintType);
+					// Sits on the terrain rather than replacing it.
+					if(ChunkData.GetVoxel(Voxel) == VOXELTYPE_NONE)
+					{
+						ChunkData.SetVoxel(Voxel, DirtId);
+					}
+				}
 			}
 		}
+	});
+}
+
+void UFGVoxelGeneratorNatural::PaintChunk(TArrayView<uint16> OutVoxels, FIntVector ChunkCoordinate, const float* RESTRICT Heights, int32 HeightStride) const
+{
+	using namespace FG::Const;
+
+	checkf(GrassId != VOXELTYPE_NONE, TEXT("Voxel types haven't been resolved!"));
+	checkf(OutVoxels.Num() == ChunkSizeXYZ, TEXT("PaintChunk expects a full chunk of voxels!"));
+
+	FVector ChunkLocation = UFGVoxelUtils::ChunkCoordToVector(ChunkCoordinate);
+
+	// Heights of every voxel in a column, so the compare below is a straight vector loop.
+	TStaticArray<float, ChunkSizeX> VoxelZHeights;
+	for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++)
+	{
+		VoxelZHeights[VoxelZ] = ChunkLocation.Z + VoxelZ * VoxelSizeUU;
 	}
-}
\ No newline at end of file
+
+	const uint16 PaintId = (uint16)GrassId;
+	uint16* RESTRICT Voxels = OutVoxels.GetData();
+
+	for(int32 VoxelX = 0; VoxelX < ChunkSizeX; VoxelX++)
+	{
+		for(int32 VoxelY = 0; VoxelY < ChunkSizeX; VoxelY++, Voxels += ChunkSizeX)
+		{
+			float GenHeight = Heights[VoxelX + VoxelY * HeightStride];
+
+			for(int32 VoxelZ = 0; VoxelZ < ChunkSizeX; VoxelZ++)
+			{
+				uint16 PaintType = VoxelZHeights[VoxelZ] < GenHeight;
+				Voxels[VoxelZ] = (uint16)(PaintId * PaintType);
+			}
+		}
+	}
+}
+
+uint32 UFGVoxelGeneratorNatural::GetBaselineId() const
+{
+	// Deterministic from the seed, so the class, seed and version are enough to regenerate any chunk's terrain.
+	// Has to be stable across runs, so hash the path string rather than the FName.
+	const uint32 ClassCrc = FCrc::StrCrc32(*GetClass()->GetPathName(), (uint32)FG::Private::NaturalSeed);
+	return FCrc::MemCrc32(&FG::Private::NaturalVersion, sizeof(FG::Private::NaturalVersion), ClassCrc);
+}
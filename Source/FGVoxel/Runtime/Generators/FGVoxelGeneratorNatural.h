@@ -11,9 +11,39 @@ class UFGVoxelGeneratorNatural : public UFGVoxelGenerator
 {
 	GENERATED_BODY()
 public:
+
+	/** FastNoise2 encoded node tree for the terrain height, plain simplex. */
+	static constexpr const char* HeightNoiseTree = "CAA=";
 	
 	//~ Begin Super
-	virtual void Generate(TArray<FFGVoxelChunk>& ChunkData, FFGChunkHandle ChunkHandle) override;
+	virtual void ResolveVoxelTypes() override;
+	virtual bool GenerateVoxels(FIntVector ChunkCoordinate, TArrayView<uint16> OutVoxels) const override;
+	virtual void GenerateBatch(TConstArrayView<FFGChunkHandle> ChunkHandles) override;
+	virtual int32 GetStageNeighbourRadius(EFGGenerationStage Stage) const override;
+	virtual bool NeedsLaterStages(const FFGVoxelChunk& ChunkData, FIntVector ChunkCoordinate) const override;
+	virtual void GenerateStage(EFGGenerationStage Stage, const FFGGenerationRegion& Region) override;
+	virtual bool GenerateColumnHeights(FIntVector2 ChunkColumn, TArrayView<int32> OutTopVoxelZ) const override;
+	virtual uint32 GetBaselineId() const override;
 	//~ End Super
-	
+
+private:
+
+	/**
+	 * Fill a chunk's voxels from the terrain heights of it's column.
+	 * @param OutVoxels ChunkSizeXYZ voxel types to write to, in voxel index order.
+	 * @param ChunkCoordinate The chunk's coordinate.
+	 * @param Heights Height of the chunk's first voxel column, in world units.
+	 * @param HeightStride Distance between rows of heights, wider than the chunk when it's part of a batch.
+	 */
+	void PaintChunk(TArrayView<uint16> OutVoxels, FIntVector ChunkCoordinate, const float* RESTRICT Heights, int32 HeightStride) const;
+
+	/**
+	 * Paint the parts of every boulder that land in the region's centre chunk. Boulders sit on the
+	 * terrain surface and cross chunk borders, so their origins are found in the neighbours.
+	 * @param Region The chunk and it's neighbours, radius 1.
+	 */
+	void PaintBoulders(const FFGGenerationRegion& Region) const;
+
+	int32 GrassId = VOXELTYPE_NONE;
+	int32 DirtId = VOXELTYPE_NONE;
 };
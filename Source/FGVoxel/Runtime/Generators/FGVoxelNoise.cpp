@@ -0,0 +1,155 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelNoise.h"
+#include "FGVoxelDefines.h"
+#include "FastNoise/FastNoise.h"
+#include "Logging/StructuredLog.h"
+#include "Algo/Find.h"
+
+namespace FG::Private
+{
+	struct FNoiseSIMDLevelName
+	{
+		FastSIMD::eLevel Level;
+		const TCHAR* Name;
+	};
+
+	/** Lowest to highest, AVX and SSE are never compiled into FastNoise2 so aren't listed. */
+	static const FNoiseSIMDLevelName NoiseSIMDLevelNames[] =
+	{
+		{ FastSIMD::Level_Scalar,	TEXT("Scalar") },
+		{ FastSIMD::Level_SSE2,		TEXT("SSE2") },
+		{ FastSIMD::Level_SSE3,		TEXT("SSE3") },
+		{ FastSIMD::Level_SSSE3,	TEXT("SSSE3") },
+		{ FastSIMD::Level_SSE41,	TEXT("SSE41") },
+		{ FastSIMD::Level_SSE42,	TEXT("SSE42") },
+		{ FastSIMD::Level_AVX2,		TEXT("AVX2") },
+		{ FastSIMD::Level_AVX512,	TEXT("AVX512") },
+		{ FastSIMD::Level_NEON,		TEXT("NEON") },
+	};
+
+	/** Resolved from the cvar, Level_Null until first asked for. */
+	static std::atomic<FastSIMD::Level_BitFlags> NoiseSIMDLevel = FastSIMD::Level_Null;
+
+	/** The level a FG.Voxel.NoiseSIMDLevel value asks for, or the best one if it can't be used. */
+	static FastSIMD::eLevel ResolveNoiseSIMDLevel(const FString& RequestedName)
+	{
+		const TArray<FastSIMD::eLevel> SupportedLevels = GetSupportedNoiseSIMDLevels();
+		const FastSIMD::eLevel BestLevel = SupportedLevels.Last();
+
+		if(RequestedName.IsEmpty() || RequestedName == TEXT("Auto"))
+		{
+			return BestLevel;
+		}
+
+		const FNoiseSIMDLevelName* Requested = Algo::FindByPredicate(NoiseSIMDLevelNames, [&RequestedName](const FNoiseSIMDLevelName& Entry)
+		{
+			return RequestedName == Entry.Name;
+		});
+
+		if(!Requested)
+		{
+			UE_LOGFMT(LogTemp, Warning, "Unknown noise SIMD level {Name}, using {Best}.", RequestedName, GetNoiseSIMDLevelName(BestLevel));
+			return BestLevel;
+		}
+
+		if(!SupportedLevels.Contains(Requested->Level))
+		{
+			UE_LOGFMT(LogTemp, Warning, "Noise SIMD level {Name} isn't supported here, using {Best}.", RequestedName, GetNoiseSIMDLevelName(BestLevel));
+			return BestLevel;
+		}
+
+		return Requested->Level;
+	}
+}
+
+namespace FG
+{
+	static FString NoiseSIMDLevelName = TEXT("Auto");
+	FAutoConsoleVariableRef CVarNoiseSIMDLevel (
+		TEXT("FG.Voxel.NoiseSIMDLevel"),
+		NoiseSIMDLevelName,
+		TEXT("SIMD level noise is generated at: Auto, Scalar, SSE2, SSE3, SSSE3, SSE41, SSE42, AVX2, AVX512 or NEON. Levels the CPU can't run fall back to the best one it can. Affects chunks generated after the change."),
+		FConsoleVariableDelegate::CreateLambda([](IConsoleVariable*)
+		{
+			FG::Private::NoiseSIMDLevel = FG::Private::ResolveNoiseSIMDLevel(NoiseSIMDLevelName);
+		}),
+		ECVF_Default
+	);
+}
+
+FastSIMD::eLevel FG::GetBestNoiseSIMDLevel()
+{
+	return GetSupportedNoiseSIMDLevels().Last();
+}
+
+FastSIMD::eLevel FG::GetNoiseSIMDLevel()
+{
+	FastSIMD::Level_BitFlags Level = Private::NoiseSIMDLevel.load(std::memory_order_relaxed);
+	if(Level == FastSIMD::Level_Null)
+	{
+		// Cvar is still on Auto, it's delegate sets the level once it's changed.
+		Level = GetBestNoiseSIMDLevel();
+		Private::NoiseSIMDLevel.store(Level, std::memory_order_relaxed);
+	}
+	return (FastSIMD::eLevel)Level;
+}
+
+TArray<FastSIMD::eLevel> FG::GetSupportedNoiseSIMDLevels()
+{
+	// CPU detection is a handful of cpuid calls, only worth doing once.
+	static const TArray<FastSIMD::eLevel> SupportedLevels = []()
+	{
+		const FastSIMD::eLevel MaxLevel = FastSIMD::CPUMaxSIMDLevel();
+
+		TArray<FastSIMD::eLevel> Levels;
+		for(const Private::FNoiseSIMDLevelName& Entry : Private::NoiseSIMDLevelNames)
+		{
+			if((FastSIMD::COMPILED_SIMD_LEVELS & Entry.Level) && Entry.Level <= MaxLevel)
+			{
+				Levels.Add(Entry.Level);
+			}
+		}
+
+		checkf(!Levels.IsEmpty(), TEXT("FastNoise2 wasn't compiled for any SIMD level this CPU supports!"));
+		return Levels;
+	}();
+
+	return SupportedLevels;
+}
+
+const TCHAR* FG::GetNoiseSIMDLevelName(FastSIMD::eLevel Level)
+{
+	for(const Private::FNoiseSIMDLevelName& Entry : Private::NoiseSIMDLevelNames)
+	{
+		if(Entry.Level == Level)
+		{
+			return Entry.Name;
+		}
+	}
+	return TEXT("Unknown");
+}
+
+double FG::MeasureNoiseThroughput(const char* EncodedNodeTree, FastSIMD::eLevel Level, int32 Iterations)
+{
+	using namespace FG::Const;
+
+	const FastNoise::SmartNode<> Noise = FastNoise::NewFromEncodedNodeTree(EncodedNodeTree, Level);
+	checkf(Noise, TEXT("Invalid noise tree!"));
+
+	TStaticArray<float, ChunkSizeXY> NoiseData;
+	float Checksum = 0.f; // Stops the generation from being optimized away.
+
+	// Walk along X so every patch is new noise, the same as generating neighbouring chunks.
+	const double StartTime = FPlatformTime::Seconds();
+	for(int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Noise->GenUniformGrid2D(NoiseData.GetData(), Iteration * ChunkSizeX, 0, ChunkSizeX, ChunkSizeX, 0.01f, 1337);
+		Checksum += NoiseData[0];
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOGFMT(LogTemp, Verbose, "Noise throughput checksum {Checksum}", Checksum);
+	return (double)ChunkSizeXY * Iterations / FMath::Max(Seconds, UE_DOUBLE_SMALL_NUMBER) / 1e6;
+}
@@ -0,0 +1,37 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "FastSIMD/FastSIMD.h"
+
+/**
+ * SIMD level selection for the FastNoise2 generators.
+ *
+ * The best level this CPU and the FastNoise2 build both support is detected once,
+ * generators build their noise trees at GetNoiseSIMDLevel() which is that level
+ * unless FG.Voxel.NoiseSIMDLevel asks for a lower one (Scalar, SSE2, SSE41, AVX2...).
+ */
+namespace FG
+{
+	/** Best level this CPU and the FastNoise2 build both support. */
+	FastSIMD::eLevel GetBestNoiseSIMDLevel();
+
+	/** Level noise trees should be built at, any thread. Changes when FG.Voxel.NoiseSIMDLevel does. */
+	FastSIMD::eLevel GetNoiseSIMDLevel();
+
+	/** Every level usable on this CPU, lowest first. */
+	TArray<FastSIMD::eLevel> GetSupportedNoiseSIMDLevels();
+
+	/** Display name of a level, the same names FG.Voxel.NoiseSIMDLevel accepts. */
+	const TCHAR* GetNoiseSIMDLevelName(FastSIMD::eLevel Level);
+
+	/**
+	 * Single threaded 2D noise throughput of a node tree at a level, for sizing hardware.
+	 * @param EncodedNodeTree The FastNoise2 encoded node tree to sample.
+	 * @param Level The SIMD level to build the tree at.
+	 * @param Iterations How many chunk sized patches to generate.
+	 * @return Millions of samples per second.
+	 */
+	double MeasureNoiseThroughput(const char* EncodedNodeTree, FastSIMD::eLevel Level, int32 Iterations);
+}
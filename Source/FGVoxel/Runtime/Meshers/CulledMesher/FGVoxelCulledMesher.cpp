@@ -5,6 +5,7 @@
 #include "FGVoxelCulledMeshComponent.h"
 #include "FGVoxelDefines.h"
 #include "FGVoxelUtils.h"
+#include "FGVoxelStats.h"
 #include "World/FGVoxelSystem.h"
 
 AFGVoxelCulledMesher::AFGVoxelCulledMesher()
@@ -52,11 +53,18 @@ void AFGVoxelCulledMesher::Initialize()
 	 */
 	VoxSys->OnRenderCoordinatesFinishedLoading.AddWeakLambda(this, [this](TArray<FIntVector> LoadedCoordinates)
 	{
+		auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
+
 		for(FIntVector& Coordinate : LoadedCoordinates)
 		{
 			if(MeshMappings.Contains(Coordinate))
 			{
+				const double StartTime = FPlatformTime::Seconds();
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshStart);
 				MeshMappings.FindChecked(Coordinate)->GenerateMesh();
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshEnd);
+				VoxelGrid->RecordChunkStageCost(EFGChunkStage::Meshing, FPlatformTime::Seconds() - StartTime);
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::Visible);
 			}
 		}
 	});
@@ -4,6 +4,7 @@
 #include "FGVoxelInstanceMesher.h"
 #include "FGVoxelInstancedChunkMesh.h"
 #include "FGVoxelUtils.h"
+#include "FGVoxelStats.h"
 #include "World/FGVoxelSystem.h"
 
 AFGVoxelInstanceMesher::AFGVoxelInstanceMesher()
@@ -31,8 +32,6 @@ void AFGVoxelInstanceMesher::Initialize()
 		InstanceMeshFreelist[Chunk] = Chunk;
 	}
 
-	// @TODO: We may want to directly pass in the chunk pointers at this point? Not sure.
-	// Not going to premature optimize for now lets see how the performance is.
 	VoxSys->OnRenderCoordinatesAdded.AddWeakLambda(this, [this](TArray<FIntVector> AddedCoordinates)
 	{
 		auto* VoxSys = GetWorld()->GetSubsystem<UFGVoxelSystem>();
@@ -44,8 +43,14 @@ void AFGVoxelInstanceMesher::Initialize()
 			const int32 NextFree = InstanceMeshFreelist.Pop();
 			InstanceMeshMappings.Add(Coordinate, InstanceMeshPool[NextFree]);
 			InstanceMeshPool[NextFree]->SetActorLocation(UFGVoxelUtils::ChunkCoordToVector(Coordinate));
-			InstanceMeshPool[NextFree]->ChunkIndex = ChunkHandle->ChunkDataIndex;
+			InstanceMeshPool[NextFree]->ChunkHandle = ChunkHandle;
+
+			const double StartTime = FPlatformTime::Seconds();
+			FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshStart);
 			InstanceMeshPool[NextFree]->GenerateMesh();
+			FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshEnd);
+			VoxSys->VoxelGrid->RecordChunkStageCost(EFGChunkStage::Meshing, FPlatformTime::Seconds() - StartTime);
+			FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::Visible);
 		}
 	});
 
@@ -61,6 +66,7 @@ void AFGVoxelInstanceMesher::Initialize()
 
 			InstanceMeshPool[Freed]->ClearMesh();
 			InstanceMeshPool[Freed]->Reset();
+			InstanceMeshPool[Freed]->ChunkHandle.Reset();
 			InstanceMeshMappings.Remove(Coordinate);
 			FreedIndices.Emplace(Freed);
         }
@@ -77,3 +83,13 @@ void AFGVoxelInstanceMesher::Deinitialize()
 		InstanceMesh->Destroy();
 	}
 }
+
+void AFGVoxelInstanceMesher::GenerateMesh(FIntVector ChunkCoordinate)
+{
+	InstanceMeshMappings.FindChecked(ChunkCoordinate)->GenerateMesh();
+}
+
+void AFGVoxelInstanceMesher::ClearMesh(FIntVector ChunkCoordinate)
+{
+	InstanceMeshMappings.FindChecked(ChunkCoordinate)->ClearMesh();
+}
@@ -23,6 +23,8 @@ public:
 	//~ Begin Super
 	void Initialize() override;
 	void Deinitialize() override;
+	void GenerateMesh(FIntVector ChunkCoordinate) override;
+	void ClearMesh(FIntVector ChunkCoordinate) override;
 	//~ End Super
 
 	UPROPERTY(Transient)
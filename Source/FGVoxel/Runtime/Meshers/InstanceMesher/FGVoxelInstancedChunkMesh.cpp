@@ -54,6 +54,19 @@ void AFGVoxelInstancedChunkMesh::PostInitProperties()
     ISM->SetStaticMesh(VoxelMesh);
 }
 
+bool AFGVoxelInstancedChunkMesh::IsBuried() const
+{
+	for(int32 Face = 0; Face < (int32)EFGChunkFace::Num; Face++)
+	{
+		const FFGChunkHandleData* Neighbour = ChunkHandle->GetNeighbour((EFGChunkFace)Face);
+		if(!Neighbour || !Neighbour->Generated || !Neighbour->ChunkData->IsUniform() || Neighbour->ChunkData->GetUniformType() == VOXELTYPE_NONE)
+		{
+			return false;
+		}
+	}
+	return ChunkHandle->ChunkData->IsUniform() && ChunkHandle->ChunkData->GetUniformType() != VOXELTYPE_NONE;
+}
+
 void AFGVoxelInstancedChunkMesh::GenerateMesh()
 {
 	using namespace FG::Const;
@@ -66,14 +79,25 @@ void AFGVoxelInstancedChunkMesh::GenerateMesh()
 		FLinearColor::Blue,
 		0.5);
 
-	auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
-	FFGVoxelChunk& ChunkData = *VoxelGrid->GetChunkDataSafe(ChunkIndex);
+	checkf(ChunkHandle.IsValid(), TEXT("Instanced chunk mesh has no chunk handle!"));
+	FFGVoxelChunk* ChunkData = ChunkHandle->ChunkData;
+
+	// There's no face culling here, every solid voxel is an instance, so uniform solid is only
+	// skipped when it can't be seen at all. At the surface or against a cave it draws like any other chunk.
+	if(ChunkData->IsUniform() && (ChunkData->GetUniformType() == VOXELTYPE_NONE || IsBuried()))
+	{
+		return;
+	}
+
+	TArray<uint16> DecodedVoxels;
+	DecodedVoxels.SetNumUninitialized(ChunkSizeXYZ);
+	ChunkData->DecodeAll(DecodedVoxels);
 	
 	for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
 	{
 		FIntVector VoxelCoordinate = UFGVoxelUtils::UnflattenVoxelCoord(Voxel);
 
-		if(ChunkData.GetVoxel(VoxelCoordinate) > VOXELTYPE_NONE) // Non-opqaue, paint
+		if(DecodedVoxels[Voxel] > VOXELTYPE_NONE) // Non-opqaue, paint
         {
 			FTransform InstanceTransform;
 			InstanceTransform.SetLocation(FVector(VoxelCoordinate) * VoxelSizeUU);
@@ -82,7 +106,7 @@ void AFGVoxelInstancedChunkMesh::GenerateMesh()
         }
 		
 #if 0
-		if(ChunkData.GetVoxel(VoxelCoordinate) == VOXELTYPE_NONE) // Non-opqaue, skip.
+		if(ChunkData->GetVoxel(VoxelCoordinate) == VOXELTYPE_NONE) // Non-opqaue, skip.
 		{
 			continue;
 		}
@@ -100,7 +124,7 @@ void AFGVoxelInstancedChunkMesh::GenerateMesh()
 				continue;
 			}
 
-			if(ChunkData.GetVoxel(Neighbour) == VOXELTYPE_NONE) // Check for Air.
+			if(ChunkData->GetVoxel(Neighbour) == VOXELTYPE_NONE) // Check for Air.
 			{
 				NeighbouringAir |= true;
 			}
@@ -7,6 +7,8 @@
 #include "FGVoxelInstancedChunkMesh.generated.h"
 
 class UInstancedStaticMeshComponent;
+struct FFGChunkHandleData;
+using FFGChunkHandle = TSharedPtr<FFGChunkHandleData>;
 
 /**
  * Instance mesh chunk actor.
@@ -26,10 +28,13 @@ public:
 	void GenerateMesh();
 	void ClearMesh();
 
-	int32 ChunkIndex;
+	FFGChunkHandle ChunkHandle;
 
 private:
 
+	/** Is the chunk uniform solid and boxed in by uniform solid chunks on every face, so nothing of it can be seen? */
+	bool IsBuried() const;
+
 	UPROPERTY(Transient, VisibleAnywhere)
 	TObjectPtr<UInstancedStaticMeshComponent> ISM;
 };
@@ -109,6 +109,17 @@ void AFGVoxelSimpleChunkMesh::GenerateMesh()
 	auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
 	FFGVoxelChunk& ChunkData = *VoxelGrid->GetChunkDataUnsafe(ChunkHandle);
 
+	// Uniform chunks never produce faces, air has nothing to draw and solid is entirely
+	// culled against itself (faces on the chunk border are not emitted by this mesher).
+	if(ChunkData.IsUniform())
+	{
+		if(VertexCount > 0)
+		{
+			ClearMesh();
+		}
+		return;
+	}
+
 	MeshLOD = (EFGVoxelMeshLOD)(FMath::RoundUpToPowerOfTwo(FG::MesherLODOverride));
 
 	int32 MesherSizeX = ChunkSizeX / (int32)MeshLOD;
@@ -134,13 +145,17 @@ void AFGVoxelSimpleChunkMesh::GenerateMesh()
 		VoxelFlags.Add(VoxelType, GetFlagsForVoxelType(VoxelType));
 	}
 
+	TArray<uint16> DecodedVoxels;
+	DecodedVoxels.SetNumUninitialized(ChunkSizeXYZ);
+	ChunkData.DecodeAll(DecodedVoxels);
+
 	TArray<bool> OpaqueVoxels;
 	OpaqueVoxels.SetNum(MesherSizeXYZ);
 	bool* RESTRICT OpaqueVoxelsPtr = OpaqueVoxels.GetData();
 	
 	for(int32 Voxel = 0; Voxel < MesherSizeXYZ; Voxel++)
 	{
-		int32 VoxelType = ChunkData[Voxel * (int32)MeshLOD];
+		int32 VoxelType = DecodedVoxels[Voxel * (int32)MeshLOD];
 		EFGVoxelFlags Flags = VoxelFlags[VoxelType];
 		OpaqueVoxelsPtr[Voxel] = EnumHasAnyFlags(Flags, EFGVoxelFlags::Opaque);
 	}
@@ -4,6 +4,7 @@
 #include "FGVoxelSimpleMesher.h"
 #include "FGVoxelSimpleChunkMesh.h"
 #include "FGVoxelUtils.h"
+#include "FGVoxelStats.h"
 #include "Logging/StructuredLog.h"
 #include "World/FGVoxelSystem.h"
 
@@ -73,11 +74,18 @@ void AFGVoxelSimpleMesher::Initialize()
 	 */
 	VoxSys->OnRenderCoordinatesFinishedLoading.AddWeakLambda(this, [this](TArray<FIntVector> LoadedCoordinates)
 	{
+		auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
+
 		for(FIntVector& Coordinate : LoadedCoordinates)
 		{
 			if(SimpleMeshMappings.Contains(Coordinate))
 			{
+				const double StartTime = FPlatformTime::Seconds();
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshStart);
 				SimpleMeshMappings.FindChecked(Coordinate)->GenerateMesh();
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::MeshEnd);
+				VoxelGrid->RecordChunkStageCost(EFGChunkStage::Meshing, FPlatformTime::Seconds() - StartTime);
+				FG::TraceChunkStage(Coordinate, EFGChunkTraceStage::Visible);
 			}
 		}
 	});
@@ -0,0 +1,363 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelBenchCommandlet.h"
+#include "FGVoxelDefines.h"
+#include "FGVoxelGameplayTags.h"
+#include "Containers/FGVoxelGrid.h"
+#include "Generators/FGVoxelGeneratorDensity.h"
+#include "Generators/FGVoxelGeneratorFlat.h"
+#include "Generators/FGVoxelGeneratorNatural.h"
+#include "Generators/FGVoxelNoise.h"
+#include "GameplayTagsManager.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+#include "Logging/StructuredLog.h"
+#include "Tasks/Task.h"
+#include "Algo/Transform.h"
+
+namespace FG::Private
+{
+	/** Voxel metadata is only enumerated by the voxel system in a world, so give every voxel tag an id ourselves. */
+	static void RegisterBenchVoxelTypes()
+	{
+		if(!GVoxelTypeMap.IsEmpty())
+		{
+			return;
+		}
+
+		UGameplayTagsManager& TagMgr = UGameplayTagsManager::Get();
+		const FGameplayTagContainer VoxelTags = TagMgr.RequestGameplayTagChildren(TagMgr.RequestGameplayTag("Voxel.FG"));
+
+		GVoxelTypeMap.Add(TAG_VOXEL_FG_AIR, VOXELTYPE_NONE);
+
+		int32 VoxelId = 1;
+		for(const FGameplayTag& VoxelTag : VoxelTags)
+		{
+			if(!GVoxelTypeMap.Contains(VoxelTag))
+			{
+				GVoxelTypeMap.Add(VoxelTag, VoxelId++);
+			}
+		}
+	}
+
+	/**
+	 * Run every stage after Terrain on the chunks that need them, the way the grid's ladder would but on
+	 * this thread. Chunks too close to the edge of the volume to see their neighbours are left out.
+	 * @param Generator The generator the chunks were made with.
+	 * @param ChunkHandles Every chunk in the volume, Terrain done.
+	 * @param NeedsStages Whether each chunk needs the later stages.
+	 * @param Reverse Visit the chunks back to front.
+	 * @return How many chunks ran the stages.
+	 */
+	static int32 RunBenchStages(UFGVoxelGenerator* Generator, TConstArrayView<FFGChunkHandle> ChunkHandles, TConstArrayView<bool> NeedsStages, bool Reverse)
+	{
+		TMap<FIntVector, FFGVoxelChunk*> ChunksByCoordinate;
+		FIntVector MinChunk(MAX_int32), MaxChunk(MIN_int32);
+
+		for(const FFGChunkHandle& ChunkHandle : ChunkHandles)
+		{
+			ChunksByCoordinate.Add(ChunkHandle->ChunkCoordinate, ChunkHandle->ChunkData);
+			const FIntVector& ChunkCoordinate = ChunkHandle->ChunkCoordinate;
+			MinChunk = FIntVector(FMath::Min(MinChunk.X, ChunkCoordinate.X), FMath::Min(MinChunk.Y, ChunkCoordinate.Y), FMath::Min(MinChunk.Z, ChunkCoordinate.Z));
+			MaxChunk = FIntVector(FMath::Max(MaxChunk.X, ChunkCoordinate.X), FMath::Max(MaxChunk.Y, ChunkCoordinate.Y), FMath::Max(MaxChunk.Z, ChunkCoordinate.Z));
+		}
+
+		TSet<int32> StagedChunks;
+		for(EFGGenerationStage Stage = Generator->GetNextStage(EFGGenerationStage::Terrain); Stage != EFGGenerationStage::Num; Stage = Generator->GetNextStage(Stage))
+		{
+			const int32 Radius = Generator->GetStageNeighbourRadius(Stage);
+
+			for(int32 Step = 0; Step < ChunkHandles.Num(); Step++)
+			{
+				const int32 Chunk = Reverse ? ChunkHandles.Num() - 1 - Step : Step;
+				const FIntVector ChunkCoordinate = ChunkHandles[Chunk]->ChunkCoordinate;
+
+				if(!NeedsStages[Chunk]
+					|| ChunkCoordinate.X - Radius < MinChunk.X || ChunkCoordinate.X + Radius > MaxChunk.X
+					|| ChunkCoordinate.Y - Radius < MinChunk.Y || ChunkCoordinate.Y + Radius > MaxChunk.Y
+					|| ChunkCoordinate.Z - Radius < MinChunk.Z || ChunkCoordinate.Z + Radius > MaxChunk.Z)
+				{
+					continue;
+				}
+
+				FFGGenerationRegion Region;
+				Region.ChunkCoordinate = ChunkCoordinate;
+				Region.Radius = Radius;
+				Region.Chunks.SetNumZeroed(FMath::Cube(Radius * 2 + 1));
+
+				for(int32 Z = -Radius; Z <= Radius; Z++)
+				{
+					for(int32 Y = -Radius; Y <= Radius; Y++)
+					{
+						for(int32 X = -Radius; X <= Radius; X++)
+						{
+							const FIntVector Offset(X, Y, Z);
+							Region.Chunks[Region.GetChunkIndex(Offset)] = ChunksByCoordinate.FindChecked(ChunkCoordinate + Offset);
+						}
+					}
+				}
+
+				Generator->GenerateStage(Stage, Region);
+				StagedChunks.Add(Chunk);
+			}
+		}
+
+		for(const int32 Chunk : StagedChunks)
+		{
+			ChunkHandles[Chunk]->ChunkData->ShrinkPalette();
+		}
+		return StagedChunks.Num();
+	}
+
+	static double GetPercentile(const TArray<double>& SortedValues, double Percentile)
+	{
+		if(SortedValues.IsEmpty())
+		{
+			return 0.0;
+		}
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Percentile * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+		return SortedValues[Index];
+	}
+}
+
+UFGVoxelBenchCommandlet::UFGVoxelBenchCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UFGVoxelBenchCommandlet::Main(const FString& Params)
+{
+	using namespace FG::Const;
+
+	FString GeneratorName = TEXT("Natural");
+	int32 SizeXY = 16;
+	int32 SizeZ = 4;
+	int32 NumThreads = FTaskGraphInterface::Get().GetNumWorkerThreads();
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("FGVoxelBench.json");
+
+	FParse::Value(*Params, TEXT("Generator="), GeneratorName);
+	FParse::Value(*Params, TEXT("SizeXY="), SizeXY);
+	FParse::Value(*Params, TEXT("SizeZ="), SizeZ);
+	FParse::Value(*Params, TEXT("Threads="), NumThreads);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	SizeXY = FMath::Max(SizeXY, 1);
+	SizeZ = FMath::Max(SizeZ, 1);
+	NumThreads = FMath::Max(NumThreads, 1);
+
+	TSubclassOf<UFGVoxelGenerator> GeneratorType;
+	if(GeneratorName == TEXT("Natural"))
+	{
+		GeneratorType = UFGVoxelGeneratorNatural::StaticClass();
+	}
+	else if(GeneratorName == TEXT("Flat"))
+	{
+		GeneratorType = UFGVoxelGeneratorFlat::StaticClass();
+	}
+	else if(GeneratorName == TEXT("Density"))
+	{
+		GeneratorType = UFGVoxelGeneratorDensity::StaticClass();
+	}
+	else
+	{
+		UE_LOGFMT(LogTemp, Error, "Unknown generator {Generator}, expected Natural, Flat or Density.", GeneratorName);
+		return 1;
+	}
+
+	FG::Private::RegisterBenchVoxelTypes();
+
+	// No world, so the grid never ticks and never persists, we drive generation ourselves.
+	UFGVoxelGrid* VoxelGrid = NewObject<UFGVoxelGrid>(GetTransientPackage());
+	VoxelGrid->AddToRoot();
+	VoxelGrid->SetGeneratorType(GeneratorType);
+
+	// Slots can only be handed out on the game thread, so allocate everything up front.
+	TArray<FFGChunkHandle> ChunkHandles;
+	ChunkHandles.Reserve(SizeXY * SizeXY * SizeZ);
+
+	for(int32 Z = 0; Z < SizeZ; Z++)
+	{
+		for(int32 Y = 0; Y < SizeXY; Y++)
+		{
+			for(int32 X = 0; X < SizeXY; X++)
+			{
+				const FIntVector ChunkCoordinate(X - SizeXY / 2, Y - SizeXY / 2, Z - SizeZ / 2);
+				FFGChunkHandle ChunkHandle = VoxelGrid->ConstructChunkHandle(ChunkCoordinate);
+				VoxelGrid->AssignChunkSlot(ChunkHandle);
+				ChunkHandles.Add(MoveTemp(ChunkHandle));
+			}
+		}
+	}
+
+	UE_LOGFMT(LogTemp, Display, "FGVoxelBench generating {Num} chunks with {Generator} on {Threads} tasks.", ChunkHandles.Num(), GeneratorName, NumThreads);
+
+	// Each task pulls the next chunk until there are none left, so the thread count is exactly what was asked for.
+	TArray<double> ChunkSeconds;
+	ChunkSeconds.SetNumZeroed(ChunkHandles.Num());
+	TArray<bool> NeedsStages;
+	NeedsStages.SetNumZeroed(ChunkHandles.Num());
+	std::atomic<int32> NextChunk = 0;
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<UE::Tasks::FTask> Tasks;
+	for(int32 Thread = 0; Thread < NumThreads; Thread++)
+	{
+		Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [VoxelGrid, &ChunkHandles, &ChunkSeconds, &NeedsStages, &NextChunk]()
+		{
+			for(int32 Chunk = NextChunk++; Chunk < ChunkHandles.Num(); Chunk = NextChunk++)
+			{
+				const double ChunkStartTime = FPlatformTime::Seconds();
+				NeedsStages[Chunk] = VoxelGrid->GenerateChunk(ChunkHandles[Chunk]);
+				ChunkSeconds[Chunk] = FPlatformTime::Seconds() - ChunkStartTime;
+			}
+		}));
+	}
+	UE::Tasks::Wait(Tasks);
+
+	const double TotalSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// Later stages, on one thread in chunk order and then again in reverse from the same Terrain.
+	// A stage may only rely on what earlier stages made, so both orders have to agree.
+	int32 StagedChunks = 0;
+	int32 StageMismatches = 0;
+	double StageSeconds = 0.0;
+
+	if(VoxelGrid->GetGenerator()->HasLaterStages())
+	{
+		TArray<FFGVoxelChunk> TerrainChunks;
+		Algo::Transform(ChunkHandles, TerrainChunks, [](const FFGChunkHandle& ChunkHandle) { return *ChunkHandle->ChunkData; });
+
+		const double StageStartTime = FPlatformTime::Seconds();
+		StagedChunks = FG::Private::RunBenchStages(VoxelGrid->GetGenerator(), ChunkHandles, NeedsStages, false);
+		StageSeconds = FPlatformTime::Seconds() - StageStartTime;
+
+		TArray<FFGVoxelChunk> ForwardChunks;
+		for(int32 Chunk = 0; Chunk < ChunkHandles.Num(); Chunk++)
+		{
+			ForwardChunks.Add(MoveTemp(*ChunkHandles[Chunk]->ChunkData));
+			*ChunkHandles[Chunk]->ChunkData = MoveTemp(TerrainChunks[Chunk]);
+		}
+
+		FG::Private::RunBenchStages(VoxelGrid->GetGenerator(), ChunkHandles, NeedsStages, true);
+
+		TArray<uint16> ForwardVoxels, ReverseVoxels;
+		ForwardVoxels.SetNumUninitialized(ChunkSizeXYZ);
+		ReverseVoxels.SetNumUninitialized(ChunkSizeXYZ);
+
+		for(int32 Chunk = 0; Chunk < ChunkHandles.Num(); Chunk++)
+		{
+			ForwardChunks[Chunk].DecodeAll(ForwardVoxels);
+			ChunkHandles[Chunk]->ChunkData->DecodeAll(ReverseVoxels);
+
+			if(ForwardVoxels != ReverseVoxels)
+			{
+				UE_LOGFMT(LogTemp, Error, "Chunk {Chunk} came out different when the stages ran in reverse order.", ChunkHandles[Chunk]->ChunkCoordinate.ToString());
+				StageMismatches++;
+			}
+		}
+	}
+
+	// Memory by bits per voxel class, and how many types each chunk ended up with.
+	TMap<int32, TPair<int32, int64>> BitsClasses; // Bits -> (chunks, bytes).
+	TMap<int32, int32> PaletteHistogram;
+
+	for(const FFGChunkHandle& ChunkHandle : ChunkHandles)
+	{
+		const FFGVoxelChunk& ChunkData = *ChunkHandle->ChunkData;
+
+		TPair<int32, int64>& BitsClass = BitsClasses.FindOrAdd(ChunkData.GetBitsPerVoxel());
+		BitsClass.Key++;
+		BitsClass.Value += sizeof(FFGVoxelChunk) + ChunkData.GetAllocatedSize();
+
+		PaletteHistogram.FindOrAdd(ChunkData.GetPaletteCount())++;
+	}
+
+	TArray<double> SortedMs;
+	Algo::Transform(ChunkSeconds, SortedMs, [](double Seconds) { return Seconds * 1000.0; });
+	SortedMs.Sort();
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("generator"), GeneratorName);
+	Report->SetNumberField(TEXT("chunks"), ChunkHandles.Num());
+	Report->SetNumberField(TEXT("threads"), NumThreads);
+	Report->SetNumberField(TEXT("total_seconds"), TotalSeconds);
+	Report->SetNumberField(TEXT("chunks_per_second"), ChunkHandles.Num() / FMath::Max(TotalSeconds, UE_DOUBLE_SMALL_NUMBER));
+	Report->SetNumberField(TEXT("p50_ms"), FG::Private::GetPercentile(SortedMs, 0.50));
+	Report->SetNumberField(TEXT("p99_ms"), FG::Private::GetPercentile(SortedMs, 0.99));
+	Report->SetNumberField(TEXT("max_ms"), SortedMs.IsEmpty() ? 0.0 : SortedMs.Last());
+	Report->SetNumberField(TEXT("staged_chunks"), StagedChunks);
+	Report->SetNumberField(TEXT("stage_seconds"), StageSeconds);
+	Report->SetNumberField(TEXT("stage_order_mismatches"), StageMismatches);
+
+	BitsClasses.KeySort(TLess<int32>());
+	TArray<TSharedPtr<FJsonValue>> BitsArray;
+	for(const TPair<int32, TPair<int32, int64>>& BitsClass : BitsClasses)
+	{
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetNumberField(TEXT("bits_per_voxel"), BitsClass.Key);
+		Entry->SetNumberField(TEXT("chunks"), BitsClass.Value.Key);
+		Entry->SetNumberField(TEXT("bytes_per_chunk"), (double)BitsClass.Value.Value / BitsClass.Value.Key);
+		BitsArray.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+	Report->SetArrayField(TEXT("bits_per_voxel"), BitsArray);
+
+	PaletteHistogram.KeySort(TLess<int32>());
+	TArray<TSharedPtr<FJsonValue>> PaletteArray;
+	for(const TPair<int32, int32>& Bucket : PaletteHistogram)
+	{
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetNumberField(TEXT("palette_size"), Bucket.Key);
+		Entry->SetNumberField(TEXT("chunks"), Bucket.Value);
+		PaletteArray.Add(MakeShared<FJsonValueObject>(Entry));
+	}
+	Report->SetArrayField(TEXT("palette_histogram"), PaletteArray);
+
+	// Single threaded noise at every level, so hardware can be compared without the rest of generation.
+	Report->SetStringField(TEXT("noise_simd_level"), FG::GetNoiseSIMDLevelName(FG::GetNoiseSIMDLevel()));
+
+	TArray<TSharedPtr<FJsonValue>> NoiseArray;
+	for(const FastSIMD::eLevel Level : FG::GetSupportedNoiseSIMDLevels())
+	{
+		constexpr int32 NoisePatches = 4096;
+		const double SamplesPerSecond = FG::MeasureNoiseThroughput(UFGVoxelGeneratorNatural::HeightNoiseTree, Level, NoisePatches);
+
+		TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+		Entry->SetStringField(TEXT("level"), FG::GetNoiseSIMDLevelName(Level));
+		Entry->SetNumberField(TEXT("msamples_per_second"), SamplesPerSecond);
+		NoiseArray.Add(MakeShared<FJsonValueObject>(Entry));
+
+		UE_LOGFMT(LogTemp, Display, "FGVoxelBench noise [{Level}] {Rate} Msamples/s", FG::GetNoiseSIMDLevelName(Level), SamplesPerSecond);
+	}
+	Report->SetArrayField(TEXT("noise_levels"), NoiseArray);
+
+	FString Json;
+	FJsonSerializer::Serialize(Report, TJsonWriterFactory<>::Create(&Json));
+
+	if(StagedChunks > 0)
+	{
+		UE_LOGFMT(LogTemp, Display, "FGVoxelBench ran later stages on {Num} chunks in {Seconds} s, {Mismatches} differed by order.", StagedChunks, StageSeconds, StageMismatches);
+	}
+
+	UE_LOGFMT(LogTemp, Display, "FGVoxelBench {Rate} chunks/s, p50 {P50} ms, p99 {P99} ms, written to {Path}",
+		ChunkHandles.Num() / FMath::Max(TotalSeconds, UE_DOUBLE_SMALL_NUMBER),
+		FG::Private::GetPercentile(SortedMs, 0.50),
+		FG::Private::GetPercentile(SortedMs, 0.99),
+		OutputPath);
+
+	ChunkHandles.Empty();
+	VoxelGrid->FlushAllChunks();
+	VoxelGrid->RemoveFromRoot();
+
+	if(!FFileHelper::SaveStringToFile(Json, *OutputPath))
+	{
+		UE_LOGFMT(LogTemp, Error, "Failed to write benchmark results to {Path}.", OutputPath);
+		return 1;
+	}
+	return StageMismatches > 0 ? 1 : 0;
+}
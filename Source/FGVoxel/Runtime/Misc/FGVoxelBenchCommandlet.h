@@ -0,0 +1,35 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "FGVoxelBenchCommandlet.generated.h"
+
+/**
+ * Headless chunk generation benchmark, no world or rendering involved.
+ *
+ * Generates a region of chunks through UFGVoxelGrid with the chosen generator
+ * and writes throughput, per chunk latency percentiles, bytes per chunk by
+ * bits per voxel and a palette size histogram out as JSON for CI to diff.
+ * Generators with stages after Terrain also run them on the inside of the
+ * region, twice in opposite chunk orders, and fail if the results differ.
+ *
+ * UnrealEditor-Cmd FactoryGame -run=FGVoxelBench
+ *	-Generator=Natural|Flat|Density	Generator to benchmark, defaults to Natural.
+ *	-SizeXY=N -SizeZ=M			Region to generate in chunks, N x N x M centred on the origin.
+ *	-Threads=T					Generation tasks to run at once, defaults to the worker count.
+ *	-Output=Path				Where to write the JSON, defaults to Saved/Benchmarks/FGVoxelBench.json.
+ */
+UCLASS()
+class UFGVoxelBenchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+
+	UFGVoxelBenchCommandlet();
+
+	//~ Begin Super
+	int32 Main(const FString& Params) override;
+	//~ End Super
+};
@@ -0,0 +1,348 @@
+﻿// Copyright (C) Daft Software 2024, All Rights Reserved.
+// Author: Sunny Blake-Webber
+
+#include "FGVoxelDefines.h"
+#include "Containers/FGVoxelChunk.h"
+#include "Containers/FGChunkKey.h"
+#include "Containers/FGVoxelGrid.h"
+#include "Generators/FGVoxelGeneratorDensity.h"
+#include "Generators/FGVoxelGeneratorNatural.h"
+#include "Generators/FGVoxelNoise.h"
+#include "Logging/StructuredLog.h"
+
+/**
+ * Micro benchmarks for the voxel containers, these run synchronously on
+ * the calling thread so expect a hitch when you run them in game.
+ */
+namespace FG
+{
+	static int32 BenchIterations = 16;
+	FAutoConsoleVariableRef CVarBenchIterations (
+		TEXT("FG.Bench.Iterations"),
+		BenchIterations,
+		TEXT("How many times each voxel benchmark is repeated."),
+		ECVF_Default
+	);
+
+	static FAutoConsoleCommand CmdBenchChunkSetVoxel(
+		TEXT("FG.Bench.ChunkSetVoxel"),
+		TEXT("Benchmarks FFGVoxelChunk::SetVoxel throughput at 1, 4, 16 and 256 palette entries."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			using namespace FG::Const;
+
+			for(const int32 NumTypes : { 1, 4, 16, 256 })
+			{
+				double FillSeconds = 0.0;
+				double OverwriteSeconds = 0.0;
+
+				for(int32 Iteration = 0; Iteration < BenchIterations; Iteration++)
+				{
+					FFGVoxelChunk Chunk;
+
+					// Fill pass, includes the cost of growing the palette from empty.
+					double StartTime = FPlatformTime::Seconds();
+					for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+					{
+						Chunk.SetVoxel(Voxel, 1 + (Voxel % NumTypes)); // Offset by 1 so we never write air.
+					}
+					FillSeconds += FPlatformTime::Seconds() - StartTime;
+
+					// Overwrite pass, palette is already at it's final size.
+					StartTime = FPlatformTime::Seconds();
+					for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+					{
+						Chunk.SetVoxel(Voxel, 1 + ((Voxel + 1) % NumTypes));
+					}
+					OverwriteSeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				const double NumVoxels = (double)ChunkSizeXYZ * BenchIterations;
+
+				UE_LOGFMT(LogTemp, Display, "SetVoxel [{NumTypes} palette entries] Fill: {FillRate} Mvox/s, Overwrite: {OverwriteRate} Mvox/s",
+					NumTypes,
+					NumVoxels / FMath::Max(FillSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumVoxels / FMath::Max(OverwriteSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand CmdBenchChunkAccess(
+		TEXT("FG.Bench.ChunkAccess"),
+		TEXT("Benchmarks sequential and random voxel reads / writes, plus raw bit access at every width from 1 to 16."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			using namespace FG::Const;
+
+			UE_LOGFMT(LogTemp, Display, "Word aligned storage: {Aligned}", FG_VOXEL_WORD_ALIGNED_STORAGE ? TEXT("On") : TEXT("Off"));
+
+			// Same shuffled order for every run so results are comparable.
+			TArray<int32> RandomOrder;
+			RandomOrder.SetNumUninitialized(ChunkSizeXYZ);
+			for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+			{
+				RandomOrder[Voxel] = Voxel;
+			}
+
+			FRandomStream Stream(1337);
+			for(int32 Voxel = ChunkSizeXYZ - 1; Voxel > 0; Voxel--)
+			{
+				RandomOrder.Swap(Voxel, Stream.RandRange(0, Voxel));
+			}
+
+			const double NumVoxels = (double)ChunkSizeXYZ * BenchIterations;
+
+			for(const int32 NumTypes : { 2, 4, 16, 256 })
+			{
+				FFGVoxelChunk Chunk;
+				for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+				{
+					Chunk.SetVoxel(Voxel, Voxel % NumTypes);
+				}
+
+				uint64 Checksum = 0; // Stops the reads from being optimized away.
+				double SeqReadSeconds = 0.0;
+				double RandReadSeconds = 0.0;
+				double SeqWriteSeconds = 0.0;
+				double RandWriteSeconds = 0.0;
+
+				for(int32 Iteration = 0; Iteration < BenchIterations; Iteration++)
+				{
+					double StartTime = FPlatformTime::Seconds();
+					for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+					{
+						Checksum += Chunk.GetVoxel(Voxel);
+					}
+					SeqReadSeconds += FPlatformTime::Seconds() - StartTime;
+
+					StartTime = FPlatformTime::Seconds();
+					for(const int32 Voxel : RandomOrder)
+					{
+						Checksum += Chunk.GetVoxel(Voxel);
+					}
+					RandReadSeconds += FPlatformTime::Seconds() - StartTime;
+
+					// Rotate types by one each pass so every write is a real change.
+					StartTime = FPlatformTime::Seconds();
+					for(int32 Voxel = 0; Voxel < ChunkSizeXYZ; Voxel++)
+					{
+						Chunk.SetVoxel(Voxel, (Voxel + Iteration * 2 + 1) % NumTypes);
+					}
+					SeqWriteSeconds += FPlatformTime::Seconds() - StartTime;
+
+					StartTime = FPlatformTime::Seconds();
+					for(const int32 Voxel : RandomOrder)
+					{
+						Chunk.SetVoxel(Voxel, (Voxel + Iteration * 2 + 2) % NumTypes);
+					}
+					RandWriteSeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				UE_LOGFMT(LogTemp, Display, "Access [{NumTypes} types, {Bits} bits] SeqRead: {SeqRead} RandRead: {RandRead} SeqWrite: {SeqWrite} RandWrite: {RandWrite} Mvox/s ({Checksum})",
+					NumTypes,
+					Chunk.GetBitsPerVoxel(),
+					NumVoxels / FMath::Max(SeqReadSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumVoxels / FMath::Max(RandReadSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumVoxels / FMath::Max(SeqWriteSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumVoxels / FMath::Max(RandWriteSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					Checksum);
+			}
+
+			// Raw bit access, tight TBitArray ranges vs aligned shift / mask at the same width.
+			for(int32 Bits = 1; Bits <= 16; Bits++)
+			{
+				TBitArray<> Data(false, ChunkSizeXYZ * 16);
+				const uint32 ValueMask = (1u << Bits) - 1;
+
+				uint64 Checksum = 0;
+				double RangeSeconds = 0.0;
+				double AlignedSeconds = 0.0;
+
+				for(int32 Iteration = 0; Iteration < BenchIterations; Iteration++)
+				{
+					double StartTime = FPlatformTime::Seconds();
+					for(const int32 Voxel : RandomOrder)
+					{
+						const uint32 Value = (Voxel + Iteration) & ValueMask;
+						Data.SetRangeFromRange(Voxel * Bits, Bits, &Value);
+
+						uint32 ReadBack = 0;
+						Data.GetRange(Voxel * Bits, Bits, &ReadBack);
+						Checksum += ReadBack;
+					}
+					RangeSeconds += FPlatformTime::Seconds() - StartTime;
+
+					if(32 % Bits != 0) // Aligned access only exists for widths that divide a word.
+					{
+						continue;
+					}
+
+					StartTime = FPlatformTime::Seconds();
+					for(const int32 Voxel : RandomOrder)
+					{
+						const uint32 Value = (Voxel + Iteration) & ValueMask;
+						FFGBitArrayMemory::SetAligned(Data.GetData(), Voxel * Bits, Bits, Value);
+						Checksum += FFGBitArrayMemory::GetAligned(Data.GetData(), Voxel * Bits, Bits);
+					}
+					AlignedSeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				UE_LOGFMT(LogTemp, Display, "Bits [{Bits}] Range: {RangeRate} Aligned: {AlignedRate} Mvox/s ({Checksum})",
+					Bits,
+					NumVoxels / FMath::Max(RangeSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumVoxels / FMath::Max(AlignedSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					Checksum);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand CmdBenchChunkLookup(
+		TEXT("FG.Bench.ChunkLookup"),
+		TEXT("Benchmarks chunk coordinate lookups, TMap<FIntVector> vs Robin Hood on packed chunk keys, at 10k and 100k chunks."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			for(const int32 NumChunks : { 10000, 100000 })
+			{
+				// Roughly cube shaped region of loaded chunks around the origin, like a render volume.
+				const int32 Extent = FMath::CeilToInt(FMath::Pow((double)NumChunks, 1.0 / 3.0));
+
+				TArray<FIntVector> Coordinates;
+				Coordinates.Reserve(NumChunks);
+				for(int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+				{
+					Coordinates.Emplace(
+						Chunk % Extent - Extent / 2,
+						(Chunk / Extent) % Extent - Extent / 2,
+						Chunk / (Extent * Extent) - Extent / 2);
+				}
+
+				TMap<FIntVector, int32> CoordinateMap;
+				CoordinateMap.Reserve(NumChunks);
+
+				Experimental::TRobinHoodHashMap<FFGChunkKey, int32> KeyMap;
+
+				for(int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+				{
+					CoordinateMap.Add(Coordinates[Chunk], Chunk);
+					KeyMap.FindOrAdd(FFGChunkKey(Coordinates[Chunk]), Chunk);
+				}
+
+				// Look up in a shuffled order so we aren't just walking insertion order.
+				FRandomStream Stream(1337);
+				for(int32 Chunk = NumChunks - 1; Chunk > 0; Chunk--)
+				{
+					Coordinates.Swap(Chunk, Stream.RandRange(0, Chunk));
+				}
+
+				int64 Checksum = 0;
+				double MapSeconds = 0.0;
+				double KeySeconds = 0.0;
+
+				for(int32 Iteration = 0; Iteration < BenchIterations; Iteration++)
+				{
+					double StartTime = FPlatformTime::Seconds();
+					for(const FIntVector& Coordinate : Coordinates)
+					{
+						Checksum += *CoordinateMap.Find(Coordinate);
+					}
+					MapSeconds += FPlatformTime::Seconds() - StartTime;
+
+					StartTime = FPlatformTime::Seconds();
+					for(const FIntVector& Coordinate : Coordinates)
+					{
+						Checksum += *KeyMap.Find(FFGChunkKey(Coordinate));
+					}
+					KeySeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				const double NumLookups = (double)NumChunks * BenchIterations;
+
+				UE_LOGFMT(LogTemp, Display, "ChunkLookup [{NumChunks} chunks] TMap: {MapRate} M/s, RobinHood: {KeyRate} M/s ({Checksum})",
+					NumChunks,
+					NumLookups / FMath::Max(MapSeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					NumLookups / FMath::Max(KeySeconds, UE_DOUBLE_SMALL_NUMBER) / 1e6,
+					Checksum);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand CmdBenchNoise(
+		TEXT("FG.Bench.Noise"),
+		TEXT("Benchmarks the natural generator's height noise at every SIMD level this CPU supports."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			constexpr int32 PatchesPerIteration = 256; // Single patches are too quick to time.
+
+			UE_LOGFMT(LogTemp, Display, "Noise SIMD level in use: {Level}", GetNoiseSIMDLevelName(GetNoiseSIMDLevel()));
+
+			for(const FastSIMD::eLevel Level : GetSupportedNoiseSIMDLevels())
+			{
+				UE_LOGFMT(LogTemp, Display, "Noise [{Level}] {Rate} Msamples/s",
+					GetNoiseSIMDLevelName(Level),
+					MeasureNoiseThroughput(UFGVoxelGeneratorNatural::HeightNoiseTree, Level, BenchIterations * PatchesPerIteration));
+			}
+		})
+	);
+
+	static FAutoConsoleCommand CmdBenchGenerators(
+		TEXT("FG.Bench.Generators"),
+		TEXT("Benchmarks the 2D natural generator against the 3D density one over the same chunks, on this thread."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			using namespace FG::Const;
+
+			if(GVoxelTypeMap.IsEmpty())
+			{
+				UE_LOGFMT(LogTemp, Error, "FG.Bench.Generators needs voxel types, run it in a world.");
+				return;
+			}
+
+			// Columns across the surface, from chunks deep enough for caves up to the sky above the hills.
+			constexpr int32 SizeXY = 8;
+			constexpr int32 MinZ = -3;
+			constexpr int32 MaxZ = 2;
+
+			for(const TSubclassOf<UFGVoxelGenerator> GeneratorType : { UFGVoxelGeneratorNatural::StaticClass(), UFGVoxelGeneratorDensity::StaticClass() })
+			{
+				UFGVoxelGenerator* Generator = NewObject<UFGVoxelGenerator>(GetTransientPackage(), GeneratorType);
+				Generator->ResolveVoxelTypes();
+
+				FFGVoxelChunk Chunk;
+				FFGChunkHandle ChunkHandle = MakeShared<FFGChunkHandleData>();
+				ChunkHandle->ChunkData = &Chunk;
+
+				double Seconds = 0.0;
+				int32 NumChunks = 0;
+				int32 NumUniform = 0;
+
+				for(int32 Iteration = 0; Iteration < BenchIterations; Iteration++)
+				{
+					for(int32 Z = MinZ; Z <= MaxZ; Z++)
+					{
+						for(int32 Y = 0; Y < SizeXY; Y++)
+						{
+							for(int32 X = 0; X < SizeXY; X++)
+							{
+								Chunk.Reset();
+								ChunkHandle->ChunkCoordinate = FIntVector(X, Y, Z);
+
+								const double StartTime = FPlatformTime::Seconds();
+								Generator->Generate(Chunk, ChunkHandle);
+								Seconds += FPlatformTime::Seconds() - StartTime;
+
+								NumChunks++;
+								NumUniform += Chunk.IsUniform();
+							}
+						}
+					}
+				}
+
+				UE_LOGFMT(LogTemp, Display, "Generator [{Generator}] {Ms} ms/chunk, {Rate} chunks/s, {Uniform}% uniform",
+					GeneratorType->GetName(),
+					Seconds * 1000.0 / NumChunks,
+					NumChunks / FMath::Max(Seconds, UE_DOUBLE_SMALL_NUMBER),
+					100.0 * NumUniform / NumChunks);
+			}
+		})
+	);
+}
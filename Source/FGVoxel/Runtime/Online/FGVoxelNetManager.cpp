@@ -80,8 +80,20 @@ void UFGVoxelGameStateSubsystem::Tick(float DeltaTime)
 		// @TODO: Review this is safe to use these load handles yet, because we use async task
 		// to actually make them, so i'm assuming the answer is no.
 		
-		// Load the new chunks asynchronously.
+		// Load the new chunks asynchronously, held until it finishes since dropping it cancels the load.
 		FFGVoxelLoadHandle LoadHandle = VoxSys->VoxelGrid->LoadChunkBatchAsync(UnloadedChunks);
+		if(!UnloadedChunks.IsEmpty())
+		{
+			PendingLoads.Add(LoadHandle);
+			LoadHandle->OnFinishedLoadingBatch.AddWeakLambda(this, [this, LoadHandlePtr = LoadHandle.Get()](TArray<FFGChunkHandle>)
+			{
+				PendingLoads.RemoveAllSwap([LoadHandlePtr](const FFGVoxelLoadHandle& PendingLoad)
+				{
+					return PendingLoad.Get() == LoadHandlePtr;
+				});
+			});
+		}
+
 		for(int32 Idx = 0; Idx < LoadHandle->GetBatchSize(); Idx++)
 		{
 			TrackedChunks.Add(LoadHandle->ChunkCoordinates[Idx], LoadHandle->ChunkHandles[Idx]);
@@ -157,6 +157,7 @@ public:
 	TMap<TWeakObjectPtr<APlayerController>, TSet<FIntVector>>		PendingClientUpdates;
 	
 	TMap<FIntVector, FFGChunkHandle>		TrackedChunks;
+	TArray<FFGVoxelLoadHandle>				PendingLoads;
 	TMap<FIntVector, TArray<FFGVoxelEdit>>	PendingVoxelEdits;
 
 	TMulticastDelegate<void(FFGVoxelEdit)> VoxelEditValidated;
@@ -16,9 +16,13 @@ void AFGVoxelActorManager::BeginPlay()
 
 	VoxSys->OnRenderCoordinatesFinishedLoading.AddWeakLambda(this, [this](TArray<FIntVector> Coordinates)
 	{
+		auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
+
 		for(FIntVector Coordinate : Coordinates)
 		{
+			const double StartTime = FPlatformTime::Seconds();
 			OnChunkLoaded(Coordinate);
+			VoxelGrid->RecordChunkStageCost(EFGChunkStage::ActorSpawn, FPlatformTime::Seconds() - StartTime);
 		}
 	});
 	
@@ -63,14 +67,24 @@ void AFGVoxelActorManager::OnChunkLoaded(FIntVector ChunkCoordinate)
 {
 	auto& VoxelGrid = GetWorld()->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
 	FFGChunkHandle ChunkHandle = VoxelGrid->FindChunkChecked(ChunkCoordinate);
+	FFGVoxelChunk* ChunkData = VoxelGrid->GetChunkDataUnsafe(ChunkHandle);
+
+	if(ChunkData->IsUniform() && !ClassMappings.Contains(ChunkData->GetUniformType())) // Nothing to spawn.
+	{
+		return;
+	}
+
+	TArray<uint16> DecodedVoxels;
+	DecodedVoxels.SetNumUninitialized(FG::Const::ChunkSizeXYZ);
+	ChunkData->DecodeAll(DecodedVoxels);
 
 	for(int32 Voxel = 0; Voxel < FG::Const::ChunkSizeXYZ; Voxel++)
 	{
-		FIntVector VoxelCoordinate = UFGVoxelUtils::UnflattenVoxelCoord(Voxel);
-		int32 VoxelType = VoxelGrid->GetChunkDataUnsafe(ChunkHandle)->GetVoxel(Voxel);
+		int32 VoxelType = DecodedVoxels[Voxel];
 
 		if(ClassMappings.Contains(VoxelType))
 		{
+			FIntVector VoxelCoordinate = UFGVoxelUtils::UnflattenVoxelCoord(Voxel);
 			TSoftClassPtr<AFGVoxelActor> Class = ClassMappings.FindChecked(VoxelType);
 			TObjectPtr<AFGVoxelActor>& ChunkActor = ActorMappings.FindOrAdd(FFGVoxelRef(ChunkCoordinate, VoxelCoordinate));
 			
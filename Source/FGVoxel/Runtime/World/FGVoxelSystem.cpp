@@ -15,6 +15,7 @@
 #include "Engine/AssetManager.h"
 #include "Logging/StructuredLog.h"
 #include "Misc/FGVoxelMetadata.h"
+#include "FGVoxelStats.h"
 
 namespace FG
 {
@@ -58,6 +59,57 @@ namespace FG
 		ECVF_Default
 	);
 
+	static bool ChunkPrefetch = true;
+	FAutoConsoleVariableRef CVarChunkPrefetch (
+		TEXT("FG.ChunkPrefetch"),
+		ChunkPrefetch,
+		TEXT("Prefetch chunks ahead of the view based on it's velocity and look direction. (0/1)"),
+		ECVF_Default
+	);
+
+	static float ChunkPrefetchSeconds = 1.5f;
+	FAutoConsoleVariableRef CVarChunkPrefetchSeconds (
+		TEXT("FG.ChunkPrefetchSeconds"),
+		ChunkPrefetchSeconds,
+		TEXT("How far ahead in time to extrapolate the view when prefetching."),
+		ECVF_Default
+	);
+
+	static float ChunkPrefetchLookWeight = 0.5f;
+	FAutoConsoleVariableRef CVarChunkPrefetchLookWeight (
+		TEXT("FG.ChunkPrefetchLookWeight"),
+		ChunkPrefetchLookWeight,
+		TEXT("How much the look direction bends the prefetch prediction, 0 follows velocity only."),
+		ECVF_Default
+	);
+
+	static int32 ChunkPrefetchMaxChunks = 512;
+	FAutoConsoleVariableRef CVarChunkPrefetchMaxChunks (
+		TEXT("FG.ChunkPrefetchMaxChunks"),
+		ChunkPrefetchMaxChunks,
+		TEXT("Most chunks that can be prefetched at once, closest first."),
+		ECVF_Default
+	);
+
+	static FAutoConsoleCommandWithWorld CmdChunkPrefetchStats(
+		TEXT("FG.ChunkPrefetchStats"),
+		TEXT("Logs how often chunks were missing when the player entered a new chunk, then resets the counters. Compare with FG.ChunkPrefetch on and off."),
+		FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+		{
+			auto* VoxSys = World->GetSubsystem<UFGVoxelSystem>();
+			const UFGVoxelSystem::FPrefetchStats& Stats = VoxSys->PrefetchStats;
+
+			UE_LOGFMT(LogTemp, Display, "Prefetch [{State}] Entries: {Entries}, missing mesh on entry: {MissingPct}%, new chunks not generated on entry: {RingPct}% of {Ring}",
+				FG::ChunkPrefetch ? TEXT("On") : TEXT("Off"),
+				Stats.ChunkEntries,
+				Stats.ChunkEntries > 0 ? 100.0 * Stats.EntriesMissingMesh / Stats.ChunkEntries : 0.0,
+				Stats.RingChunks > 0 ? 100.0 * Stats.RingChunksMissing / Stats.RingChunks : 0.0,
+				Stats.RingChunks);
+
+			VoxSys->PrefetchStats = UFGVoxelSystem::FPrefetchStats();
+		})
+	);
+
 	static FAutoConsoleCommandWithWorld CmdInvalidateRendering(
 		TEXT("FG.FlushRendering"),
 		TEXT("Flushes rendering chunks, reloading any chunks in the render volume."),
@@ -78,6 +130,16 @@ namespace FG
 		})
 	);
 
+	static FAutoConsoleCommandWithWorld CmdSaveVoxelWorld(
+		TEXT("FG.SaveVoxelWorld"),
+		TEXT("Writes every edited chunk to it's region file and waits for it to hit disk."),
+		FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+		{
+			auto* VoxSys = World->GetSubsystem<UFGVoxelSystem>();
+			VoxSys->VoxelGrid->SaveModifiedChunks(true);
+		})
+	);
+
 	static FAutoConsoleCommandWithWorld CmdDumpVoxelIds(
 		TEXT("FG.DumpVoxelIds"),
 		TEXT("Dump to log all voxel identifiers."),
@@ -100,24 +162,66 @@ namespace FG
 
 			auto& VoxelGrid = World->GetSubsystem<UFGVoxelSystem>()->VoxelGrid;
 			
-			FFGChunkHandle ChunkHandle = VoxelGrid->FindChunk(PlayerCoord);
+			FFGChunkHandle ChunkHandle = VoxelGrid->FindGeneratedChunk(PlayerCoord);
 
 			if(ChunkHandle.IsValid())
 			{
 				FFGVoxelChunk* ChunkData = VoxelGrid->GetChunkDataSafe(ChunkHandle);
 
+				TArray<uint16> DecodedVoxels;
+				DecodedVoxels.SetNumUninitialized(Const::ChunkSizeXYZ);
+				ChunkData->DecodeAll(DecodedVoxels);
+
 				FString DumpString;
+				DumpString.Reserve(Const::ChunkSizeXYZ);
 
 				for(int32 Voxel = 0; Voxel < Const::ChunkSizeXYZ; Voxel++)
 				{
-					const FIntVector VoxelCoordinate = UFGVoxelUtils::UnflattenVoxelCoord(Voxel);
-					DumpString.Append(FString::FromInt(ChunkData->GetVoxel(VoxelCoordinate)));
+					DumpString.AppendInt(DecodedVoxels[Voxel]);
 				}
 
 				UE_LOGFMT(LogTemp, Warning, "Chunk Memory Dump: {DumpStr}", DumpString);
 			}
 		})
 	);
+
+	static FAutoConsoleCommandWithWorld CmdDumpUniformChunks(
+		TEXT("FG.DumpUniformChunks"),
+		TEXT("Dump how many chunks in the render volume are uniform, and the memory that saves."),
+		FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+		{
+			auto* VoxSys = World->GetSubsystem<UFGVoxelSystem>();
+
+			// What the smallest non uniform chunk costs, which is what every chunk used to cost.
+			FFGVoxelChunk ExpandedChunk;
+			ExpandedChunk.SetVoxel(0, VOXELTYPE_NONE + 1);
+			const SIZE_T ExpandedSize = ExpandedChunk.GetAllocatedSize();
+
+			int32 UniformAir = 0;
+			int32 UniformSolid = 0;
+			SIZE_T TotalSize = 0;
+			SIZE_T SavedSize = 0;
+
+			for(const auto& Renderable : VoxSys->RenderableHandles)
+			{
+				const FFGVoxelChunk* ChunkData = VoxSys->VoxelGrid->GetChunkDataUnsafe(Renderable.Value);
+				TotalSize += ChunkData->GetAllocatedSize();
+
+				if(ChunkData->IsUniform())
+				{
+					ChunkData->GetUniformType() == VOXELTYPE_NONE ? UniformAir++ : UniformSolid++;
+					SavedSize += ExpandedSize - ChunkData->GetAllocatedSize();
+				}
+			}
+
+			UE_LOGFMT(LogTemp, Display, "Render volume: {Num} chunks, {Air} uniform air, {Solid} uniform solid. Using {UsedKB} KB, saved {SavedKB} KB.",
+				VoxSys->RenderableHandles.Num(),
+				UniformAir,
+				UniformSolid,
+				TotalSize / 1024,
+				SavedSize / 1024);
+		})
+	);
 }
 
 UFGVoxelSystem::UFGVoxelSystem() :
@@ -141,6 +245,8 @@ void UFGVoxelSystem::PostInitialize()
 		VoxelGrid->SetGeneratorType(DefaultGeneratorClass);
 	}
 
+	VoxelGrid->OnStageReadsReleased.AddUObject(this, &ThisClass::ApplyDeferredEdits);
+
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.ObjectFlags |=	RF_Transient;
 	SpawnParams.ObjectFlags &= ~RF_Transactional;
@@ -208,6 +314,9 @@ void UFGVoxelSystem::Tick(float DeltaTime)
 		DrawDebugChunkData(PlayerCoord);
 	}
 
+	SET_DWORD_STAT(STAT_FGVoxel_Remeshes, PendingRemeshes.Num());
+	CSV_CUSTOM_STAT(FGVoxel, Remeshes, PendingRemeshes.Num(), ECsvCustomStatOp::Set);
+
 	// Remesh any chunks that have been marked for remeshing.
 	for(const FIntVector& ChunkCoordinate : PendingRemeshes)
 	{
@@ -225,6 +334,12 @@ void UFGVoxelSystem::Tick(float DeltaTime)
 
 	if(PlayerCoord != LastPlayerCoord || AwaitingForcedGeneration) // Local player crossed chunk border or we forced reload.
 	{
+		if(!AwaitingForcedGeneration)
+		{
+			PrefetchStats.ChunkEntries++;
+			PrefetchStats.EntriesMissingMesh += !RenderableHandles.Contains(PlayerCoord);
+		}
+
 		if(FG::DebugDrawVoxelRenderDiffs)
 		{
 			FG::DebugDrawBox(
@@ -271,13 +386,13 @@ void UFGVoxelSystem::Tick(float DeltaTime)
 		
 		for(FIntVector2& SpiralCoordinate : LoadSpiral) // Iterate the XY plane.
 		{
-			// @TODO: This currently iterates upwards not downwards.
-			for(double Z = NewRenderVolume.Min.Z; Z < NewRenderVolume.Max.Z; Z += ChunkSizeXUU) // Iterate chunk column downwards.
+			// Top down, so chunks at the surface are queued ahead of the ones buried under them.
+			for(int32 ChunkZ = GRenderSizeX - 1; ChunkZ >= 0; ChunkZ--) // Iterate chunk column downwards.
 			{
 				const FVector AdditionLocation = FVector(
 					NewRenderVolume.Min.X + SpiralCoordinate.X * ChunkSizeXUU,
 					NewRenderVolume.Min.Y + SpiralCoordinate.Y * ChunkSizeXUU,
-					Z) + ChunkExtentXUU;
+					NewRenderVolume.Min.Z + ChunkZ * ChunkSizeXUU) + ChunkExtentXUU;
 
 				if(!FMath::PointBoxIntersection(AdditionLocation, LastRenderVolume) || AwaitingForcedGeneration)
 				{
@@ -290,6 +405,7 @@ void UFGVoxelSystem::Tick(float DeltaTime)
 		for(FIntVector Removal : RenderRemovals)
 		{
 			RenderableHandles.Remove(Removal);
+			PendingRenderLoads.Remove(Removal); // Drops the load, cancelling it if it hasn't started.
 			
 			if(FG::DebugDrawVoxelRenderDiffs)
 			{
@@ -303,34 +419,143 @@ void UFGVoxelSystem::Tick(float DeltaTime)
 		// in which case the renderer goes yo wtf are you talking about i've never met this man
 		// in my life.
 
-		// Async load anything that entered the render distance.
-		FFGVoxelLoadHandle LoadHandle = VoxelGrid->LoadChunkBatchAsync(RenderAdditions);
+		// Async load anything that entered the render distance. One load per chunk so each one can
+		// be cancelled on it's own if we move away before the grid gets round to it.
 		RenderableHandles.Reserve(RenderableHandles.Num() + RenderAdditions.Num());
+		PendingRenderLoads.Reserve(PendingRenderLoads.Num() + RenderAdditions.Num());
 
-		// Chunk in batch finished loading.
-		LoadHandle->OnFinishedLoadingChunk.AddWeakLambda(this, [this](FFGChunkHandle LoadedChunk)
+		for(const FIntVector& Addition : RenderAdditions)
 		{
-			RenderableHandles.Add(LoadedChunk->ChunkCoordinate, LoadedChunk);
-			OnRenderCoordinatesFinishedLoading.Broadcast({ LoadedChunk->ChunkCoordinate });
-		});
+			if(!AwaitingForcedGeneration)
+			{
+				PrefetchStats.RingChunks++;
+				PrefetchStats.RingChunksMissing += !VoxelGrid->IsChunkGenerated(Addition);
+			}
 
-		// Entire batch finished loading.
-		LoadHandle->OnFinishedLoadingBatch.AddWeakLambda(this, [this](TArray<FFGChunkHandle> LoadedChunks)
-		{
-			if(FG::DebugDrawVoxelRenderDiffs)
+			// Merges onto the prefetch if there was one, so we can let go of it once we hold our own.
+			FFGVoxelLoadHandle LoadHandle = VoxelGrid->LoadChunkAsync(Addition);
+
+			LoadHandle->OnFinishedLoadingChunk.AddWeakLambda(this, [this](FFGChunkHandle LoadedChunk)
 			{
-				for(int32 Chunk = 0; Chunk < LoadedChunks.Num(); Chunk++)
+				PendingRenderLoads.Remove(LoadedChunk->ChunkCoordinate);
+				RenderableHandles.Add(LoadedChunk->ChunkCoordinate, LoadedChunk);
+				OnRenderCoordinatesFinishedLoading.Broadcast({ LoadedChunk->ChunkCoordinate });
+
+				if(FG::DebugDrawVoxelRenderDiffs)
 				{
-					UFGVoxelUtils::DebugDrawChunk(GetWorld(), LoadedChunks[Chunk]->ChunkCoordinate, FLinearColor::Green);
+					UFGVoxelUtils::DebugDrawChunk(GetWorld(), LoadedChunk->ChunkCoordinate, FLinearColor::Green);
 				}
-			}
-		});
+			});
+
+			PendingRenderLoads.Add(Addition, MoveTemp(LoadHandle));
+			PrefetchLoads.Remove(Addition);
+		}
 
 		OnRenderCoordinatesAdded.Broadcast(MoveTemp(RenderAdditions));
 
 		AwaitingForcedGeneration = false;
 		LastPlayerCoord = PlayerCoord;
 	}
+
+	UpdatePrefetch(ViewXForm, DeltaTime, PlayerCoord);
+
+	SET_DWORD_STAT(STAT_FGVoxel_RenderLoads, PendingRenderLoads.Num());
+	SET_DWORD_STAT(STAT_FGVoxel_PrefetchLoads, PrefetchLoads.Num());
+	CSV_CUSTOM_STAT(FGVoxel, RenderLoads, PendingRenderLoads.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(FGVoxel, PrefetchLoads, PrefetchLoads.Num(), ECsvCustomStatOp::Set);
+}
+
+void UFGVoxelSystem::UpdatePrefetch(const FTransform& ViewXForm, float DeltaTime, FIntVector PlayerCoord)
+{
+	using namespace FG::Const;
+
+	const FVector ViewLocation = ViewXForm.GetLocation();
+	if(LastViewLocation.IsSet() && DeltaTime > UE_SMALL_NUMBER)
+	{
+		// Smoothed over a few frames so jitter and hitches don't throw the prediction around.
+		const FVector FrameVelocity = (ViewLocation - LastViewLocation.GetValue()) / DeltaTime;
+		ViewVelocity = FMath::Lerp(ViewVelocity, FrameVelocity, FMath::Min(DeltaTime * 4.0f, 1.0f));
+	}
+	LastViewLocation = ViewLocation;
+
+	if(!FG::ChunkPrefetch)
+	{
+		PrefetchLoads.Empty();
+		LastPrefetchCoord.Reset();
+		return;
+	}
+
+	constexpr double ChunkSizeXUU = ChunkSizeX * VoxelSizeUU;
+	constexpr double ChunkExtentXUU = ChunkSizeXUU / 2;
+	const FVector RenderVolumeExtent = FVector(GRenderSizeX * ChunkSizeX * VoxelSizeUU) / 2;
+
+	// Lean the prediction towards where we're looking, scaled by speed so standing still predicts nothing.
+	// Capped at half the render volume, past that a fresh volume's worth of loads would be in flight.
+	FVector Lead = ViewVelocity * FG::ChunkPrefetchSeconds;
+	Lead += ViewXForm.GetRotation().GetForwardVector() * Lead.Size() * FG::ChunkPrefetchLookWeight;
+	Lead = Lead.GetClampedToMaxSize(RenderVolumeExtent.X);
+
+	const FIntVector PredictedCoord = UFGVoxelUtils::VectorToChunkCoord(ViewLocation + Lead);
+
+	if(PredictedCoord == PlayerCoord)
+	{
+		PrefetchLoads.Empty(); // Slowed down or turned round, nothing ahead of us is needed any more.
+		LastPrefetchCoord.Reset();
+		return;
+	}
+
+	if(LastPrefetchCoord == PredictedCoord)
+	{
+		return;
+	}
+	LastPrefetchCoord = PredictedCoord;
+
+	// Everything the predicted render volume has that the current one doesn't.
+	const FBox CurrentRenderVolume = FBox::BuildAABB(UFGVoxelUtils::ChunkCoordToVector(PlayerCoord), RenderVolumeExtent);
+	const FBox PredictedRenderVolume = FBox::BuildAABB(UFGVoxelUtils::ChunkCoordToVector(PredictedCoord), RenderVolumeExtent);
+
+	TArray<FIntVector> PrefetchCoords;
+	for(double X = PredictedRenderVolume.Min.X; X < PredictedRenderVolume.Max.X; X += ChunkSizeXUU)
+	{
+		for(double Y = PredictedRenderVolume.Min.Y; Y < PredictedRenderVolume.Max.Y; Y += ChunkSizeXUU)
+		{
+			for(double Z = PredictedRenderVolume.Min.Z; Z < PredictedRenderVolume.Max.Z; Z += ChunkSizeXUU)
+			{
+				const FVector PrefetchLocation = FVector(X, Y, Z) + ChunkExtentXUU;
+
+				if(!FMath::PointBoxIntersection(PrefetchLocation, CurrentRenderVolume))
+				{
+					PrefetchCoords.Add(UFGVoxelUtils::VectorToChunkCoord(PrefetchLocation));
+				}
+			}
+		}
+	}
+
+	if(PrefetchCoords.Num() > FG::ChunkPrefetchMaxChunks)
+	{
+		PrefetchCoords.Sort([PlayerCoord](const FIntVector& A, const FIntVector& B)
+		{
+			return (A - PlayerCoord).SizeSquared() < (B - PlayerCoord).SizeSquared();
+		});
+		PrefetchCoords.SetNum(FMath::Max(FG::ChunkPrefetchMaxChunks, 0));
+	}
+
+	// Keep loads the new prediction still wants, anything left in the old map is dropped and cancelled.
+	TMap<FIntVector, FFGVoxelLoadHandle> NewPrefetchLoads;
+	NewPrefetchLoads.Reserve(PrefetchCoords.Num());
+
+	for(const FIntVector& PrefetchCoord : PrefetchCoords)
+	{
+		FFGVoxelLoadHandle LoadHandle;
+		if(!PrefetchLoads.RemoveAndCopyValue(PrefetchCoord, LoadHandle))
+		{
+			LoadHandle = VoxelGrid->LoadChunkAsync(PrefetchCoord);
+			LoadHandle->LowPriority = true;
+		}
+		NewPrefetchLoads.Add(PrefetchCoord, MoveTemp(LoadHandle));
+	}
+
+	PrefetchLoads = MoveTemp(NewPrefetchLoads);
 }
 
 // Don't create Voxel System in the main menu or on transient levels.
@@ -382,6 +607,11 @@ void UFGVoxelSystem::EnumerateVoxels()
 	}
 
 	VoxelActorManager->EnumerateClassMappings();
+
+	if(VoxelGrid->HasGenerator())
+	{
+		VoxelGrid->GetGenerator()->ResolveVoxelTypes();
+	}
 }
 
 void UFGVoxelSystem::InitializeRendering()
@@ -428,6 +658,9 @@ void UFGVoxelSystem::FlushRendering()
 	}
 
 	RenderableHandles.Empty();
+	PendingRenderLoads.Empty();
+	PrefetchLoads.Empty();
+	LastPrefetchCoord.Reset();
 	OnRenderCoordinatesRemoved.Broadcast(MoveTemp(RemovedChunks));
 	
 	AwaitingForcedGeneration = true;
@@ -446,7 +679,7 @@ void UFGVoxelSystem::DrawDebugChunkData(const FIntVector& ChunkCoordinate)
 	using namespace FG::Const;
 
 	const FVector ChunkLocation = UFGVoxelUtils::ChunkCoordToVector(ChunkCoordinate);
-	FFGChunkHandle ChunkHandle = VoxelGrid->FindChunk(ChunkCoordinate);
+	FFGChunkHandle ChunkHandle = VoxelGrid->FindGeneratedChunk(ChunkCoordinate);
 
 	FLinearColor ChunkDebugColor = ChunkHandle.IsValid() ? FLinearColor::White : FLinearColor::Red;
 
@@ -482,30 +715,97 @@ void UFGVoxelSystem::DrawDebugChunkData(const FIntVector& ChunkCoordinate)
 void UFGVoxelSystem::ModifyVoxel(FIntVector ChunkCoordinate, FIntVector VoxelCoordinate, int32 NewValue)
 {
 	FFGChunkHandle ChunkHandle = VoxelGrid->FindChunkChecked(ChunkCoordinate);
+
+	TSet<FIntVector> DirtyChunks;
+	TryModifyVoxel(ChunkHandle, VoxelCoordinate, NewValue, DirtyChunks);
+
+	for(FIntVector Chunk : DirtyChunks)
+	{
+		MarkForRemesh(Chunk);
+	}
+}
+
+void UFGVoxelSystem::BatchModifyVoxels(TArray<TPair<FIntVector, FIntVector>> VoxelPositions, int32 NewValue)
+{
+	TSet<FIntVector> DirtyChunks;
+	
+	for(auto VoxelPosition : VoxelPositions)
+	{
+		FFGChunkHandle ChunkHandle = VoxelGrid->FindChunkChecked(VoxelPosition.Key);
+		TryModifyVoxel(ChunkHandle, VoxelPosition.Value, NewValue, DirtyChunks);
+	}
+
+	for(FIntVector Chunk : DirtyChunks)
+	{
+		MarkForRemesh(Chunk);
+	}
+}
+
+bool UFGVoxelSystem::TryModifyVoxel(const FFGChunkHandle& ChunkHandle, FIntVector VoxelCoordinate, int32 NewValue, TSet<FIntVector>& OutDirtyChunks)
+{
+	using namespace FG::Const;
+
+	const FIntVector ChunkCoordinate = ChunkHandle->ChunkCoordinate;
+
+	if(!ChunkHandle->Generated) // A worker is still writing it, and would throw the edit away anyway.
+	{
+		UE_LOGFMT(LogTemp, Warning, "Dropped an edit to chunk {Chunk}, it's still generating.", ChunkCoordinate.ToString());
+		return false;
+	}
+
+	// A neighbour's generation stage is reading it on a worker, writing could free the voxels under it.
+	// Held back until the stage is done, behind any edits already waiting so they still land in order.
+	if(ChunkHandle->StageReaders > 0 || DeferredEdits.Contains(ChunkCoordinate))
+	{
+		DeferredEdits.FindOrAdd(ChunkCoordinate).Emplace(VoxelCoordinate, NewValue);
+		return false;
+	}
+
 	FFGVoxelChunk* ChunkDataPtr = VoxelGrid->GetChunkDataSafe(ChunkHandle);
 	
+	const bool WasUniform = ChunkDataPtr->IsUniform();
+	
 	int32 OldValue = ChunkDataPtr->GetVoxel(VoxelCoordinate);
 	ChunkDataPtr->SetVoxel(VoxelCoordinate, NewValue);
+	ChunkDataPtr->SetFlags(EFGChunkFlags::Modified); // Saved when it unloads.
+	VoxelGrid->RecordVoxelEdit(ChunkCoordinate, UFGVoxelUtils::FlattenVoxelCoord(VoxelCoordinate), OldValue, NewValue);
+
+	OutDirtyChunks.Add(ChunkCoordinate);
+
+	// Rendered neighbours mesh against this chunk. A buried uniform chunk may have been culled while
+	// this one was uniform too, and a voxel on the border changes what's visible across the face.
+	const bool BecameMixed = WasUniform && !ChunkDataPtr->IsUniform();
+	for(int32 Face = 0; Face < (int32)EFGChunkFace::Num; Face++)
+	{
+		const FIntVector FaceOffset = FFGChunkHandleData::GetFaceOffset((EFGChunkFace)Face);
+		const FIntVector BorderVoxel = VoxelCoordinate + FaceOffset;
+
+		const bool OnBorder = BorderVoxel.X < 0 || BorderVoxel.X >= ChunkSizeX
+			|| BorderVoxel.Y < 0 || BorderVoxel.Y >= ChunkSizeX
+			|| BorderVoxel.Z < 0 || BorderVoxel.Z >= ChunkSizeX;
+
+		if((BecameMixed || OnBorder) && RenderableHandles.Contains(ChunkCoordinate + FaceOffset))
+		{
+			OutDirtyChunks.Add(ChunkCoordinate + FaceOffset);
+		}
+	}
 
-	MarkForRemesh(ChunkCoordinate);
 	OnVoxelEdited.Broadcast(ChunkCoordinate, VoxelCoordinate, OldValue, NewValue);
+	return true;
 }
 
-void UFGVoxelSystem::BatchModifyVoxels(TArray<TPair<FIntVector, FIntVector>> VoxelPositions, int32 NewValue)
+void UFGVoxelSystem::ApplyDeferredEdits(FFGChunkHandle ChunkHandle)
 {
+	TArray<TPair<FIntVector, int32>> Edits;
+	if(!DeferredEdits.RemoveAndCopyValue(ChunkHandle->ChunkCoordinate, Edits))
+	{
+		return;
+	}
+
 	TSet<FIntVector> DirtyChunks;
-	
-	for(auto VoxelPosition : VoxelPositions)
+	for(const TPair<FIntVector, int32>& Edit : Edits)
 	{
-		DirtyChunks.Add(VoxelPosition.Key);
-		
-		FFGChunkHandle ChunkHandle = VoxelGrid->FindChunkChecked(VoxelPosition.Key);
-		FFGVoxelChunk* ChunkDataPtr = VoxelGrid->GetChunkDataSafe(ChunkHandle);
-        
-        int32 OldValue = ChunkDataPtr->GetVoxel(VoxelPosition.Value);
-        ChunkDataPtr->SetVoxel(VoxelPosition.Value, NewValue);
-        
-        OnVoxelEdited.Broadcast(VoxelPosition.Key, VoxelPosition.Value, OldValue, NewValue);
+		TryModifyVoxel(ChunkHandle, Edit.Key, Edit.Value, DirtyChunks);
 	}
 
 	for(FIntVector Chunk : DirtyChunks)
@@ -68,10 +68,53 @@ public:
 
 	TArray<FIntVector> PendingRemeshes;
 
+	/** Chunk entry counters, so prefetching can be measured on and off. See FG.ChunkPrefetchStats. */
+	struct FPrefetchStats
+	{
+		int32 ChunkEntries = 0;
+		int32 EntriesMissingMesh = 0;		// The chunk we stepped into wasn't renderable yet.
+		int32 RingChunks = 0;				// Chunks that entered the render volume on a chunk entry.
+		int32 RingChunksMissing = 0;		// ...of which weren't generated yet.
+	};
+
+	FPrefetchStats PrefetchStats;
+
 private:
 
+	/**
+	 * Extrapolate where the view is heading from it's velocity and look direction, and
+	 * queue low priority loads for the chunks it's about to bring into the render volume.
+	 */
+	void UpdatePrefetch(const FTransform& ViewXForm, float DeltaTime, FIntVector PlayerCoord);
+
+	/**
+	 * Write a voxel if the chunk can be written right now, otherwise hold it back or drop it.
+	 * @param ChunkHandle - The chunk to write to.
+	 * @param VoxelCoordinate - The voxel within the chunk.
+	 * @param NewValue - The voxel type to write.
+	 * @param OutDirtyChunks - Gets the chunk and any neighbours the edit changes the look of, to remesh.
+	 * @return true if the voxel was written.
+	 */
+	bool TryModifyVoxel(const FFGChunkHandle& ChunkHandle, FIntVector VoxelCoordinate, int32 NewValue, TSet<FIntVector>& OutDirtyChunks);
+
+	/** Make the edits held back while a generation stage was reading the chunk. */
+	void ApplyDeferredEdits(FFGChunkHandle ChunkHandle);
+
 	TMap<FIntVector, FFGChunkHandle> RenderableHandles;
 
+	/** Edits to chunks a generation stage was reading, in the order they were made. See UFGVoxelGrid::OnStageReadsReleased. */
+	TMap<FIntVector, TArray<TPair<FIntVector, int32>>> DeferredEdits;
+
+	/** In flight loads for the render volume, dropping one cancels it. */
+	TMap<FIntVector, FFGVoxelLoadHandle> PendingRenderLoads;
+
+	/** Speculative loads ahead of the view, dropping one cancels it if it hasn't started. */
+	TMap<FIntVector, FFGVoxelLoadHandle> PrefetchLoads;
+
+	TOptional<FIntVector>	LastPrefetchCoord;
+	TOptional<FVector>		LastViewLocation;
+	FVector					ViewVelocity = FVector::ZeroVector;
+
 	bool					AwaitingForcedGeneration;
 	bool					RenderingInvalidated;
 	TOptional<FIntVector>	LastPlayerCoord;